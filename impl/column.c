@@ -27,26 +27,15 @@ stRPColumn *stRPColumn_construct(int64_t refStart, int64_t length, int64_t depth
     // Initially contains not states
     column->head = NULL;
 
-    // Work out which positions in the column are non-filtered
-
-    // First the active positions
-    column->totalActivePositions = 0;
-    for(int64_t i=0; i<column->length; i++) {
-        if(rProbs->referencePositionsIncluded[column->refStart + i - rProbs->refStart]) {
-            column->totalActivePositions++;
-        }
-    }
-
-    // Now create the array of active positions
-    column->activePositions = st_calloc(column->totalActivePositions, sizeof(int64_t));
-    int64_t k=0;
-    for(int64_t i=0; i<column->length; i++) {
-        int64_t j = column->refStart + i - rProbs->refStart;
-        if(rProbs->referencePositionsIncluded[j]) {
-            column->activePositions[k++] = i; // Positions are relative to the start of the reference
-        }
-    }
-    assert(k == column->totalActivePositions);
+    // Work out which positions in the column are non-filtered, as a slice of the active positions
+    // of the reference
+    column->activePositionsOffset = column->refStart - rProbs->refStart;
+    assert(column->activePositionsOffset >= 0);
+    assert(column->activePositionsOffset + column->length <= rProbs->length);
+    int64_t firstActivePosition = rProbs->activePositionCounts[column->activePositionsOffset];
+    column->totalActivePositions = rProbs->activePositionCounts[column->activePositionsOffset + column->length] -
+                                   firstActivePosition;
+    column->activePositions = &rProbs->activePositions[firstActivePosition];
 
     return column;
 }
@@ -63,7 +52,6 @@ void stRPColumn_destruct(stRPColumn *column) {
 
     free(column->seqHeaders);
     free(column->seqs);
-    free(column->activePositions);
 
     free(column);
 }
@@ -109,7 +97,7 @@ void stRPColumn_split(stRPColumn *column, int64_t firstHalfLength, stRPHmm *hmm)
             column->length-firstHalfLength, column->depth, seqHeaders, seqs, hmm->referencePriorProbs);
 
     // Create merge column
-    uint64_t acceptMask = makeAcceptMask(column->depth);
+    stRPPartition acceptMask = makeAcceptMask(column->depth);
     stRPMergeColumn *mColumn = stRPMergeColumn_construct(acceptMask, acceptMask);
 
     // Copy cells
@@ -141,8 +129,9 @@ void stRPColumn_split(stRPColumn *column, int64_t firstHalfLength, stRPHmm *hmm)
     // Increase column number
     hmm->columnNumber++;
 
-    // Adjust length of previous column
+    // Adjust length and active positions of previous column
     column->length = firstHalfLength;
+    column->totalActivePositions = rColumn->activePositions - column->activePositions;
 }
 
 stSet *stRPColumn_getColumnSequencesAsSet(stRPColumn *column) {
@@ -176,7 +165,7 @@ stSet *stRPColumn_getSequencesInCommon(stRPColumn *column1, stRPColumn *column2)
  * Read partitioning hmm state (stRPCell) functions
  */
 
-stRPCell *stRPCell_construct(int64_t partition) {
+stRPCell *stRPCell_construct(stRPPartition partition) {
     stRPCell *cell = st_calloc(1, sizeof(stRPCell));
     cell->partition = partition;
     return cell;
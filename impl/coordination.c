@@ -16,44 +16,6 @@
  * Functions to create a set of read partitioning HMMs that include a given input set of reads.
  */
 
-stRPHmm *getNextClosestNonoverlappingHmm(stRPHmm *hmm1, stSortedSet *readHmms) {
-    /*
-     * Returns the HMM from the set readHmms that does not overlap hmm1
-     * but whose start coordinate is closest to
-     * the end coordinate of hmm1. If does not exist returns NULL.
-     */
-
-    // Iterator in the set starting from hmm1
-    assert(stSortedSet_search(readHmms, hmm1) == hmm1);
-    stSortedSetIterator *it = stSortedSet_getIteratorFrom(readHmms, hmm1);
-    stRPHmm *hmm2 = stSortedSet_getNext(it);
-    assert(hmm2 == hmm1);
-
-    // For each hmm in readHmms whose coordinate is >= than hmm1's
-    while((hmm2 = stSortedSet_getNext(it)) != NULL) {
-        // Compare the hmm coordinates just to check that hmm2 has a coordinate >= to hmm1s
-        int i = stRPHmm_cmpFn(hmm1, hmm2);
-        assert(i <= 0);
-
-        // If hmm1 and hmm2 are on different references, then hmm2 is the closest non-overlapping
-        // hmm to hmm1 in reference space
-        i = strcmp(hmm1->referenceName, hmm2->referenceName);
-        if(i != 0) {
-            break;
-        }
-
-        // If hmm2 does not overlap hmm1 it must be the closest non-overlapping hmm to hmm1
-        if(hmm1->refStart + hmm1->refLength <= hmm2->refStart) {
-            break;
-        }
-    }
-
-    // Cleanup
-    stSortedSet_destructIterator(it);
-
-    return hmm2;
-}
-
 stSortedSet *makeComponent(stRPHmm *hmm, stSet *components, stHash *componentsHash) {
     /*
      * Create a component containing hmm and add the component to components.
@@ -183,40 +145,164 @@ stSet *getOverlappingComponents(stList *tilingPath1, stList *tilingPath2) {
     return components;
 }
 
+/*
+ * The reference interval of an hmm or profile sequence, used to compute tiling paths without building hmms.
+ */
+typedef struct _tilingInterval {
+    const char *referenceName;
+    int64_t start;
+    int64_t end;
+    int64_t index; // Index of the hmm or profile sequence in the input list
+} tilingInterval;
+
+static int tilingInterval_cmpFn(const void *a, const void *b) {
+    /*
+     * Orders intervals as stRPHmm_cmpFn orders hmms, by reference, start and descending length, using the
+     * input index in place of the memory address to break ties.
+     */
+    const tilingInterval *i1 = a, *i2 = b;
+    int i = strcmp(i1->referenceName, i2->referenceName);
+    if(i == 0) {
+        i = i1->start < i2->start ? -1 : (i1->start > i2->start ? 1 : 0);
+        if(i == 0) {
+            i = i1->end > i2->end ? -1 : (i1->end < i2->end ? 1 : 0);
+            if(i == 0) {
+                i = i1->index < i2->index ? -1 : (i1->index > i2->index ? 1 : 0);
+            }
+        }
+    }
+    return i;
+}
+
+static inline bool heapLessThan(int64_t i, int64_t j, const int64_t *keys) {
+    return keys == NULL ? i < j : (keys[i] < keys[j] || (keys[i] == keys[j] && i < j));
+}
+
+static void heapPush(int64_t *heap, int64_t *heapSize, int64_t value, const int64_t *keys) {
+    /*
+     * Adds value to the binary min-heap of non-negative integers, ordered by keys[value], or by value itself if
+     * keys is NULL.
+     */
+    int64_t i = (*heapSize)++;
+    while(i > 0 && heapLessThan(value, heap[(i-1)/2], keys)) {
+        heap[i] = heap[(i-1)/2];
+        i = (i-1)/2;
+    }
+    heap[i] = value;
+}
+
+static int64_t heapPop(int64_t *heap, int64_t *heapSize, const int64_t *keys) {
+    /*
+     * Removes and returns the least value in the binary min-heap (see heapPush).
+     */
+    assert(*heapSize > 0);
+    int64_t value = heap[0], last = heap[--(*heapSize)], i = 0;
+    while(2*i+1 < *heapSize) {
+        int64_t j = 2*i+2 < *heapSize && heapLessThan(heap[2*i+2], heap[2*i+1], keys) ? 2*i+2 : 2*i+1;
+        if(!heapLessThan(heap[j], last, keys)) {
+            break;
+        }
+        heap[i] = heap[j];
+        i = j;
+    }
+    heap[i] = last;
+    return value;
+}
+
+static stList *getTilingPathsOfIntervals(tilingInterval *intervals, int64_t intervalNumber, stList *items) {
+    /*
+     * Returns a list of tiling paths, each a list of the items (indexed by the index of the intervals) whose
+     * intervals do not overlap, ordered by reference coordinate. Sorts the intervals.
+     *
+     * The paths are those given by repeatedly taking the first remaining interval and then successively the
+     * first remaining interval that does not overlap the last taken. This is computed in a single sweep over the
+     * sorted intervals, placing each interval in the lowest numbered path whose last interval ends before it
+     * starts, or in a new path if there is none. Paths are kept in a min-heap of the end coordinates of their
+     * last intervals until the sweep passes the end, and then in a min-heap of free path numbers.
+     */
+    qsort(intervals, intervalNumber, sizeof(tilingInterval), tilingInterval_cmpFn);
+
+    int64_t *pathEnds = st_malloc(sizeof(int64_t) * (intervalNumber + 1));
+    int64_t *busyPaths = st_malloc(sizeof(int64_t) * (intervalNumber + 1));
+    int64_t *freePaths = st_malloc(sizeof(int64_t) * (intervalNumber + 1));
+    int64_t busyPathNumber = 0, freePathNumber = 0;
+
+    stList *tilingPaths = stList_construct();
+    for(int64_t i=0; i<intervalNumber; i++) {
+        tilingInterval *interval = &intervals[i];
+
+        // Free the paths whose last interval ends before this one starts, or is on a preceding reference
+        bool newReference = i > 0 && strcmp(intervals[i-1].referenceName, interval->referenceName) != 0;
+        while(busyPathNumber > 0 && (newReference || pathEnds[busyPaths[0]] <= interval->start)) {
+            heapPush(freePaths, &freePathNumber, heapPop(busyPaths, &busyPathNumber, pathEnds), NULL);
+        }
+
+        // Add the interval to the lowest numbered free path, making a new path if needed
+        int64_t path;
+        if(freePathNumber > 0) {
+            path = heapPop(freePaths, &freePathNumber, NULL);
+        }
+        else {
+            path = stList_length(tilingPaths);
+            stList_append(tilingPaths, stList_construct());
+        }
+        stList_append(stList_get(tilingPaths, path), stList_get(items, interval->index));
+        pathEnds[path] = interval->end;
+        heapPush(busyPaths, &busyPathNumber, path, pathEnds);
+    }
+
+    // Cleanup
+    free(pathEnds);
+    free(busyPaths);
+    free(freePaths);
+
+    return tilingPaths;
+}
+
 stList *getTilingPaths(stSortedSet *hmms) {
     /*
      * Takes set of hmms ordered by reference coordinate (see stRPHmm_cmpFn) and returns
      * a list of tiling paths. Each tiling path consisting of maximal sequences of hmms
-     * that do not overlap. Destroys sortedSet in the process.
+     * that do not overlap. Destroys sortedSet in the process, which must not own the hmms.
      */
-    stList *tilingPaths = stList_construct();
-    while(stSortedSet_size(hmms) > 0) {
+    stList *hmmList = stSortedSet_getList(hmms);
+    int64_t hmmNumber = stList_length(hmmList);
+    tilingInterval *intervals = st_malloc(sizeof(tilingInterval) * (hmmNumber + 1));
+    for(int64_t i=0; i<hmmNumber; i++) {
+        stRPHmm *hmm = stList_get(hmmList, i);
+        intervals[i].referenceName = hmm->referenceName;
+        intervals[i].start = hmm->refStart;
+        intervals[i].end = hmm->refStart + hmm->refLength;
+        intervals[i].index = i;
+    }
+    stList *tilingPaths = getTilingPathsOfIntervals(intervals, hmmNumber, hmmList);
 
-        // Make an empty tiling path and add to set of tiling paths built so far
-        stList *tilingPath = stList_construct();
-        stList_append(tilingPaths, tilingPath);
+    // Cleanup
+    free(intervals);
+    stList_destruct(hmmList);
+    stSortedSet_destruct(hmms);
 
-        // Get the hmm with lowest reference coordinate and add to the tiling path
-        stRPHmm *hmm = stSortedSet_getFirst(hmms);
-        assert(hmm != NULL);
-        assert(stSortedSet_search(hmms, hmm) == hmm);
-        stList_append(tilingPath, hmm);
+    return tilingPaths;
+}
 
-        // While it exists, get the next closest non-overlapping hmm
-        // and add to the tiling path progressively, removing the chain of hmms from the
-        // set of hmms left to tile
-        stRPHmm *hmm2;
-        while((hmm2 = getNextClosestNonoverlappingHmm(hmm, hmms)) != NULL) {
-            stSortedSet_remove(hmms, hmm);
-            stList_append(tilingPath, hmm2);
-            hmm = hmm2;
-            assert(stSortedSet_search(hmms, hmm) == hmm);
-        }
-        stSortedSet_remove(hmms, hmm);
+stList *getTilingPathsOfProfileSeqs(stList *profileSeqs) {
+    /*
+     * As getTilingPaths, but takes a list of profile sequences (stProfileSeq) and returns tiling paths of the
+     * profile sequences, ordered as the hmms of the sequences would be, without constructing the hmms.
+     */
+    int64_t seqNumber = stList_length(profileSeqs);
+    tilingInterval *intervals = st_malloc(sizeof(tilingInterval) * (seqNumber + 1));
+    for(int64_t i=0; i<seqNumber; i++) {
+        stProfileSeq *pSeq = stList_get(profileSeqs, i);
+        intervals[i].referenceName = pSeq->referenceName;
+        intervals[i].start = pSeq->refStart;
+        intervals[i].end = pSeq->refStart + pSeq->length;
+        intervals[i].index = i;
     }
+    stList *tilingPaths = getTilingPathsOfIntervals(intervals, seqNumber, profileSeqs);
 
-    // Cleanup the input set
-    stSortedSet_destruct(hmms);
+    // Cleanup
+    free(intervals);
 
     return tilingPaths;
 }
@@ -228,17 +314,20 @@ stList *getTilingPaths2(stList *profileSeqs, stHash *referenceNamesToReferencePr
      * that do not overlap.
      */
 
-    // Create a read partitioning HMM for every sequence and put in ordered set, ordered by reference coordinate
-    stSortedSet *readHmms = stSortedSet_construct3(stRPHmm_cmpFn, (void (*)(void *))stRPHmm_destruct2);
-    for(int64_t i=0; i<stList_length(profileSeqs); i++) {
-        stProfileSeq *pSeq = stList_get(profileSeqs, i);
-        stRPHmm *hmm = stRPHmm_construct(pSeq, stHash_search(referenceNamesToReferencePriors, pSeq->referenceName), params);
-        stSortedSet_insert(readHmms, hmm);
+    // Organise the sequences into "tiling paths" consisting of sequences of reads that do not overlap
+    stList *tilingPaths = getTilingPathsOfProfileSeqs(profileSeqs);
+
+    // Create a read partitioning HMM for every sequence, in place of the sequence
+    for(int64_t i=0; i<stList_length(tilingPaths); i++) {
+        stList *tilingPath = stList_get(tilingPaths, i);
+        for(int64_t j=0; j<stList_length(tilingPath); j++) {
+            stProfileSeq *pSeq = stList_get(tilingPath, j);
+            stList_set(tilingPath, j, stRPHmm_construct(pSeq,
+                    stHash_search(referenceNamesToReferencePriors, pSeq->referenceName), params));
+        }
     }
-    assert(stSortedSet_size(readHmms) == stList_length(profileSeqs));
 
-    // Organise HMMs into "tiling paths" consisting of sequences of hmms that do not overlap
-    return getTilingPaths(readHmms);
+    return tilingPaths;
 }
 
 stRPHmm *fuseTilingPath(stList *tilingPath) {
@@ -260,7 +349,30 @@ stRPHmm *fuseTilingPath(stList *tilingPath) {
     return rightHmm;
 }
 
-stList *mergeTwoTilingPaths(stList *tilingPath1, stList *tilingPath2) {
+static double getAlignedCrossProductCost(stRPHmm *hmm1, stRPHmm *hmm2) {
+    /*
+     * Returns the number of cells in the cross product of the two aligned hmms, each weighted by the
+     * length of its column, as a measure of the cost of computing it.
+     */
+    double cost = 0.0;
+    stRPColumn *column1 = hmm1->firstColumn, *column2 = hmm2->firstColumn;
+    while(column1 != NULL) {
+        assert(column2 != NULL && column1->length == column2->length);
+        int64_t cellNumber1 = 0, cellNumber2 = 0;
+        for(stRPCell *cell = column1->head; cell != NULL; cell = cell->nCell) {
+            cellNumber1++;
+        }
+        for(stRPCell *cell = column2->head; cell != NULL; cell = cell->nCell) {
+            cellNumber2++;
+        }
+        cost += (double)cellNumber1 * cellNumber2 * column1->length;
+        column1 = column1->nColumn == NULL ? NULL : column1->nColumn->nColumn;
+        column2 = column2->nColumn == NULL ? NULL : column2->nColumn->nColumn;
+    }
+    return cost;
+}
+
+stList *mergeTwoTilingPaths(stList *tilingPath1, stList *tilingPath2, double *crossProductCost) {
     /*
      *  Takes two lists, tilingPath1 and tilingPath2, each of which is a set of hmms
      *  ordered by reference coordinates and
@@ -268,7 +380,12 @@ stList *mergeTwoTilingPaths(stList *tilingPath1, stList *tilingPath2) {
      *  Merges together the hmms and returns a single tiling path as a result in the
      *  same format as the input lists.
      *  Destroys the input tilingPaths in the process and cleans them up.
+     *  If crossProductCost is not NULL it is set to the total cost of the cross products computed
+     *  (see getAlignedCrossProductCost).
      */
+    if(crossProductCost != NULL) {
+        *crossProductCost = 0.0;
+    }
 
     // Partition of the hmms into overlapping connected components
     stSet *components = getOverlappingComponents(tilingPath1, tilingPath2);
@@ -302,15 +419,25 @@ stList *mergeTwoTilingPaths(stList *tilingPath1, stList *tilingPath2) {
 
             // Align
             stRPHmm_alignColumns(hmm1, hmm2);
+            if(crossProductCost != NULL) {
+                *crossProductCost += getAlignedCrossProductCost(hmm1, hmm2);
+            }
 
-            // Merge
-            hmm = stRPHmm_createCrossProductOfTwoAlignedHmm(hmm1, hmm2);
-            stRPHmm_destruct(hmm1, 1);
-            stRPHmm_destruct(hmm2, 1);
+            // Merge and prune
+            if(hmm1->parameters->checkpointForwardBackward) {
+                // Avoids holding the whole unpruned cross product in memory
+                hmm = stRPHmm_createPrunedCrossProductOfTwoAlignedHmm(hmm1, hmm2);
+                stRPHmm_destruct(hmm1, 1);
+                stRPHmm_destruct(hmm2, 1);
+            }
+            else {
+                hmm = stRPHmm_createCrossProductOfTwoAlignedHmm(hmm1, hmm2);
+                stRPHmm_destruct(hmm1, 1);
+                stRPHmm_destruct(hmm2, 1);
 
-            // Prune
-            stRPHmm_forwardBackward(hmm);
-            stRPHmm_prune(hmm);
+                stRPHmm_forwardBackward(hmm);
+                stRPHmm_prune(hmm);
+            }
         }
         else { // Case that component is just one hmm that does not
             // overlap anything else
@@ -407,18 +534,364 @@ stList *mergeTilingPaths(stList *tilingPaths) {
     assert(tilingPath1 != NULL);
     assert(tilingPath2 != NULL);
     stList_destruct(tilingPaths);
-    return mergeTwoTilingPaths(tilingPath1, tilingPath2);
+    return mergeTwoTilingPaths(tilingPath1, tilingPath2, NULL);
 }
 
-static void getProfileSeqs(stList *tilingPath, stList *pSeqs) {
-    while(stList_length(tilingPath) > 0) {
-        stRPHmm *hmm = stList_pop(tilingPath);
-        assert(stList_length(hmm->profileSeqs) == 1);
-        stProfileSeq *pSeq = stList_peek(hmm->profileSeqs);
-        stRPHmm_destruct(hmm, 1);
-        stList_append(pSeqs, pSeq);
+static double getCellsPerBase(stRPHmm *hmm) {
+    /*
+     * Returns the average number of cells in the columns of the hmm per reference base.
+     */
+    double cells = 0.0;
+    for(stRPColumn *column = hmm->firstColumn; column != NULL;
+        column = column->nColumn == NULL ? NULL : column->nColumn->nColumn) {
+        int64_t cellNumber = 0;
+        for(stRPCell *cell = column->head; cell != NULL; cell = cell->nCell) {
+            cellNumber++;
+        }
+        cells += (double)cellNumber * column->length;
     }
-    stList_destruct(tilingPath);
+    return hmm->refLength > 0 ? cells / hmm->refLength : 0.0;
+}
+
+static double estimateTilingPathMergeCost(stList *tilingPath1, double *cellsPerBase1,
+                                          stList *tilingPath2, double *cellsPerBase2) {
+    /*
+     * Estimates the cost of merging two tiling paths with mergeTwoTilingPaths, as the sum over each pair of
+     * overlapping hmms of the length of their overlap multiplied by the average number of cells per base of each,
+     * cellsPerBase1 and cellsPerBase2 giving the averages for the hmms of each tiling path. As both tiling paths are
+     * ordered, the overlapping pairs are found in a single sweep.
+     */
+    double cost = 0.0;
+    int64_t i = 0, j = 0;
+    while(i < stList_length(tilingPath1) && j < stList_length(tilingPath2)) {
+        stRPHmm *hmm1 = stList_get(tilingPath1, i), *hmm2 = stList_get(tilingPath2, j);
+        int k = strcmp(hmm1->referenceName, hmm2->referenceName);
+        int64_t end1 = hmm1->refStart + hmm1->refLength, end2 = hmm2->refStart + hmm2->refLength;
+        if(k == 0) {
+            int64_t overlap = (end1 < end2 ? end1 : end2) -
+                              (hmm1->refStart > hmm2->refStart ? hmm1->refStart : hmm2->refStart);
+            if(overlap > 0) {
+                cost += overlap * cellsPerBase1[i] * cellsPerBase2[j];
+            }
+        }
+        // Move past the hmm that ends first
+        if(k < 0 || (k == 0 && end1 <= end2)) {
+            i++;
+        }
+        else {
+            j++;
+        }
+    }
+    return cost;
+}
+
+typedef struct _tilingPathPair {
+    int64_t i, j;
+    double cost;
+} tilingPathPair;
+
+static int tilingPathPair_cmpFn(const void *a, const void *b) {
+    const tilingPathPair *p1 = a, *p2 = b;
+    if(p1->cost != p2->cost) {
+        return p1->cost < p2->cost ? -1 : 1;
+    }
+    return p1->i != p2->i ? (p1->i < p2->i ? -1 : 1) : (p1->j < p2->j ? -1 : (p1->j > p2->j ? 1 : 0));
+}
+
+stList *mergeTilingPathsByEstimatedCost(stList *tilingPaths) {
+    /*
+     * Like mergeTilingPaths(), but chooses which tiling paths to merge by their estimated cost
+     * (see estimateTilingPathMergeCost), rather than by their order in the list.
+     *
+     * Merging proceeds in rounds, as in building a Huffman code: in each round the estimated cost of merging every
+     * pair of the remaining tiling paths is computed and disjoint pairs are chosen cheapest first, until no pair is
+     * left. The chosen pairs are merged, in parallel if OpenMP is available, and the merged and any unpaired tiling
+     * paths go on to the next round. The estimated and actual costs of each merge are logged at debug level.
+     * Destroys the tiling paths as it goes.
+     */
+
+    // If no tiling paths in input warn and return an empty tiling path
+    if(stList_length(tilingPaths) == 0) {
+        st_logCritical("WARNING: Zero tiling paths to merge\n");
+        stList_destruct(tilingPaths);
+        return stList_construct();
+    }
+
+    double totalEstimatedCost = 0.0, totalCost = 0.0, maxCost = 0.0;
+    while(stList_length(tilingPaths) > 1) {
+        int64_t tilingPathNumber = stList_length(tilingPaths);
+
+        // Get the average number of cells per base of each hmm
+        double **cellsPerBase = st_malloc(sizeof(double *) * tilingPathNumber);
+        for(int64_t i=0; i<tilingPathNumber; i++) {
+            stList *tilingPath = stList_get(tilingPaths, i);
+            cellsPerBase[i] = st_malloc(sizeof(double) * (stList_length(tilingPath) + 1));
+            for(int64_t j=0; j<stList_length(tilingPath); j++) {
+                cellsPerBase[i][j] = getCellsPerBase(stList_get(tilingPath, j));
+            }
+        }
+
+        // Estimate the cost of merging each pair of tiling paths
+        int64_t pairNumber = tilingPathNumber * (tilingPathNumber - 1) / 2;
+        tilingPathPair *pairs = st_malloc(sizeof(tilingPathPair) * pairNumber);
+        int64_t k = 0;
+        for(int64_t i=0; i<tilingPathNumber; i++) {
+            for(int64_t j=i+1; j<tilingPathNumber; j++) {
+                pairs[k].i = i;
+                pairs[k].j = j;
+                pairs[k++].cost = estimateTilingPathMergeCost(stList_get(tilingPaths, i), cellsPerBase[i],
+                                                              stList_get(tilingPaths, j), cellsPerBase[j]);
+            }
+        }
+        qsort(pairs, pairNumber, sizeof(tilingPathPair), tilingPathPair_cmpFn);
+
+        // Choose disjoint pairs, cheapest first
+        bool *paired = st_calloc(tilingPathNumber, sizeof(bool));
+        tilingPathPair *chosenPairs = st_malloc(sizeof(tilingPathPair) * (tilingPathNumber / 2 + 1));
+        int64_t chosenPairNumber = 0;
+        for(k=0; k<pairNumber; k++) {
+            if(!paired[pairs[k].i] && !paired[pairs[k].j]) {
+                paired[pairs[k].i] = 1;
+                paired[pairs[k].j] = 1;
+                chosenPairs[chosenPairNumber++] = pairs[k];
+            }
+        }
+
+        // Merge the chosen pairs
+        stList **mergedTilingPaths = st_malloc(sizeof(stList *) * (chosenPairNumber + 1));
+        double *costs = st_malloc(sizeof(double) * (chosenPairNumber + 1));
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for(int64_t l=0; l<chosenPairNumber; l++) {
+            mergedTilingPaths[l] = mergeTwoTilingPaths(stList_get(tilingPaths, chosenPairs[l].i),
+                                                       stList_get(tilingPaths, chosenPairs[l].j), &costs[l]);
+        }
+
+        // Report the costs and make the list of tiling paths for the next round
+        stList *nextTilingPaths = stList_construct();
+        for(int64_t l=0; l<chosenPairNumber; l++) {
+            st_logDebug("Merged tiling paths with estimated cost %f and actual cost %f\n",
+                        chosenPairs[l].cost, costs[l]);
+            totalEstimatedCost += chosenPairs[l].cost;
+            totalCost += costs[l];
+            maxCost = costs[l] > maxCost ? costs[l] : maxCost;
+            stList_append(nextTilingPaths, mergedTilingPaths[l]);
+        }
+        for(int64_t i=0; i<tilingPathNumber; i++) {
+            if(!paired[i]) {
+                stList_append(nextTilingPaths, stList_get(tilingPaths, i));
+            }
+        }
+        stList_destruct(tilingPaths);
+        tilingPaths = nextTilingPaths;
+
+        // Cleanup
+        for(int64_t i=0; i<tilingPathNumber; i++) {
+            free(cellsPerBase[i]);
+        }
+        free(cellsPerBase);
+        free(pairs);
+        free(paired);
+        free(chosenPairs);
+        free(mergedTilingPaths);
+        free(costs);
+    }
+    st_logDebug("Merged tiling paths with total estimated cost %f, total actual cost %f and greatest actual cost "
+                "of a merge %f\n", totalEstimatedCost, totalCost, maxCost);
+
+    stList *tilingPath = stList_get(tilingPaths, 0);
+    stList_destruct(tilingPaths);
+    return tilingPath;
+}
+
+/*
+ * Functions to downsample reads to a bounded coverage depth.
+ */
+
+typedef struct _downsamplingCandidate {
+    int64_t index; // Index of the profile sequence in the input list
+    int64_t firstSegment; // The elementary segments of the reference covered by the sequence
+    int64_t lastSegment;
+    int64_t mappingQuality; // MAPQ of the sequence if preferring high MAPQ sequences, else 0
+    int64_t activePositions; // Number of unfiltered reference positions covered by the sequence
+    int64_t length;
+} downsamplingCandidate;
+
+static int downsamplingCandidate_cmpFn(const void *a, const void *b) {
+    /*
+     * Orders candidate sequences from most to least informative: by descending MAPQ, then by the number of
+     * unfiltered positions covered, then by length, then by input order.
+     */
+    const downsamplingCandidate *c1 = a, *c2 = b;
+    if(c1->mappingQuality != c2->mappingQuality) {
+        return c1->mappingQuality > c2->mappingQuality ? -1 : 1;
+    }
+    if(c1->activePositions != c2->activePositions) {
+        return c1->activePositions > c2->activePositions ? -1 : 1;
+    }
+    if(c1->length != c2->length) {
+        return c1->length > c2->length ? -1 : 1;
+    }
+    return c1->index < c2->index ? -1 : (c1->index > c2->index ? 1 : 0);
+}
+
+static int cmpInt64Fn(const void *a, const void *b) {
+    int64_t i = *(const int64_t *)a, j = *(const int64_t *)b;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
+
+static int64_t getCoordinateIndex(int64_t *coordinates, int64_t coordinateNumber, int64_t coordinate) {
+    /*
+     * Returns the index of the coordinate in the sorted array of distinct coordinates, which must contain it.
+     */
+    int64_t *c = bsearch(&coordinate, coordinates, coordinateNumber, sizeof(int64_t), cmpInt64Fn);
+    assert(c != NULL);
+    return c - coordinates;
+}
+
+static void coverageTree_add(int64_t *maxCoverage, int64_t *pendingCoverage, int64_t node, int64_t start,
+        int64_t end, int64_t queryStart, int64_t queryEnd) {
+    /*
+     * Adds one to the coverage of the segments queryStart to queryEnd (inclusive) of the segment tree whose node
+     * covers segments start to end, maxCoverage giving the maximum coverage of the segments below each node and
+     * pendingCoverage the coverage added to all the segments below each node.
+     */
+    if(queryEnd < start || end < queryStart) {
+        return;
+    }
+    if(queryStart <= start && end <= queryEnd) {
+        maxCoverage[node]++;
+        pendingCoverage[node]++;
+        return;
+    }
+    int64_t middle = (start + end) / 2;
+    coverageTree_add(maxCoverage, pendingCoverage, 2*node+1, start, middle, queryStart, queryEnd);
+    coverageTree_add(maxCoverage, pendingCoverage, 2*node+2, middle+1, end, queryStart, queryEnd);
+    maxCoverage[node] = pendingCoverage[node] + (maxCoverage[2*node+1] > maxCoverage[2*node+2] ?
+                                                 maxCoverage[2*node+1] : maxCoverage[2*node+2]);
+}
+
+static int64_t coverageTree_max(int64_t *maxCoverage, int64_t *pendingCoverage, int64_t node, int64_t start,
+        int64_t end, int64_t queryStart, int64_t queryEnd) {
+    /*
+     * Returns the maximum coverage of the segments queryStart to queryEnd (inclusive), see coverageTree_add.
+     */
+    if(queryEnd < start || end < queryStart) {
+        return 0;
+    }
+    if(queryStart <= start && end <= queryEnd) {
+        return maxCoverage[node];
+    }
+    int64_t middle = (start + end) / 2;
+    int64_t i = coverageTree_max(maxCoverage, pendingCoverage, 2*node+1, start, middle, queryStart, queryEnd);
+    int64_t j = coverageTree_max(maxCoverage, pendingCoverage, 2*node+2, middle+1, end, queryStart, queryEnd);
+    return pendingCoverage[node] + (i > j ? i : j);
+}
+
+static void downsampleReferenceInterval(tilingInterval *intervals, int64_t intervalNumber, stList *profileSeqs,
+        stReferencePriorProbs *rProbs, stRPHmmParameters *params, bool *kept) {
+    /*
+     * Chooses which of the profile sequences, given by their intervals on a single reference sequence, to keep so
+     * that the coverage depth is at most params->maxCoverageDepth, setting kept for the index of each kept sequence.
+     *
+     * The reference is divided into elementary segments at the ends of the sequences. A difference array gives the
+     * coverage of each segment, and sequences that cover no segment with a coverage greater than the maximum are
+     * kept. The remaining sequences are considered from most to least informative (see
+     * downsamplingCandidate_cmpFn), each being kept if doing so does not raise the coverage of any segment above
+     * the maximum, using a segment tree of the coverage of the kept sequences.
+     */
+
+    // Get the distinct ends of the intervals
+    int64_t *coordinates = st_malloc(sizeof(int64_t) * 2 * intervalNumber);
+    for(int64_t i=0; i<intervalNumber; i++) {
+        coordinates[2*i] = intervals[i].start;
+        coordinates[2*i+1] = intervals[i].end;
+    }
+    qsort(coordinates, 2 * intervalNumber, sizeof(int64_t), cmpInt64Fn);
+    int64_t coordinateNumber = 0;
+    for(int64_t i=0; i<2*intervalNumber; i++) {
+        if(coordinateNumber == 0 || coordinates[coordinateNumber-1] != coordinates[i]) {
+            coordinates[coordinateNumber++] = coordinates[i];
+        }
+    }
+    int64_t segmentNumber = coordinateNumber - 1;
+    if(segmentNumber <= 0) {
+        // All the intervals are empty
+        for(int64_t i=0; i<intervalNumber; i++) {
+            kept[intervals[i].index] = 1;
+        }
+        free(coordinates);
+        return;
+    }
+
+    // Calculate the coverage of each segment with a difference array, then the number of segments preceding each
+    // segment whose coverage exceeds the maximum
+    downsamplingCandidate *candidates = st_malloc(sizeof(downsamplingCandidate) * intervalNumber);
+    int64_t *coverageChanges = st_calloc(segmentNumber + 1, sizeof(int64_t));
+    int64_t *overcoveredSegmentsBefore = st_malloc(sizeof(int64_t) * (segmentNumber + 1));
+    for(int64_t i=0; i<intervalNumber; i++) {
+        candidates[i].index = intervals[i].index;
+        candidates[i].firstSegment = getCoordinateIndex(coordinates, coordinateNumber, intervals[i].start);
+        candidates[i].lastSegment = getCoordinateIndex(coordinates, coordinateNumber, intervals[i].end) - 1;
+        if(candidates[i].firstSegment <= candidates[i].lastSegment) {
+            coverageChanges[candidates[i].firstSegment]++;
+            coverageChanges[candidates[i].lastSegment+1]--;
+        }
+    }
+    int64_t coverage = 0, overcoveredSegments = 0;
+    for(int64_t i=0; i<segmentNumber; i++) {
+        coverage += coverageChanges[i];
+        overcoveredSegmentsBefore[i] = overcoveredSegments;
+        overcoveredSegments += coverage > params->maxCoverageDepth ? 1 : 0;
+    }
+    overcoveredSegmentsBefore[segmentNumber] = overcoveredSegments;
+
+    // Keep the sequences that cover no over-covered segment, adding them to the coverage tree
+    int64_t *maxCoverage = st_calloc(4 * segmentNumber, sizeof(int64_t));
+    int64_t *pendingCoverage = st_calloc(4 * segmentNumber, sizeof(int64_t));
+    int64_t candidateNumber = 0;
+    for(int64_t i=0; i<intervalNumber; i++) {
+        downsamplingCandidate *candidate = &candidates[i];
+        if(candidate->firstSegment > candidate->lastSegment ||
+           overcoveredSegmentsBefore[candidate->lastSegment+1] == overcoveredSegmentsBefore[candidate->firstSegment]) {
+            kept[candidate->index] = 1;
+            if(candidate->firstSegment <= candidate->lastSegment) {
+                coverageTree_add(maxCoverage, pendingCoverage, 0, 0, segmentNumber-1,
+                                 candidate->firstSegment, candidate->lastSegment);
+            }
+            continue;
+        }
+
+        // Otherwise score the sequence
+        stProfileSeq *pSeq = stList_get(profileSeqs, candidate->index);
+        candidate->mappingQuality = params->preferHighMapqWhenDownsampling ? pSeq->mappingQuality : 0;
+        candidate->length = pSeq->length;
+        candidate->activePositions = rProbs == NULL ? 0 :
+                rProbs->activePositionCounts[pSeq->refStart + pSeq->length - rProbs->refStart] -
+                rProbs->activePositionCounts[pSeq->refStart - rProbs->refStart];
+        candidates[candidateNumber++] = *candidate;
+    }
+
+    // Greedily keep the most informative of the remaining sequences that fit
+    qsort(candidates, candidateNumber, sizeof(downsamplingCandidate), downsamplingCandidate_cmpFn);
+    for(int64_t i=0; i<candidateNumber; i++) {
+        downsamplingCandidate *candidate = &candidates[i];
+        if(coverageTree_max(maxCoverage, pendingCoverage, 0, 0, segmentNumber-1,
+                            candidate->firstSegment, candidate->lastSegment) < params->maxCoverageDepth) {
+            kept[candidate->index] = 1;
+            coverageTree_add(maxCoverage, pendingCoverage, 0, 0, segmentNumber-1,
+                             candidate->firstSegment, candidate->lastSegment);
+        }
+    }
+
+    // Cleanup
+    free(coordinates);
+    free(candidates);
+    free(coverageChanges);
+    free(overcoveredSegmentsBefore);
+    free(maxCoverage);
+    free(pendingCoverage);
 }
 
 stList *filterReadsByCoverageDepth(stList *profileSeqs, stRPHmmParameters *params,
@@ -427,22 +900,45 @@ stList *filterReadsByCoverageDepth(stList *profileSeqs, stRPHmmParameters *param
      * Takes a set of profile sequences and returns a subset such that maximum coverage depth of the subset is
      * less than or equal to params->maxCoverageDepth. The discarded sequences are placed in the list
      * "discardedProfileSeqs", the retained sequences are placed in filteredProfileSeqs.
+     *
+     * Where sequences must be discarded, those covering the most unfiltered reference positions, then the longest,
+     * are kept in preference, after those with the highest MAPQ if params->preferHighMapqWhenDownsampling is set
+     * (see downsampleReferenceInterval).
      */
 
-    // Create a set of tiling paths
-    stList *tilingPaths = getTilingPaths2(profileSeqs, referenceNamesToReferencePriors, params);
-
-    // Eliminate reads until the maximum coverage depth to less than the give threshold
-    while(stList_length(tilingPaths) > params->maxCoverageDepth) {
-        getProfileSeqs(stList_pop(tilingPaths), discardedProfileSeqs);
+    // Get the intervals of the sequences, grouped by reference sequence
+    int64_t seqNumber = stList_length(profileSeqs);
+    tilingInterval *intervals = st_malloc(sizeof(tilingInterval) * (seqNumber + 1));
+    for(int64_t i=0; i<seqNumber; i++) {
+        stProfileSeq *pSeq = stList_get(profileSeqs, i);
+        intervals[i].referenceName = pSeq->referenceName;
+        intervals[i].start = pSeq->refStart;
+        intervals[i].end = pSeq->refStart + pSeq->length;
+        intervals[i].index = i;
+    }
+    qsort(intervals, seqNumber, sizeof(tilingInterval), tilingInterval_cmpFn);
+
+    // Choose the sequences to keep for each reference sequence
+    bool *kept = st_calloc(seqNumber + 1, sizeof(bool));
+    for(int64_t i=0; i<seqNumber;) {
+        int64_t j = i+1;
+        while(j < seqNumber && strcmp(intervals[i].referenceName, intervals[j].referenceName) == 0) {
+            j++;
+        }
+        stReferencePriorProbs *rProbs = referenceNamesToReferencePriors == NULL ? NULL :
+                                        stHash_search(referenceNamesToReferencePriors, (void *)intervals[i].referenceName);
+        downsampleReferenceInterval(&intervals[i], j - i, profileSeqs, rProbs, params, kept);
+        i = j;
     }
 
-    while(stList_length(tilingPaths) > 0) {
-        getProfileSeqs(stList_pop(tilingPaths), filteredProfileSeqs);
+    // Divide the sequences, maintaining their order
+    for(int64_t i=0; i<seqNumber; i++) {
+        stList_append(kept[i] ? filteredProfileSeqs : discardedProfileSeqs, stList_get(profileSeqs, i));
     }
 
     // Cleanup
-    stList_destruct(tilingPaths);
+    free(intervals);
+    free(kept);
 
     return filteredProfileSeqs;
 }
@@ -466,8 +962,401 @@ stList *getRPHmms(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
 
     // Merge together the tiling paths into one merged tiling path, merging the individual hmms when
     // they overlap on the reference
-    stList *finalTilingPath = mergeTilingPaths(tilingPaths);
+    stList *finalTilingPath = params->orderMergesByEstimatedCost ? mergeTilingPathsByEstimatedCost(tilingPaths) :
+                              mergeTilingPaths(tilingPaths);
     stList_setDestructor(finalTilingPath, (void (*)(void *))stRPHmm_destruct2);
 
     return finalTilingPath;
 }
+
+static int64_t *getWeaklyLinkedSplitPoints(stList *profileSeqs, stReferencePriorProbs *rProbs,
+        int64_t minReadCoverage, int64_t *splitPointNumber) {
+    /*
+     * Returns an ordered array of reference coordinates at which to split the given profile sequences, all of which
+     * are aligned to the reference sequence of rProbs. A split point is placed midway between each pair of consecutive
+     * unfiltered reference positions (see rProbs->activePositions) that are both included in fewer than
+     * minReadCoverage of the sequences, as is done for heterozygous sites in stRPHMM_splitWherePhasingIsUncertain.
+     */
+
+    // For each reference position the number of unfiltered positions preceding it, and the unfiltered positions
+    int64_t *candidatesBefore = rProbs->activePositionCounts;
+    int64_t *candidates = rProbs->activePositions;
+    int64_t candidateNumber = rProbs->totalActivePositions;
+
+    // Count the sequences including each pair of consecutive unfiltered positions, using a difference array
+    // in which a sequence including the ith to jth unfiltered positions increments the count for pairs i to j-1
+    int64_t *linkage = st_calloc(candidateNumber + 1, sizeof(int64_t));
+    for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+        stProfileSeq *pSeq = stList_get(profileSeqs, i);
+        int64_t j = candidatesBefore[pSeq->refStart - rProbs->refStart];
+        int64_t k = candidatesBefore[pSeq->refStart + pSeq->length - rProbs->refStart] - 1;
+        if(k > j) {
+            linkage[j]++;
+            linkage[k]--;
+        }
+    }
+
+    // Place split points between the pairs of positions that are not well linked
+    int64_t *splitPoints = st_malloc(sizeof(int64_t) * (candidateNumber + 1));
+    *splitPointNumber = 0;
+    int64_t coverage = 0;
+    for(int64_t i=0; i+1<candidateNumber; i++) {
+        coverage += linkage[i];
+        if(coverage < minReadCoverage) {
+            splitPoints[(*splitPointNumber)++] = rProbs->refStart + candidates[i] +
+                                                 (candidates[i+1] - candidates[i] + 1) / 2;
+        }
+    }
+
+    // Cleanup
+    free(linkage);
+
+    return splitPoints;
+}
+
+stList *splitProfileSeqsAtWeaklyLinkedSites(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params, stList *clippedProfileSeqs) {
+    /*
+     * Divides the profile sequences into groups that can be phased independently, returned as a list of lists
+     * of profile sequences. The groups are divided at points between consecutive unfiltered reference positions
+     * that are spanned by fewer than params->minReadCoverageToSupportPhasingBetweenHeterozygousSites sequences.
+     * Sequences that span a split point are divided at it, the parts being added to clippedProfileSeqs, which
+     * is the responsibility of the caller to cleanup once the groups are no longer needed.
+     */
+
+    // Group the profile sequences by reference sequence, maintaining the order of the references
+    stHash *referenceNamesToProfileSeqs = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL,
+                                                            (void (*)(void *))stList_destruct);
+    stList *referenceNames = stList_construct();
+    for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+        stProfileSeq *pSeq = stList_get(profileSeqs, i);
+        stList *referenceProfileSeqs = stHash_search(referenceNamesToProfileSeqs, pSeq->referenceName);
+        if(referenceProfileSeqs == NULL) {
+            referenceProfileSeqs = stList_construct();
+            stHash_insert(referenceNamesToProfileSeqs, pSeq->referenceName, referenceProfileSeqs);
+            stList_append(referenceNames, pSeq->referenceName);
+        }
+        stList_append(referenceProfileSeqs, pSeq);
+    }
+
+    stList *groups = stList_construct3(0, (void (*)(void *))stList_destruct);
+    for(int64_t i=0; i<stList_length(referenceNames); i++) {
+        char *referenceName = stList_get(referenceNames, i);
+        stList *referenceProfileSeqs = stHash_search(referenceNamesToProfileSeqs, referenceName);
+        stReferencePriorProbs *rProbs = stHash_search(referenceNamesToReferencePriors, referenceName);
+        if(rProbs == NULL) {
+            st_errAbort("No reference prior probabilities for reference sequence: %s\n", referenceName);
+        }
+
+        int64_t splitPointNumber;
+        int64_t *splitPoints = getWeaklyLinkedSplitPoints(referenceProfileSeqs, rProbs,
+                params->minReadCoverageToSupportPhasingBetweenHeterozygousSites, &splitPointNumber);
+
+        // Make a group for each interval between split points
+        stList *referenceGroups[splitPointNumber + 1];
+        for(int64_t j=0; j<=splitPointNumber; j++) {
+            referenceGroups[j] = stList_construct();
+        }
+
+        // Add each sequence to the groups it overlaps, dividing it if it overlaps more than one
+        for(int64_t j=0; j<stList_length(referenceProfileSeqs); j++) {
+            stProfileSeq *pSeq = stList_get(referenceProfileSeqs, j);
+
+            // Find the first split point after the start of the sequence
+            int64_t k = 0, l = splitPointNumber;
+            while(k < l) {
+                int64_t m = k + (l - k) / 2;
+                if(splitPoints[m] <= pSeq->refStart) {
+                    k = m + 1;
+                }
+                else {
+                    l = m;
+                }
+            }
+
+            // If the sequence ends before the split point it is not divided
+            if(k == splitPointNumber || pSeq->refStart + pSeq->length <= splitPoints[k]) {
+                stList_append(referenceGroups[k], pSeq);
+                continue;
+            }
+
+            // Otherwise divide the sequence at each split point it spans
+            int64_t start = pSeq->refStart;
+            while(start < pSeq->refStart + pSeq->length) {
+                int64_t end = k < splitPointNumber && splitPoints[k] < pSeq->refStart + pSeq->length ?
+                              splitPoints[k] : pSeq->refStart + pSeq->length;
+                stProfileSeq *subSeq = stProfileSeq_getSubsequence(pSeq, start, end - start);
+                stList_append(clippedProfileSeqs, subSeq);
+                stList_append(referenceGroups[k], subSeq);
+                start = end;
+                k++;
+            }
+        }
+
+        // Add the non-empty groups
+        for(int64_t j=0; j<=splitPointNumber; j++) {
+            if(stList_length(referenceGroups[j]) > 0) {
+                stList_append(groups, referenceGroups[j]);
+            }
+            else {
+                stList_destruct(referenceGroups[j]);
+            }
+        }
+
+        free(splitPoints);
+    }
+
+    // Cleanup
+    stHash_destruct(referenceNamesToProfileSeqs);
+    stList_destruct(referenceNames);
+
+    return groups;
+}
+
+stList *getRPHmmsSplitAtWeaklyLinkedSites(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params, stList *clippedProfileSeqs) {
+    /*
+     * As getRPHmms, but first divides the profile sequences into independent groups using
+     * splitProfileSeqsAtWeaklyLinkedSites and creates the hmms for each group separately, in parallel if OpenMP is
+     * available. Any sequences divided between groups are added to clippedProfileSeqs, which must not be
+     * cleaned up before the returned hmms.
+     */
+    stList *groups = splitProfileSeqsAtWeaklyLinkedSites(profileSeqs, referenceNamesToReferencePriors,
+                                                         params, clippedProfileSeqs);
+    int64_t groupNumber = stList_length(groups);
+    stList **groupHmms = st_malloc(sizeof(stList *) * groupNumber);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int64_t i=0; i<groupNumber; i++) {
+        groupHmms[i] = getRPHmms(stList_get(groups, i), referenceNamesToReferencePriors, params);
+    }
+
+    // Combine the hmms, keeping them ordered by reference coordinate
+    stList *hmms = stList_construct3(0, (void (*)(void *))stRPHmm_destruct2);
+    for(int64_t i=0; i<groupNumber; i++) {
+        stList_appendAll(hmms, groupHmms[i]);
+        stList_setDestructor(groupHmms[i], NULL);
+        stList_destruct(groupHmms[i]);
+    }
+    stList_sort(hmms, stRPHmm_cmpFn);
+
+    // Cleanup
+    free(groupHmms);
+    stList_destruct(groups);
+
+    return hmms;
+}
+
+stList *getCoverageDepthBoundedSubsamples(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params, int64_t maxSubsampleNumber, stList *remainingProfileSeqs) {
+    /*
+     * Divides the profile sequences into at most maxSubsampleNumber disjoint sub-samples, returned as a list of
+     * lists of profile sequences, each drawn by filterReadsByCoverageDepth from the sequences not already
+     * sub-sampled, so that none has a coverage depth greater than params->maxCoverageDepth. Any sequences left
+     * over are appended to remainingProfileSeqs. The lists do not own the sequences.
+     */
+    stList *subsamples = stList_construct3(0, (void (*)(void *))stList_destruct);
+    stList *remaining = stList_copy(profileSeqs, NULL);
+    while(stList_length(remaining) > 0 && stList_length(subsamples) < maxSubsampleNumber) {
+        stList *subsample = stList_construct();
+        stList *discarded = stList_construct();
+        filterReadsByCoverageDepth(remaining, params, subsample, discarded, referenceNamesToReferencePriors);
+        stList_append(subsamples, subsample);
+        stList_destruct(remaining);
+        remaining = discarded;
+    }
+    stList_appendAll(remainingProfileSeqs, remaining);
+    stList_destruct(remaining);
+
+    return subsamples;
+}
+
+stList *getEnsembleGenomeFragments(stList *subsamples, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params) {
+    /*
+     * Phases each of the given sub-samples of profile sequences (see getCoverageDepthBoundedSubsamples)
+     * independently, in parallel if OpenMP is available, returning the list of genome fragments inferred from all
+     * the sub-samples, for use with stGenomeFragment_reconcileWithEnsemble.
+     */
+    int64_t subsampleNumber = stList_length(subsamples);
+    stList **subsampleGenomeFragments = st_malloc(sizeof(stList *) * subsampleNumber);
+
+#if defined(_OPENMP)
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for(int64_t i=0; i<subsampleNumber; i++) {
+        subsampleGenomeFragments[i] = stList_construct();
+        stList *hmms = getRPHmms(stList_get(subsamples, i), referenceNamesToReferencePriors, params);
+        stList_setDestructor(hmms, NULL);
+        while(stList_length(hmms) > 0) {
+            stRPHmm *hmm = stList_pop(hmms);
+
+            // Phase the hmm, refining the genome fragment as for the primary reads
+            stList *path = stRPHmm_forwardBackwardTraceBack(hmm);
+            stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+            stSet *reads1 = stRPHmm_partitionSequencesByStatePath(hmm, path, true);
+            stSet *reads2 = stRPHmm_partitionSequencesByStatePath(hmm, path, false);
+            if(stSet_size(reads1) > 0 && stSet_size(reads2) > 0 && params->roundsOfIterativeRefinement > 0) {
+                stGenomeFragment_refineGenomeFragment(gF, reads1, reads2, hmm, path,
+                                                      params->roundsOfIterativeRefinement);
+            }
+            stList_append(subsampleGenomeFragments[i], gF);
+
+            // Cleanup
+            stSet_destruct(reads1);
+            stSet_destruct(reads2);
+            stList_destruct(path);
+            stRPHmm_destruct2(hmm);
+        }
+        stList_destruct(hmms);
+    }
+
+    // Combine the genome fragments
+    stList *genomeFragments = stList_construct3(0, (void (*)(void *))stGenomeFragment_destruct);
+    for(int64_t i=0; i<subsampleNumber; i++) {
+        stList_appendAll(genomeFragments, subsampleGenomeFragments[i]);
+        stList_destruct(subsampleGenomeFragments[i]);
+    }
+    free(subsampleGenomeFragments);
+
+    return genomeFragments;
+}
+
+stList *getProfileSeqChunks(stList *profileSeqs, int64_t chunkSize, int64_t chunkOverlap) {
+    /*
+     * Divides the profile sequences, which must all be aligned to the same reference sequence, into chunks
+     * so that they can be phased independently. The ith chunk is the reference interval
+     * [i*chunkSize, (i+1)*chunkSize) and contains every profile sequence that overlaps the interval extended
+     * by chunkOverlap on each side, so profile sequences may be in more than one chunk. Returns a list with
+     * one list of profile sequences for each chunk up to the last non-empty chunk; the lists do not own their
+     * profile sequences and may be empty.
+     */
+    assert(chunkSize > 0 && chunkOverlap >= 0);
+    stList *chunks = stList_construct3(0, (void (*)(void *))stList_destruct);
+
+    for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+        stProfileSeq *pSeq = stList_get(profileSeqs, i);
+        assert(strcmp(pSeq->referenceName, ((stProfileSeq *)stList_get(profileSeqs, 0))->referenceName) == 0);
+
+        // Get the first and last chunks whose extended intervals the profile sequence overlaps
+        int64_t firstChunk = pSeq->refStart - chunkOverlap < 0 ? 0 : (pSeq->refStart - chunkOverlap) / chunkSize;
+        int64_t lastChunk = (pSeq->refStart + pSeq->length + chunkOverlap - 1) / chunkSize;
+
+        while(stList_length(chunks) <= lastChunk) {
+            stList_append(chunks, stList_construct());
+        }
+        for(int64_t j=firstChunk; j<=lastChunk; j++) {
+            stList_append(stList_get(chunks, j), pSeq);
+        }
+    }
+
+    return chunks;
+}
+
+int64_t getPhasingConcordance(stSet *reads1, stSet *reads2, stSet *otherReads1, stSet *otherReads2) {
+    /*
+     * Compares two bipartitions of reads, such as those of adjacent genome fragments phased in separate
+     * chunks, matching reads by name. Returns the number of shared reads placed on the same side in both
+     * bipartitions minus the number placed on opposite sides, so a negative value indicates that the
+     * haplotypes of the second bipartition should be inverted to agree with the first, and zero that there is
+     * no evidence either way.
+     */
+    stSet *otherReadIds1 = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, NULL);
+    stSet *otherReadIds2 = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, NULL);
+    addProfileSeqIdsToSet(otherReads1, otherReadIds1);
+    addProfileSeqIdsToSet(otherReads2, otherReadIds2);
+
+    int64_t concordance = 0;
+    stSetIterator *it = stSet_getIterator(reads1);
+    stProfileSeq *pSeq;
+    while((pSeq = stSet_getNext(it)) != NULL) {
+        concordance += (stSet_search(otherReadIds1, pSeq->readId) != NULL) -
+                       (stSet_search(otherReadIds2, pSeq->readId) != NULL);
+    }
+    stSet_destructIterator(it);
+    it = stSet_getIterator(reads2);
+    while((pSeq = stSet_getNext(it)) != NULL) {
+        concordance += (stSet_search(otherReadIds2, pSeq->readId) != NULL) -
+                       (stSet_search(otherReadIds1, pSeq->readId) != NULL);
+    }
+    stSet_destructIterator(it);
+
+    stSet_destruct(otherReadIds1);
+    stSet_destruct(otherReadIds2);
+    return concordance;
+}
+
+stPhasingChunk *stPhasingChunk_construct(char *referenceName, int64_t chunkStart, int64_t chunkEnd,
+                                         stList *profileSeqs) {
+    /*
+     * Creates a chunk of the given contig owning the reference interval [chunkStart, chunkEnd), whose reads,
+     * which may extend beyond the interval, are profileSeqs. The chunk takes ownership of the list, but not of
+     * the profile sequences or the reference name. The range of the chunk's hmms is initially empty.
+     */
+    stPhasingChunk *chunk = st_calloc(1, sizeof(stPhasingChunk));
+    chunk->referenceName = referenceName;
+    chunk->chunkStart = chunkStart;
+    chunk->chunkEnd = chunkEnd;
+    chunk->profileSeqs = profileSeqs;
+    return chunk;
+}
+
+void stPhasingChunk_destruct(stPhasingChunk *chunk) {
+    stList_destruct(chunk->profileSeqs);
+    free(chunk);
+}
+
+int64_t stitchChunkPhaseBlocks(stList *chunks, stGenomeFragment **gFs, stSet **reads1s, stSet **reads2s,
+                               int64_t *blockStarts, int64_t *blockEnds, bool *stitched, bool *inverted) {
+    /*
+     * Decides how the genome fragments of the chunks' hmms are combined into phase blocks. Each genome fragment
+     * is clipped to the interval owned by its chunk, giving [blockStarts[i], blockEnds[i]), which is empty if
+     * the genome fragment lies wholly within the overlap with a neighbouring chunk. Where the last genome
+     * fragment of a chunk and the first of the next chunk both reach their shared boundary they are stitched
+     * into one phase block if the reads they share, matched by name as with the ht tags of merge_chunks.py,
+     * give evidence of their relative phase. stitched[i] is then true, and inverted[i] is true if the
+     * haplotypes of the ith genome fragment must be swapped to agree with the phase block.
+     * Returns the number of boundaries stitched.
+     */
+    int64_t stitchedBoundaries = 0;
+    int64_t previousHmm = -1; // The last hmm with a non-empty interval, in the preceding chunk
+    stPhasingChunk *previousChunk = NULL;
+    for(int64_t i=0; i<stList_length(chunks); i++) {
+        stPhasingChunk *chunk = stList_get(chunks, i);
+        bool adjacent = previousChunk != NULL && previousChunk->chunkEnd == chunk->chunkStart &&
+                        strcmp(previousChunk->referenceName, chunk->referenceName) == 0;
+        bool first = true;
+        for(int64_t j=chunk->firstHmm; j<chunk->firstHmm+chunk->hmmNumber; j++) {
+            stGenomeFragment *gF = gFs[j];
+            blockStarts[j] = gF->refStart > chunk->chunkStart ? gF->refStart : chunk->chunkStart;
+            blockEnds[j] = gF->refStart + gF->length < chunk->chunkEnd ? gF->refStart + gF->length : chunk->chunkEnd;
+            stitched[j] = false;
+            inverted[j] = false;
+            if(blockStarts[j] >= blockEnds[j]) {
+                continue;
+            }
+
+            // Stitch to the phase block that reaches the boundary from the previous chunk
+            if(first && adjacent && previousHmm != -1 && blockEnds[previousHmm] == chunk->chunkStart &&
+               blockStarts[j] == chunk->chunkStart) {
+                int64_t concordance = getPhasingConcordance(reads1s[previousHmm], reads2s[previousHmm],
+                                                            reads1s[j], reads2s[j]);
+                if(concordance != 0) {
+                    stitched[j] = true;
+                    inverted[j] = inverted[previousHmm] != (concordance < 0);
+                    stitchedBoundaries++;
+                }
+            }
+            first = false;
+            previousHmm = j;
+        }
+        previousChunk = chunk;
+        if(first) {
+            // No genome fragment of the chunk reached the next boundary
+            previousHmm = -1;
+        }
+    }
+    return stitchedBoundaries;
+}
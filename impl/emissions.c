@@ -96,7 +96,7 @@ inline int popcount64(uint64_t x) {
     return __builtin_popcountll(x);
 }
 
-static inline uint64_t *retrieveBitCountVector(uint64_t *bitCountVector,
+static inline stRPPartition *retrieveBitCountVector(stRPPartition *bitCountVector,
                                                int64_t position, int64_t characterIndex, int64_t bit) {
     /*
      * Returns a pointer to a bit count vector for a given position (offset in the column),
@@ -107,29 +107,31 @@ static inline uint64_t *retrieveBitCountVector(uint64_t *bitCountVector,
                            + bit];
 }
 
-uint64_t calculateBitCountVector(uint8_t **seqs, int64_t depth,
+stRPPartition calculateBitCountVector(uint8_t **seqs, int64_t depth,
                                  int64_t position, int64_t characterIndex, int64_t bit) {
     /*
      * Calculates the bit count vector for a given position, character index and bit.
      */
-    uint64_t bitCountVector = 0;
+    stRPPartition bitCountVector = 0;
     for(int64_t i=0; i<depth; i++) {
         uint8_t *p = &(seqs[i][ALPHABET_SIZE * position]);
-        bitCountVector |= ((((uint64_t)p[characterIndex] >> bit) & 1) << i);
+        bitCountVector |= ((((stRPPartition)p[characterIndex] >> bit) & 1) << i);
     }
 
     return bitCountVector;
 }
 
-uint64_t *calculateCountBitVectors(uint8_t **seqs, int64_t depth,
-                                   int64_t *activePositions, int64_t totalActivePositions) {
+stRPPartition *calculateCountBitVectors(uint8_t **seqs, int64_t depth,
+                                   int64_t *activePositions, int64_t totalActivePositions,
+                                   int64_t positionOffset) {
     /*
      * Calculates the bit count vector for every active position, character and bit in the column.
+     * The positionOffset is subtracted from each active position to get its offset in the seqs.
      */
 
     // Array of bit vectors, for each position, for each character and for each bit in uint8_t
-    uint64_t *bitCountVectors = st_malloc(totalActivePositions * ALPHABET_SIZE *
-                                          ALPHABET_CHARACTER_BITS * sizeof(uint64_t));
+    stRPPartition *bitCountVectors = st_malloc(totalActivePositions * ALPHABET_SIZE *
+                                          ALPHABET_CHARACTER_BITS * sizeof(stRPPartition));
 
     // For each position
     for(int64_t i=0; i<totalActivePositions; i++) {
@@ -138,7 +140,7 @@ uint64_t *calculateCountBitVectors(uint8_t **seqs, int64_t depth,
             // For each bit
             for(int64_t k=0; k<ALPHABET_CHARACTER_BITS; k++) {
                 *retrieveBitCountVector(bitCountVectors, i, j, k) =
-                        calculateBitCountVector(seqs, depth, activePositions[i], j, k);
+                        calculateBitCountVector(seqs, depth, activePositions[i] - positionOffset, j, k);
             }
         }
     }
@@ -146,7 +148,7 @@ uint64_t *calculateCountBitVectors(uint8_t **seqs, int64_t depth,
     return bitCountVectors;
 }
 
-uint64_t getExpectedInstanceNumber(uint64_t *bitCountVectors, uint64_t depth, uint64_t partition,
+uint64_t getExpectedInstanceNumber(stRPPartition *bitCountVectors, uint64_t depth, stRPPartition partition,
                                    int64_t position, int64_t characterIndex) {
     /*
      * Returns the number of instances of a character, given by characterIndex,
@@ -154,11 +156,11 @@ uint64_t getExpectedInstanceNumber(uint64_t *bitCountVectors, uint64_t depth, ui
      * Returns value scaled between 0 and ALPHABET_MAX_PROB, where the return value divided by ALPHABET_MAX_PROB
      * is the expected number of instances of the given character in the given subpartition of the column.
      */
-    uint64_t *j = retrieveBitCountVector(bitCountVectors, position, characterIndex, 0);
-    uint64_t expectedCount = popcount64(j[0] & partition);
+    stRPPartition *j = retrieveBitCountVector(bitCountVectors, position, characterIndex, 0);
+    uint64_t expectedCount = popcountPartition(j[0] & partition);
 
     for(int64_t i=1; i<ALPHABET_CHARACTER_BITS; i++) {
-        expectedCount += (popcount64(j[i] & partition) << i);
+        expectedCount += (popcountPartition(j[i] & partition) << i);
     }
 
     assert(expectedCount >= 0.0);
@@ -187,7 +189,7 @@ static inline uint64_t minP(uint64_t a, uint64_t b) {
 }
 
 static inline void columnIndexLogHapProbability(stRPColumn *column, uint64_t index,
-                                                uint64_t partition, uint64_t *bitCountVectors,
+                                                stRPPartition partition, stRPPartition *bitCountVectors,
                                                 stRPHmmParameters *params,
                                                 uint64_t *rootCharacterProbs) {
     /*
@@ -220,7 +222,7 @@ static inline void columnIndexLogHapProbability(stRPColumn *column, uint64_t ind
 }
 
 static inline uint64_t columnIndexLogProbability(stRPColumn *column, uint64_t index,
-                                                 uint64_t partition, uint64_t *bitCountVectors,
+                                                 stRPPartition partition, stRPPartition *bitCountVectors,
                                                  uint16_t *referencePriorProbs,
                                                  stRPHmmParameters *params) {
     /*
@@ -248,7 +250,7 @@ static inline uint64_t columnIndexLogProbability(stRPColumn *column, uint64_t in
 }
 
 double emissionLogProbability(stRPColumn *column,
-                              stRPCell *cell, uint64_t *bitCountVectors, stReferencePriorProbs *referencePriorProbs,
+                              stRPCell *cell, stRPPartition *bitCountVectors, stReferencePriorProbs *referencePriorProbs,
                               stRPHmmParameters *params) {
     /*
      * Get the log probability of a set of reads for a given column.
@@ -258,7 +260,8 @@ double emissionLogProbability(stRPColumn *column,
     for(int64_t i=0; i<column->totalActivePositions; i++) {
 
         // Get the reference prior probabilities
-        int64_t j = column->refStart + column->activePositions[i] - referencePriorProbs->refStart;
+        int64_t j = column->activePositions[i];
+        assert(column->refStart - referencePriorProbs->refStart == column->activePositionsOffset);
         uint16_t *rProbs = &referencePriorProbs->profileProbs[j * ALPHABET_SIZE];
 
         logPartitionProb += columnIndexLogProbability(column, i, cell->partition, bitCountVectors, rProbs, params);
@@ -289,7 +292,7 @@ double getLogProbOfReadCharactersSlow(double *logSubMatrix, uint64_t *expectedIn
 }
 
 void columnIndexLogHapProbabilitySlow(stRPColumn *column, uint64_t index,
-                                      uint64_t partition, uint64_t *bitCountVectors,
+                                      stRPPartition partition, stRPPartition *bitCountVectors,
                                       stRPHmmParameters *params, double *characterProbsHap) {
     /*
      * Get the probabilities of the haplotype characters for a given read sub-partition and a haplotype.
@@ -328,7 +331,7 @@ void calculateRootCharacterProbs(double *characterProbsHap, stRPHmmParameters *p
 }
 
 void columnIndexLogRootHapProbabilitySlow(stRPColumn *column, uint64_t index,
-                                          uint64_t partition, uint64_t *bitCountVectors,
+                                          stRPPartition partition, stRPPartition *bitCountVectors,
                                           stRPHmmParameters *params, double *rootCharacterProbs, bool maxNotSum) {
     /*
      * Get the probabilities of the "root" characters for a given read sub-partition and a haplotype.
@@ -342,7 +345,7 @@ void columnIndexLogRootHapProbabilitySlow(stRPColumn *column, uint64_t index,
 }
 
 double columnIndexLogProbabilitySlow(stRPColumn *column, uint64_t index,
-                                     uint64_t partition, uint64_t *bitCountVectors, uint16_t *referencePriorProbs,
+                                     stRPPartition partition, stRPPartition *bitCountVectors, uint16_t *referencePriorProbs,
                                      stRPHmmParameters *params, bool maxNotSum) {
     /*
      * Get the probability of a the characters in a given position within a column for a given partition.
@@ -367,7 +370,7 @@ double columnIndexLogProbabilitySlow(stRPColumn *column, uint64_t index,
 }
 
 double emissionLogProbabilitySlow(stRPColumn *column,
-                                  stRPCell *cell, uint64_t *bitCountVectors, stReferencePriorProbs *referencePriorProbs,
+                                  stRPCell *cell, stRPPartition *bitCountVectors, stReferencePriorProbs *referencePriorProbs,
                                   stRPHmmParameters *params, bool maxNotSum) {
     /*
      * Get the log probability of a set of reads for a given column.
@@ -429,7 +432,7 @@ double getHaplotypeProb(double characterReadProb,
     return logHapProb;
 }
 
-uint8_t getReadDepth(uint64_t *bitCountVectors, uint64_t depth, uint64_t partition, int64_t index) {
+uint8_t getReadDepth(stRPPartition *bitCountVectors, uint64_t depth, stRPPartition partition, int64_t index) {
     /*
      * Calculates the read depth at a given position.
      */
@@ -440,36 +443,30 @@ uint8_t getReadDepth(uint64_t *bitCountVectors, uint64_t depth, uint64_t partiti
     return readDepth;
 }
 
-void fillInPredictedGenomePosition(stGenomeFragment *gF, uint64_t partition,
-                                   stRPColumn *column, stRPHmmParameters *params,
-                                   stReferencePriorProbs *referencePriorProbs,
-                                   uint64_t *bitCountVectors, uint64_t index) {
+static void getMLHapChars(stRPPartition partition, stRPColumn *column, stRPHmmParameters *params,
+                          uint16_t *rProbs, stRPPartition *bitCountVectors, uint64_t bitCountVectorIndex,
+                          double *characterProbsHap1, double *characterProbsHap2,
+                          double *rootCharacterProbsHap1, double *rootCharacterProbsHap2,
+                          double *logColumnProbSum, uint64_t *hapChar1, uint64_t *hapChar2) {
     /*
-     * Computes the most probable haplotype characters / genotype and associated posterior
-     * probabilities for a given position within a cell/column.
+     * Gets the most probable haplotype characters at a position within a cell/column, given the root character
+     * with maximum posterior probability, for the given partition and reference prior probabilities rProbs.
+     * The bitCountVectorIndex gives the index of the position in bitCountVectors. Also fills in the log
+     * probabilities of the characters of each haplotype, the sum of these over the possible root characters and
+     * the log probability of the column summed over the root characters, which are needed to compute
+     * posterior probabilities.
      */
 
-    int64_t rProbsIndex = column->refStart - referencePriorProbs->refStart + index;
-    uint16_t *rProbs = &referencePriorProbs->profileProbs[rProbsIndex*ALPHABET_SIZE];
-
-    // Get the haplotype characters that are most probable given the root character
-    double characterProbsHap1[ALPHABET_SIZE];
-    double characterProbsHap2[ALPHABET_SIZE];
-
-    columnIndexLogHapProbabilitySlow(column, index,
+    // Get the probabilities of the haplotype characters
+    columnIndexLogHapProbabilitySlow(column, bitCountVectorIndex,
                                      partition, bitCountVectors,
                                      params, characterProbsHap1);
 
-    columnIndexLogHapProbabilitySlow(column, index,
+    columnIndexLogHapProbabilitySlow(column, bitCountVectorIndex,
                                      ~partition, bitCountVectors,
                                      params, characterProbsHap2);
 
-    // Get the root character with maximum posterior probability.
-
     // Get the sum of log probabilities of the derived characters over the possible source characters
-    double rootCharacterProbsHap1[ALPHABET_SIZE];
-    double rootCharacterProbsHap2[ALPHABET_SIZE];
-
     calculateRootCharacterProbs(characterProbsHap1, params,
                                 rootCharacterProbsHap1, 0);
     calculateRootCharacterProbs(characterProbsHap2, params,
@@ -477,26 +474,67 @@ void fillInPredictedGenomePosition(stGenomeFragment *gF, uint64_t partition,
 
     // Combine the probabilities to calculate the overall probability of a given partition of
     // read characters and the root character with maximum posterior prob
-    double logColumnProbSum = rootCharacterProbsHap1[0] + rootCharacterProbsHap2[0] +
-                              invertScaleToLogIntegerSubMatrix(rProbs[0]);
-    double logColumnProbMax = logColumnProbSum;
+    *logColumnProbSum = rootCharacterProbsHap1[0] + rootCharacterProbsHap2[0] +
+                        invertScaleToLogIntegerSubMatrix(rProbs[0]);
+    double logColumnProbMax = *logColumnProbSum;
     int64_t maxProbRootChar = 0;
     for(int64_t i=1; i<ALPHABET_SIZE; i++) {
         double logColumnProb = rootCharacterProbsHap1[i] + rootCharacterProbsHap2[i] +
                                invertScaleToLogIntegerSubMatrix(rProbs[i]);
-        logColumnProbSum = stMath_logAdd(logColumnProbSum, logColumnProb);
+        *logColumnProbSum = stMath_logAdd(*logColumnProbSum, logColumnProb);
         if(logColumnProb > logColumnProbMax) {
             logColumnProbMax = logColumnProb;
             maxProbRootChar = i;
         }
     }
 
+    // Get the haplotype characters with highest posterior probability given the root character
+    *hapChar1 = getMLHapChar(characterProbsHap1, params, maxProbRootChar);
+    *hapChar2 = getMLHapChar(characterProbsHap2, params, maxProbRootChar);
+}
+
+static void fillInPredictedReadDepthAndAlleleCounts(stGenomeFragment *gF, stRPPartition partition,
+                                                    stRPColumn *column, stRPPartition *bitCountVectors,
+                                                    uint64_t index) {
+    /*
+     * Fills in the read depths of the two haplotypes and the expected counts of the haplotype characters
+     * gF predicts for a given position within a cell/column.
+     */
     int64_t j = column->refStart + index - gF->refStart;
+    uint64_t hapChar1 = gF->haplotypeString1[j], hapChar2 = gF->haplotypeString2[j];
+    gF->hap1Depth[j] = getReadDepth(bitCountVectors, column->depth, partition, index);
+    gF->hap2Depth[j] = getReadDepth(bitCountVectors, column->depth, ~partition, index);
+    gF->alleleCountsHap1[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, partition, index, hapChar1) / ALPHABET_MAX_PROB;
+    gF->alleleCountsHap2[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, ~partition, index, hapChar1) / ALPHABET_MAX_PROB;
+    gF->allele2CountsHap1[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, partition, index, hapChar2) / ALPHABET_MAX_PROB;
+    gF->allele2CountsHap2[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, ~partition, index, hapChar2) / ALPHABET_MAX_PROB;
+}
 
-    // Get the haplotype characters with highest posterior probability.
-    uint64_t hapChar1  = getMLHapChar(characterProbsHap1, params, maxProbRootChar);
+void fillInPredictedGenomePosition(stGenomeFragment *gF, stRPPartition partition,
+                                   stRPColumn *column, stRPHmmParameters *params,
+                                   stReferencePriorProbs *referencePriorProbs,
+                                   stRPPartition *bitCountVectors, uint64_t index) {
+    /*
+     * Computes the most probable haplotype characters / genotype and associated posterior
+     * probabilities for a given position within a cell/column.
+     */
+
+    int64_t rProbsIndex = column->refStart - referencePriorProbs->refStart + index;
+    uint16_t *rProbs = &referencePriorProbs->profileProbs[rProbsIndex*ALPHABET_SIZE];
+
+    // Get the haplotype characters with highest posterior probability
+    double characterProbsHap1[ALPHABET_SIZE];
+    double characterProbsHap2[ALPHABET_SIZE];
+    double rootCharacterProbsHap1[ALPHABET_SIZE];
+    double rootCharacterProbsHap2[ALPHABET_SIZE];
+    double logColumnProbSum;
+    uint64_t hapChar1, hapChar2;
+    getMLHapChars(partition, column, params, rProbs, bitCountVectors, index,
+                  characterProbsHap1, characterProbsHap2, rootCharacterProbsHap1, rootCharacterProbsHap2,
+                  &logColumnProbSum, &hapChar1, &hapChar2);
+
+    int64_t j = column->refStart + index - gF->refStart;
     gF->haplotypeString1[j] = hapChar1;
-    uint64_t hapChar2 = getMLHapChar(characterProbsHap2, params, maxProbRootChar);
     gF->haplotypeString2[j] = hapChar2;
 
     // Calculate haplotype probabilities
@@ -542,20 +580,111 @@ void fillInPredictedGenomePosition(stGenomeFragment *gF, uint64_t partition,
 
     // Update reference sequence and read depth info
      gF->referenceSequence[j] = referencePriorProbs->referenceSequence[rProbsIndex];
-    gF->hap1Depth[j] = getReadDepth(bitCountVectors, column->depth, partition, index);
-    gF->hap2Depth[j] = getReadDepth(bitCountVectors, column->depth, ~partition, index);
-    gF->alleleCountsHap1[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, partition, index, hapChar1) / ALPHABET_MAX_PROB;
-    gF->alleleCountsHap2[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, ~partition, index, hapChar1) / ALPHABET_MAX_PROB;
-    gF->allele2CountsHap1[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, partition, index, hapChar2) / ALPHABET_MAX_PROB;
-    gF->allele2CountsHap2[j] = getExpectedInstanceNumber(bitCountVectors, column->depth, ~partition, index, hapChar2) / ALPHABET_MAX_PROB;
+    fillInPredictedReadDepthAndAlleleCounts(gF, partition, column, bitCountVectors, index);
+}
+
+static uint64_t getPileupHapChar(stRPPartition *bitCountVectors, uint64_t depth, stRPPartition partition,
+                                 int64_t index, uint64_t referenceChar, uint16_t *rProbs, float *hapProb) {
+    /*
+     * Returns the most frequent character among the reads in the given partition at the given position,
+     * breaking ties first by the frequency of the characters among all the reads in the column and then in
+     * favour of the reference character. Sets hapProb to the fraction of the expected instances in the
+     * partition that are of the returned character. If no read in the partition covers the position the
+     * most probable character under the reference prior (rProbs) is returned instead, with hapProb set
+     * to its normalised prior probability.
+     */
+    uint64_t maxChar = referenceChar, maxCount = 0, maxScore = 0, totalCount = 0;
+    for(uint64_t i=0; i<ALPHABET_SIZE; i++) {
+        uint64_t count = getExpectedInstanceNumber(bitCountVectors, depth, partition, index, i);
+        uint64_t columnCount = getExpectedInstanceNumber(bitCountVectors, depth, ~((stRPPartition)0), index, i);
+        totalCount += count;
+
+        // Expected instance numbers are less than 2^16, so the partition count dominates the score
+        uint64_t score = (count << 16) + columnCount;
+        if(score > maxScore || (score == maxScore && i == referenceChar)) {
+            maxChar = i;
+            maxCount = count;
+            maxScore = score;
+        }
+    }
+    if(totalCount > 0) {
+        *hapProb = (float)maxCount / totalCount;
+        return maxChar;
+    }
+
+    // Empty partition, so fall back to the reference prior
+    double maxPrior = 0.0, totalPrior = 0.0;
+    maxChar = referenceChar;
+    for(uint64_t i=0; i<ALPHABET_SIZE; i++) {
+        double prior = exp(invertScaleToLogIntegerSubMatrix(rProbs[i]));
+        totalPrior += prior;
+        if(prior > maxPrior || (prior == maxPrior && i == referenceChar)) {
+            maxChar = i;
+            maxPrior = prior;
+        }
+    }
+    *hapProb = maxPrior / totalPrior;
+    return maxChar;
+}
+
+static void fillInPredictedGenomePositionFromPileup(stGenomeFragment *gF, stRPPartition partition,
+                                                    stRPColumn *column, stReferencePriorProbs *referencePriorProbs,
+                                                    stRPPartition *bitCountVectors, uint64_t index) {
+    /*
+     * Cheap alternative to fillInPredictedGenomePosition for positions excluded by the reference position
+     * filter (see stReferencePriorProbs_setReferencePositionFilter), which are likely homozygous.
+     * Given the partition, each haplotype character is the most frequent read character in its half of the
+     * partition, with probabilities taken from the pileup fractions rather than the full genotype model.
+     */
+
+    int64_t rProbsIndex = column->refStart - referencePriorProbs->refStart + index;
+    uint64_t referenceChar = referencePriorProbs->referenceSequence[rProbsIndex];
+    uint16_t *rProbs = &referencePriorProbs->profileProbs[rProbsIndex*ALPHABET_SIZE];
+    int64_t j = column->refStart + index - gF->refStart;
+
+    // Get the haplotype characters and their pileup fractions
+    float hapProb1, hapProb2;
+    uint64_t hapChar1 = getPileupHapChar(bitCountVectors, column->depth, partition, index, referenceChar,
+                                          rProbs, &hapProb1);
+    uint64_t hapChar2 = getPileupHapChar(bitCountVectors, column->depth, ~partition, index, referenceChar,
+                                          rProbs, &hapProb2);
+    gF->haplotypeString1[j] = hapChar1;
+    gF->haplotypeString2[j] = hapChar2;
+    gF->haplotypeProbs1[j] = hapProb1;
+    gF->haplotypeProbs2[j] = hapProb2;
+
+    // Get combined genotype and its probability
+    uint64_t genotype = hapChar1 < hapChar2 ? hapChar1 * ALPHABET_SIZE + hapChar2 :
+                        hapChar2 * ALPHABET_SIZE + hapChar1;
+    gF->genotypeString[j] = genotype;
+    gF->genotypeProbs[j] = hapProb1 * hapProb2;
+
+    // Fill in genotype likelihoods array, all genotypes other than the called one sharing the
+    // probability that the call is wrong
+    float otherGenotypeLikelihood = -10 * log10f(1.0f - gF->genotypeProbs[j]);
+    if (otherGenotypeLikelihood > 1000) otherGenotypeLikelihood = 1000;
+    if (otherGenotypeLikelihood <= 0) otherGenotypeLikelihood = 0;
+    for (int64_t c1=0; c1<ALPHABET_SIZE; c1++) {
+        for (int64_t c2=0; c2<ALPHABET_SIZE; c2++) {
+            gF->genotypeLikelihoods[j][c1*ALPHABET_SIZE+c2] =
+                    (c1 == (int64_t)hapChar1 && c2 == (int64_t)hapChar2) ? 0 : otherGenotypeLikelihood;
+        }
+    }
+
+    // Update reference sequence and read depth info
+    gF->referenceSequence[j] = referenceChar;
+    fillInPredictedReadDepthAndAlleleCounts(gF, partition, column, bitCountVectors, index);
 }
 
-void fillInPredictedGenome(stGenomeFragment *gF, uint64_t partition,
+void fillInPredictedGenome(stGenomeFragment *gF, stRPPartition partition,
                            stRPColumn *column, stReferencePriorProbs *referencePriorProbs, stRPHmmParameters *params) {
     /*
      * Computes the most probable haplotype characters / genotypes and associated posterior
      * probabilities for a given interval defined by a cell/column. Fills in these values in the
      * genome fragment argument.
+     *
+     * Every position of the column is visited. With params->genotypeFilteredPositionsFromPileup only the
+     * per-position genotyping of filtered positions is made cheaper; the HMM itself is not made sparse.
      */
     
     //  Following makes an array in which all positions are marked active
@@ -565,14 +694,112 @@ void fillInPredictedGenome(stGenomeFragment *gF, uint64_t partition,
     }
 
     // Calculate the bit vectors
-    uint64_t *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth,
-                                                         activePositions, column->length);
+    stRPPartition *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth,
+                                                         activePositions, column->length, 0);
 
     assert(column->length > 0);
 
     for(uint64_t i=0; i<column->length; i++) {
-        fillInPredictedGenomePosition(gF, partition, column, params,
-                                      referencePriorProbs, bitCountVectors, i);
+        // Positions excluded by the reference position filter can optionally be genotyped from the pileup
+        if(params->genotypeFilteredPositionsFromPileup &&
+           !referencePriorProbs->referencePositionsIncluded[column->refStart - referencePriorProbs->refStart + i]) {
+            fillInPredictedGenomePositionFromPileup(gF, partition, column, referencePriorProbs, bitCountVectors, i);
+        }
+        else {
+            fillInPredictedGenomePosition(gF, partition, column, params,
+                                          referencePriorProbs, bitCountVectors, i);
+        }
+    }
+
+    // Cleanup
+    free(bitCountVectors);
+}
+
+void fillInPredictedAlleleCounts(stGenomeFragment *gF, stRPPartition partition, stRPColumn *column,
+                                 bool *updatedPositions) {
+    /*
+     * Recomputes the read depths and allele counts of gF for the positions within a given interval defined by a
+     * cell/column at which updatedPositions, which is indexed from gF->refStart, is true. This keeps them
+     * consistent with haplotype characters changed other than by fillInPredictedGenome.
+     */
+    bool updated = false;
+    for(uint64_t i=0; i<column->length && !updated; i++) {
+        int64_t j = column->refStart + i - gF->refStart;
+        updated = j >= 0 && j < gF->length && updatedPositions[j];
+    }
+    if(!updated) {
+        return;
+    }
+
+    int64_t activePositions[column->length];
+    for(int64_t i=0; i<column->length; i++) {
+        activePositions[i] = i;
+    }
+    stRPPartition *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth,
+                                                              activePositions, column->length, 0);
+
+    for(uint64_t i=0; i<column->length; i++) {
+        int64_t j = column->refStart + i - gF->refStart;
+        if(j >= 0 && j < gF->length && updatedPositions[j]) {
+            fillInPredictedReadDepthAndAlleleCounts(gF, partition, column, bitCountVectors, i);
+        }
+    }
+
+    // Cleanup
+    free(bitCountVectors);
+}
+
+static bool predictedGenomePositionIsHeterozygous(stRPPartition partition,
+                                                  stRPColumn *column, stRPHmmParameters *params,
+                                                  stReferencePriorProbs *referencePriorProbs,
+                                                  stRPPartition *bitCountVectors, uint64_t bitCountVectorIndex,
+                                                  int64_t index) {
+    /*
+     * Returns true if the most probable haplotype characters at the given position within a cell/column differ.
+     * These are computed by getMLHapChars, as for fillInPredictedGenomePosition, so the two always agree. The
+     * bitCountVectorIndex gives the index of the position in bitCountVectors.
+     */
+
+    int64_t rProbsIndex = column->refStart - referencePriorProbs->refStart + index;
+    uint16_t *rProbs = &referencePriorProbs->profileProbs[rProbsIndex*ALPHABET_SIZE];
+
+    double characterProbsHap1[ALPHABET_SIZE];
+    double characterProbsHap2[ALPHABET_SIZE];
+    double rootCharacterProbsHap1[ALPHABET_SIZE];
+    double rootCharacterProbsHap2[ALPHABET_SIZE];
+    double logColumnProbSum;
+    uint64_t hapChar1, hapChar2;
+    getMLHapChars(partition, column, params, rProbs, bitCountVectors, bitCountVectorIndex,
+                  characterProbsHap1, characterProbsHap2, rootCharacterProbsHap1, rootCharacterProbsHap2,
+                  &logColumnProbSum, &hapChar1, &hapChar2);
+
+    return hapChar1 != hapChar2;
+}
+
+void addPredictedHeterozygousSites(stList *hetSites, stRPPartition partition,
+                                   stRPColumn *column, stReferencePriorProbs *referencePriorProbs,
+                                   stRPHmmParameters *params) {
+    /*
+     * Appends to hetSites the reference coordinates, as stIntTuples, of the active positions in the column
+     * at which the most probable haplotype characters for the given partition differ. Positions that are
+     * filtered out are assumed to be homozygous and are not considered.
+     */
+
+    if(column->totalActivePositions == 0) {
+        return;
+    }
+
+    // Calculate the bit vectors for just the active positions
+    stRPPartition *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth,
+                                                         column->activePositions, column->totalActivePositions,
+                                                         column->activePositionsOffset);
+
+    for(uint64_t i=0; i<column->totalActivePositions; i++) {
+        int64_t index = column->activePositions[i] - column->activePositionsOffset;
+        if(predictedGenomePositionIsHeterozygous(partition, column, params, referencePriorProbs,
+                                                 bitCountVectors, i, index)) {
+            stList_append(hetSites, stIntTuple_construct1(column->refStart + index));
+        }
     }
 
     // Cleanup
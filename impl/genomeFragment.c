@@ -6,17 +6,17 @@
 
 #include "stRPHmm.h"
 
-stGenomeFragment *stGenomeFragment_construct(stRPHmm *hmm, stList *path) {
+stGenomeFragment *stGenomeFragment_constructEmpty(char *referenceName, int64_t refStart, int64_t length) {
     /*
-     * Returns an genome fragment inferred from the hmm and given path through it.
+     * Returns a genome fragment covering the given reference interval, with all of its arrays zeroed.
      */
 
     stGenomeFragment *gF = st_calloc(1, sizeof(stGenomeFragment));
 
     // Set coordinates
-    gF->referenceName = stString_copy(hmm->referenceName);
-    gF->refStart = hmm->refStart;
-    gF->length = hmm->refLength;
+    gF->referenceName = stString_copy(referenceName);
+    gF->refStart = refStart;
+    gF->length = length;
 
     // Allocate genotype arrays
     gF->genotypeString = st_calloc(gF->length, sizeof(uint64_t));
@@ -44,6 +44,16 @@ stGenomeFragment *stGenomeFragment_construct(stRPHmm *hmm, stList *path) {
     gF->haplotypeString2 = st_calloc(gF->length, sizeof(uint64_t));
     gF->haplotypeProbs2 = st_calloc(gF->length, sizeof(float));
 
+    return gF;
+}
+
+stGenomeFragment *stGenomeFragment_construct(stRPHmm *hmm, stList *path) {
+    /*
+     * Returns an genome fragment inferred from the hmm and given path through it.
+     */
+
+    stGenomeFragment *gF = stGenomeFragment_constructEmpty(hmm->referenceName, hmm->refStart, hmm->refLength);
+
     // For each cell in the hmm
     stRPColumn *column = hmm->firstColumn;
     for(int64_t i=0; i<stList_length(path)-1; i++) {
@@ -115,7 +125,7 @@ stSet *findReadsThatWereMoreProbablyGeneratedByTheOtherHaplotype(uint64_t *haplo
     return subset;
 }
 
-static uint64_t flipReadsBetweenPartitions(uint64_t partition, stRPColumn *column, stSet *flippingReads) {
+static stRPPartition flipReadsBetweenPartitions(stRPPartition partition, stRPColumn *column, stSet *flippingReads) {
 
     for(uint64_t i=0; i<column->depth; i++) {
         stProfileSeq *pSeq = column->seqHeaders[i];
@@ -137,7 +147,7 @@ void stGenomeFragment_refineGenomeFragment(stGenomeFragment *gF, stSet *reads1,
 
     // Copy the path as a sequence of unsigned integers, one for each cell on the path
     int64_t pathLength = stList_length(path);
-    uint64_t p[pathLength];
+    stRPPartition p[pathLength];
     for(int64_t i=0; i<pathLength; i++) {
         p[i] = ((stRPCell *)stList_get(path, i))->partition;
     }
@@ -190,6 +200,47 @@ void stGenomeFragment_refineGenomeFragment(stGenomeFragment *gF, stSet *reads1,
     }
 }
 
+void stGenomeFragment_copyInterval(stGenomeFragment *gF, stGenomeFragment *sourceGF, int64_t refStart,
+                                   int64_t refEnd, bool invertHaplotypes) {
+    /*
+     * Copies the predictions of sourceGF for the reference interval [refStart, refEnd) into gF, which must both
+     * contain the interval. If invertHaplotypes is true the two haplotypes of sourceGF are swapped as they are
+     * copied, so that genome fragments phased independently can be stitched together into one phase block.
+     */
+    assert(strcmp(gF->referenceName, sourceGF->referenceName) == 0);
+    assert(refStart >= gF->refStart && refEnd <= gF->refStart + gF->length);
+    assert(refStart >= sourceGF->refStart && refEnd <= sourceGF->refStart + sourceGF->length);
+
+    for(int64_t p=refStart; p<refEnd; p++) {
+        int64_t i = p - gF->refStart, j = p - sourceGF->refStart;
+
+        // Genotypes, which are unordered, and genotype likelihoods, which are indexed by the characters of
+        // haplotype 1 and then haplotype 2, so are transposed when the haplotypes are swapped
+        gF->genotypeString[i] = sourceGF->genotypeString[j];
+        gF->genotypeProbs[i] = sourceGF->genotypeProbs[j];
+        for(int64_t c1 = 0; c1 < ALPHABET_SIZE; c1++) {
+            for(int64_t c2 = 0; c2 < ALPHABET_SIZE; c2++) {
+                gF->genotypeLikelihoods[i][c1*ALPHABET_SIZE+c2] = invertHaplotypes ?
+                        sourceGF->genotypeLikelihoods[j][c2*ALPHABET_SIZE+c1] :
+                        sourceGF->genotypeLikelihoods[j][c1*ALPHABET_SIZE+c2];
+            }
+        }
+        gF->referenceSequence[i] = sourceGF->referenceSequence[j];
+
+        // Haplotypes, depths and allele counts
+        gF->haplotypeString1[i] = invertHaplotypes ? sourceGF->haplotypeString2[j] : sourceGF->haplotypeString1[j];
+        gF->haplotypeString2[i] = invertHaplotypes ? sourceGF->haplotypeString1[j] : sourceGF->haplotypeString2[j];
+        gF->haplotypeProbs1[i] = invertHaplotypes ? sourceGF->haplotypeProbs2[j] : sourceGF->haplotypeProbs1[j];
+        gF->haplotypeProbs2[i] = invertHaplotypes ? sourceGF->haplotypeProbs1[j] : sourceGF->haplotypeProbs2[j];
+        gF->hap1Depth[i] = invertHaplotypes ? sourceGF->hap2Depth[j] : sourceGF->hap1Depth[j];
+        gF->hap2Depth[i] = invertHaplotypes ? sourceGF->hap1Depth[j] : sourceGF->hap2Depth[j];
+        gF->alleleCountsHap1[i] = invertHaplotypes ? sourceGF->alleleCountsHap2[j] : sourceGF->alleleCountsHap1[j];
+        gF->alleleCountsHap2[i] = invertHaplotypes ? sourceGF->alleleCountsHap1[j] : sourceGF->alleleCountsHap2[j];
+        gF->allele2CountsHap1[i] = invertHaplotypes ? sourceGF->allele2CountsHap2[j] : sourceGF->allele2CountsHap1[j];
+        gF->allele2CountsHap2[i] = invertHaplotypes ? sourceGF->allele2CountsHap1[j] : sourceGF->allele2CountsHap2[j];
+    }
+}
+
 void stGenomeFragment_destruct(stGenomeFragment *genomeFragment) {
 
     // Coordinates
@@ -221,3 +272,110 @@ void stGenomeFragment_destruct(stGenomeFragment *genomeFragment) {
     free(genomeFragment);
 }
 
+static bool ensembleGenomeFragmentIsInverted(stGenomeFragment *gF, stGenomeFragment *eGF,
+                                             int64_t overlapStart, int64_t overlapEnd) {
+    /*
+     * Returns true if the haplotypes of the ensemble genome fragment eGF better match the inverse of those of gF,
+     * counting the positions in the overlap at which both genome fragments predict a heterozygous site.
+     */
+    int64_t cis = 0, trans = 0;
+    for(int64_t p=overlapStart; p<overlapEnd; p++) {
+        int64_t i = p - gF->refStart, j = p - eGF->refStart;
+        if(gF->haplotypeString1[i] != gF->haplotypeString2[i] &&
+           eGF->haplotypeString1[j] != eGF->haplotypeString2[j]) {
+            cis += gF->haplotypeString1[i] == eGF->haplotypeString1[j] &&
+                   gF->haplotypeString2[i] == eGF->haplotypeString2[j];
+            trans += gF->haplotypeString1[i] == eGF->haplotypeString2[j] &&
+                     gF->haplotypeString2[i] == eGF->haplotypeString1[j];
+        }
+    }
+    return trans > cis;
+}
+
+void stGenomeFragment_reconcileWithEnsemble(stGenomeFragment *gF, stRPHmm *hmm, stList *path,
+                                            stList *ensembleGenomeFragments) {
+    /*
+     * Replaces the haplotypes predicted by gF with the consensus of gF and the overlapping genome fragments in
+     * ensembleGenomeFragments, which are inferred from other sub-samples of the reads (see
+     * getEnsembleGenomeFragments). Each ensemble genome fragment is first oriented to the haplotypes of gF, then
+     * at each position the pair of haplotype characters predicted by the most genome fragments is chosen, ties
+     * being resolved in favour of gF. Where the pair changes, the probabilities are set to the fraction of the
+     * genome fragments that voted for it, and the allele counts are recomputed from the reads of the hmm and
+     * the partitions of the path from which gF was computed.
+     */
+
+    // Get the overlapping ensemble genome fragments and their orientations
+    stList *overlapping = stList_construct();
+    stList *inverted = stList_construct();
+    for(int64_t i=0; i<stList_length(ensembleGenomeFragments); i++) {
+        stGenomeFragment *eGF = stList_get(ensembleGenomeFragments, i);
+        int64_t overlapStart = eGF->refStart > gF->refStart ? eGF->refStart : gF->refStart;
+        int64_t overlapEnd = eGF->refStart + eGF->length < gF->refStart + gF->length ?
+                             eGF->refStart + eGF->length : gF->refStart + gF->length;
+        if(overlapStart < overlapEnd && strcmp(eGF->referenceName, gF->referenceName) == 0) {
+            stList_append(overlapping, eGF);
+            stList_append(inverted, ensembleGenomeFragmentIsInverted(gF, eGF, overlapStart, overlapEnd) ? eGF : NULL);
+        }
+    }
+
+    // Vote on the haplotype characters at each position
+    bool *updatedPositions = st_calloc(gF->length, sizeof(bool));
+    bool updated = false;
+    int64_t votes[ALPHABET_SIZE * ALPHABET_SIZE];
+    for(int64_t i=0; i<gF->length && stList_length(overlapping) > 0; i++) {
+        memset(votes, 0, sizeof(votes));
+        uint64_t bestPair = gF->haplotypeString1[i] * ALPHABET_SIZE + gF->haplotypeString2[i];
+        votes[bestPair] = 1;
+        int64_t totalVotes = 1;
+        for(int64_t k=0; k<stList_length(overlapping); k++) {
+            stGenomeFragment *eGF = stList_get(overlapping, k);
+            int64_t j = gF->refStart + i - eGF->refStart;
+            if(j >= 0 && j < eGF->length) {
+                uint64_t pair = stList_get(inverted, k) == NULL ?
+                                eGF->haplotypeString1[j] * ALPHABET_SIZE + eGF->haplotypeString2[j] :
+                                eGF->haplotypeString2[j] * ALPHABET_SIZE + eGF->haplotypeString1[j];
+                votes[pair]++;
+                totalVotes++;
+                if(votes[pair] > votes[bestPair]) {
+                    bestPair = pair;
+                }
+            }
+        }
+
+        // Update the position if the consensus differs from the prediction of gF
+        uint64_t hapChar1 = bestPair / ALPHABET_SIZE, hapChar2 = bestPair % ALPHABET_SIZE;
+        if(hapChar1 != gF->haplotypeString1[i] || hapChar2 != gF->haplotypeString2[i]) {
+            float prob = (float)votes[bestPair] / totalVotes;
+            gF->haplotypeString1[i] = hapChar1;
+            gF->haplotypeString2[i] = hapChar2;
+            gF->haplotypeProbs1[i] = prob;
+            gF->haplotypeProbs2[i] = prob;
+            gF->genotypeString[i] = hapChar1 < hapChar2 ? hapChar1 * ALPHABET_SIZE + hapChar2 :
+                                    hapChar2 * ALPHABET_SIZE + hapChar1;
+            gF->genotypeProbs[i] = prob;
+            float otherGenotypeLikelihood = -10 * log10f(1.0f - prob);
+            if (otherGenotypeLikelihood > 1000) otherGenotypeLikelihood = 1000;
+            if (otherGenotypeLikelihood <= 0) otherGenotypeLikelihood = 0;
+            for(int64_t c=0; c<ALPHABET_SIZE * ALPHABET_SIZE; c++) {
+                gF->genotypeLikelihoods[i][c] = c == bestPair ? 0 : otherGenotypeLikelihood;
+            }
+            updatedPositions[i] = true;
+            updated = true;
+        }
+    }
+
+    // Update the allele counts of the changed positions
+    stRPColumn *column = hmm->firstColumn;
+    for(int64_t i=0; updated && i<stList_length(path); i++) {
+        stRPCell *cell = stList_get(path, i);
+        fillInPredictedAlleleCounts(gF, cell->partition, column, updatedPositions);
+        if(column->nColumn != NULL) {
+            column = column->nColumn->nColumn;
+        }
+    }
+
+    // Cleanup
+    free(updatedPositions);
+    stList_destruct(overlapping);
+    stList_destruct(inverted);
+}
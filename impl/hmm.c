@@ -86,9 +86,11 @@ void stRPHmmParameters_printParameters(stRPHmmParameters *params, FILE *fH) {
             "\t\tMax_read coverage_depth: %" PRIi64 "\n"
             "\t\tMax_not sum transitions?: %i\n"
             "\t\tMax_partitions in a column of an HMM: %" PRIi64 "\n"
+            "\t\tTarget posterior mass of the partitions in a column (0 = fixed threshold): %f\n"
             "\t\tMin read coverage to support phasing between heterozygous sites: %" PRIi64 "\n",
             ALPHABET_SIZE, params->maxCoverageDepth,
             (int)params->maxNotSumTransitions, params->maxPartitionsInAColumn,
+            params->targetPosteriorMassForPartitions,
             params->minReadCoverageToSupportPhasingBetweenHeterozygousSites);
 
     fprintf(fH, "\t\tHeterozygous substitution rates:\n");
@@ -109,6 +111,20 @@ void stRPHmmParameters_printParameters(stRPHmmParameters *params, FILE *fH) {
     fprintf(fH, "\t\tminSecondMostFrequentBaseFilter: %f\n", params->minSecondMostFrequentBaseFilter);
     fprintf(fH, "\t\tminSecondMostFrequentBaseLogProbFilter: %f\n", params->minSecondMostFrequentBaseLogProbFilter);
     fprintf(fH, "\t\tRounds of iterative refinement: %" PRIi64 "\n", params->roundsOfIterativeRefinement);
+    fprintf(fH, "\t\tCheckpoint forward-backward? : %i\n", (int)params->checkpointForwardBackward);
+    fprintf(fH, "\t\tColumns between checkpoints (0 = square root of column number): %" PRIi64 "\n",
+            params->columnsBetweenCheckpoints);
+    fprintf(fH, "\t\tForward-backward segments (0 or 1 = no segmentation): %" PRIi64 "\n",
+            params->forwardBackwardSegmentNumber);
+    fprintf(fH, "\t\tMax merge cells at forward-backward segment boundary: %" PRIi64 "\n",
+            params->maxMergeCellsAtSegmentBoundary);
+    fprintf(fH, "\t\tConcurrent forward-backward? : %i\n", (int)params->concurrentForwardBackward);
+    fprintf(fH, "\t\tPre-split reads at weakly linked sites? : %i\n", (int)params->preSplitReadsAtWeaklyLinkedSites);
+    fprintf(fH, "\t\tOrder merges by estimated cost? : %i\n", (int)params->orderMergesByEstimatedCost);
+    fprintf(fH, "\t\tGenotype filtered positions from pileup? : %i\n",
+            (int)params->genotypeFilteredPositionsFromPileup);
+    fprintf(fH, "\t\tPrefer high MAPQ reads when downsampling? : %i\n", (int)params->preferHighMapqWhenDownsampling);
+    fprintf(fH, "\t\tEnsemble sub-samples (0 or 1 = no ensemble): %" PRIi64 "\n", params->ensembleSubsampleNumber);
     fprintf(fH, "\t\tWriting gvcf? : %i\n", (int)params->writeGVCF);
     fprintf(fH, "\t\tVerbose Attributes:\n");
     if (params->verboseTruePositives) fprintf(fH, "\t\t\tTRUE_POSITIVES\n");
@@ -322,6 +338,9 @@ void stRPHmm_destruct(stRPHmm *hmm, bool destructColumns) {
      */
     free(hmm->referenceName);
     stList_destruct(hmm->profileSeqs);
+    if(hmm->path != NULL) {
+        stList_destruct(hmm->path);
+    }
 
     if(destructColumns) {
         // Cleanup the columns of the hmm
@@ -401,6 +420,24 @@ stList *stRPHmm_forwardTraceBack(stRPHmm *hmm) {
     return path;
 }
 
+stList *stRPHmm_forwardBackwardTraceBack(stRPHmm *hmm) {
+    /*
+     * Runs the forward-backward algorithm and returns a high probability path through the hmm,
+     * as given by stRPHmm_forwardTraceBack.
+     *
+     * If the hmm retains the path computed before it was split from a larger hmm (see
+     * stRPHMM_splitWherePhasingIsUncertain) then that path is returned instead, without running
+     * the forward-backward algorithm, and the hmm no longer retains it.
+     */
+    if(hmm->path != NULL) {
+        stList *path = hmm->path;
+        hmm->path = NULL;
+        return path;
+    }
+    stRPHmm_forwardBackward(hmm);
+    return stRPHmm_forwardTraceBack(hmm);
+}
+
 stSet *stRPHmm_partitionSequencesByStatePath(stRPHmm *hmm, stList *path, bool partition1) {
     /*
      * For an hmm and path through the hmm (e.g. computed with stRPHmm_forwardTraceBack) returns the
@@ -486,6 +523,7 @@ stRPHmm *stRPHmm_fuse(stRPHmm *leftHmm, stRPHmm *rightHmm) {
 
     // Create a new empty hmm
     stRPHmm *hmm = st_malloc(sizeof(stRPHmm));
+    hmm->path = NULL;
     // Set the reference interval
     hmm->referenceName = stString_copy(leftHmm->referenceName);
     hmm->refStart = leftHmm->refStart;
@@ -696,15 +734,7 @@ void stRPHmm_alignColumns(stRPHmm *hmm1, stRPHmm *hmm2) {
     assert(hmm1->columnNumber == hmm2->columnNumber);
 }
 
-static uint64_t intHashFn(const void *a) {
-    return *(uint64_t *)a;
-}
-
-static int intEqualsFn(const void *key1, const void *key2) {
-    return *(uint64_t *)key1 == *(uint64_t *)key2;
-}
-
-stRPCell **makeCell(uint64_t partition, stRPCell **pCell, stHash *seen) {
+stRPCell **makeCell(stRPPartition partition, stRPCell **pCell, stHash *seen) {
     /*
      * Make a cell for a column.
      */
@@ -721,10 +751,10 @@ stRPCell **makeCell(uint64_t partition, stRPCell **pCell, stHash *seen) {
     return &cell->nCell;
 }
 
-stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2) {
+static stRPHmm *createEmptyCrossProductHmm(stRPHmm *hmm1, stRPHmm *hmm2) {
     /*
-     *  For two aligned hmms (see stRPHmm_alignColumns) returns a new hmm that represents the
-     *  cross product of all the states of the two input hmms.
+     * For two aligned hmms (see stRPHmm_alignColumns) returns a new hmm with no columns
+     * whose attributes are those of the cross product of the two input hmms.
      */
 
     // Do sanity checks that the two hmms have been aligned
@@ -772,6 +802,159 @@ stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2)
     }
     hmm->referencePriorProbs = hmm1->referencePriorProbs;
 
+    return hmm;
+}
+
+static stRPColumn *createCrossProductOfTwoAlignedColumns(stRPHmm *hmm, stRPColumn *column1, stRPColumn *column2) {
+    /*
+     * Returns a new, unlinked column whose cells are the cross product of the cells of the two
+     * aligned columns. Updates the max depth of hmm.
+     */
+
+    // Check columns aligned
+    assert(column1->refStart == column2->refStart);
+    assert(column1->length == column2->length);
+
+    // Depth
+    int64_t newColumnDepth = column1->depth+column2->depth;
+    if(newColumnDepth > hmm->maxDepth) {
+        hmm->maxDepth = newColumnDepth;
+    }
+
+    // Seq headers
+    stProfileSeq **seqHeaders = st_malloc(sizeof(stProfileSeq *) * newColumnDepth);
+    memcpy(seqHeaders, column1->seqHeaders, sizeof(stProfileSeq *) * column1->depth);
+    memcpy(&seqHeaders[column1->depth], column2->seqHeaders, sizeof(stProfileSeq *) * column2->depth);
+
+    // Profiles
+    uint8_t **seqs = st_malloc(sizeof(uint8_t *) * newColumnDepth);
+    memcpy(seqs, column1->seqs, sizeof(uint8_t *) * column1->depth);
+    memcpy(&seqs[column1->depth], column2->seqs, sizeof(uint8_t *) * column2->depth);
+
+    stRPColumn *column = stRPColumn_construct(column1->refStart, column1->length,
+            newColumnDepth, seqHeaders, seqs, hmm->referencePriorProbs);
+
+    // Create cross product of columns
+    stRPCell **pCell = &column->head;
+    stRPCell *cell1 = column1->head;
+
+    // includeInvertedPartitions forces that the partition and its inverse are included
+    // in the resulting combine hmm.
+    if(hmm->parameters->includeInvertedPartitions) {
+        stHash *seen = stHash_construct3(partitionHashFn, partitionEqualsFn, NULL, NULL);
+        do {
+            stRPCell *cell2 = column2->head;
+            do {
+                stRPPartition partition = mergePartitionsOrMasks(cell1->partition, cell2->partition,
+                        column1->depth, column2->depth);
+
+                // We have not seen the combined partition before
+                if(stHash_search(seen, &partition) == NULL) {
+                    // Add the partition to the column
+                    pCell = makeCell(partition, pCell, seen);
+
+                    // Check if the column has non-zero depth and only add the inverse partition if it does
+                    // because if zero length the inverse partition is the same as for the forward, and therefore
+                    // a duplicate
+                    if(newColumnDepth > 0) {
+                        stRPPartition invertedPartition = invertPartition(partition, newColumnDepth);
+                        assert(stHash_search(seen, &invertedPartition) == NULL);
+
+                        pCell = makeCell(invertedPartition, pCell, seen);
+                    }
+                }
+            } while((cell2 = cell2->nCell) != NULL);
+        } while((cell1 = cell1->nCell) != NULL);
+
+        // Cleanup
+        stHash_destruct(seen);
+    }
+    // If not forcing symmetry
+    else {
+        do {
+            stRPCell *cell2 = column2->head;
+            do {
+                stRPCell *cell = stRPCell_construct(mergePartitionsOrMasks(cell1->partition, cell2->partition,
+                        column1->depth, column2->depth));
+                // Link cells
+                *pCell = cell;
+                pCell = &cell->nCell;
+            } while((cell2 = cell2->nCell) != NULL);
+        } while((cell1 = cell1->nCell) != NULL);
+    }
+
+    return column;
+}
+
+static stRPMergeColumn *createCrossProductOfTwoAlignedMergeColumns(stRPHmm *hmm,
+        stRPMergeColumn *mColumn1, stRPMergeColumn *mColumn2) {
+    /*
+     * Returns a new, unlinked merge column whose merge cells are the cross product of the merge
+     * cells of the two aligned merge columns.
+     */
+
+    // Create new merged column
+    stRPPartition fromMask = mergePartitionsOrMasks(mColumn1->maskFrom, mColumn2->maskFrom,
+            mColumn1->pColumn->depth, mColumn2->pColumn->depth);
+    stRPPartition toMask = mergePartitionsOrMasks(mColumn1->maskTo, mColumn2->maskTo,
+                    mColumn1->nColumn->depth, mColumn2->nColumn->depth);
+    assert(popcountPartition(fromMask) == popcountPartition(toMask));
+    stRPMergeColumn *mColumn = stRPMergeColumn_construct(fromMask, toMask);
+
+    // Create cross product of merged columns
+    stHashIterator *cellIt1 = stHash_getIterator(mColumn1->mergeCellsFrom);
+    stRPMergeCell *mCell1;
+    while((mCell1 = stHash_getNext(cellIt1)) != NULL) {
+        stHashIterator *cellIt2 = stHash_getIterator(mColumn2->mergeCellsFrom);
+        stRPMergeCell *mCell2;
+        while((mCell2 = stHash_getNext(cellIt2)) != NULL) {
+            stRPPartition fromPartition = mergePartitionsOrMasks(mCell1->fromPartition,
+                    mCell2->fromPartition,
+                    mColumn1->pColumn->depth, mColumn2->pColumn->depth);
+
+            stRPPartition toPartition = mergePartitionsOrMasks(mCell1->toPartition,
+                    mCell2->toPartition,
+                    mColumn1->nColumn->depth, mColumn2->nColumn->depth);
+
+            assert(popcountPartition(fromPartition) == popcountPartition(toPartition));
+
+            // includeInvertedPartitions forces that the partition and its inverse are included
+            // in the resulting combined hmm.
+            if(hmm->parameters->includeInvertedPartitions) {
+                if(stHash_search(mColumn->mergeCellsFrom, &fromPartition) == NULL) {
+                    stRPMergeCell_construct(fromPartition, toPartition, mColumn);
+
+                    // If the mask includes no sequences then the the inverted will be identical, so we check
+                    // to avoid adding the same partition twice
+                    if(popcountPartition(fromMask) > 0) {
+                        stRPPartition invertedFromPartition = mColumn->maskFrom &
+                                invertPartition(fromPartition, mColumn1->pColumn->depth + mColumn2->pColumn->depth);
+                        stRPPartition invertedToPartition = mColumn->maskTo &
+                                invertPartition(toPartition, mColumn1->nColumn->depth + mColumn2->nColumn->depth);
+
+                        stRPMergeCell_construct(invertedFromPartition, invertedToPartition, mColumn);
+                    }
+                }
+            } else {
+                stRPMergeCell_construct(fromPartition, toPartition, mColumn);
+            }
+        }
+        stHash_destructIterator(cellIt2);
+    }
+    stHash_destructIterator(cellIt1);
+
+    return mColumn;
+}
+
+stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2) {
+    /*
+     *  For two aligned hmms (see stRPHmm_alignColumns) returns a new hmm that represents the
+     *  cross product of all the states of the two input hmms.
+     */
+
+    // Create a new empty hmm
+    stRPHmm *hmm = createEmptyCrossProductHmm(hmm1, hmm2);
+
     // For each pair of corresponding columns
     stRPColumn *column1 = hmm1->firstColumn;
     stRPColumn *column2 = hmm2->firstColumn;
@@ -780,30 +963,8 @@ stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2)
     stRPMergeColumn *mColumn = NULL;
 
     while(1) {
-        // Check columns aligned
-        assert(column1->refStart == column2->refStart);
-        assert(column1->length == column2->length);
-
         // Create the new column
-
-        // Depth
-        int64_t newColumnDepth = column1->depth+column2->depth;
-        if(newColumnDepth > hmm->maxDepth) {
-            hmm->maxDepth = newColumnDepth;
-        }
-
-        // Seq headers
-        stProfileSeq **seqHeaders = st_malloc(sizeof(stProfileSeq *) * newColumnDepth);
-        memcpy(seqHeaders, column1->seqHeaders, sizeof(stProfileSeq *) * column1->depth);
-        memcpy(&seqHeaders[column1->depth], column2->seqHeaders, sizeof(stProfileSeq *) * column2->depth);
-
-        // Profiles
-        uint8_t **seqs = st_malloc(sizeof(uint8_t *) * newColumnDepth);
-        memcpy(seqs, column1->seqs, sizeof(uint8_t *) * column1->depth);
-        memcpy(&seqs[column1->depth], column2->seqs, sizeof(uint8_t *) * column2->depth);
-
-        stRPColumn *column = stRPColumn_construct(column1->refStart, column1->length,
-                newColumnDepth, seqHeaders, seqs, hmm->referencePriorProbs);
+        stRPColumn *column = createCrossProductOfTwoAlignedColumns(hmm, column1, column2);
 
         // If the there is a previous column
         if(mColumn != NULL) {
@@ -815,55 +976,6 @@ stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2)
             assert(column->pColumn == NULL);
         }
 
-        // Create cross product of columns
-        stRPCell **pCell = &column->head;
-        stRPCell *cell1 = column1->head;
-
-        // includeInvertedPartitions forces that the partition and its inverse are included
-        // in the resulting combine hmm.
-        if(hmm->parameters->includeInvertedPartitions) {
-            stHash *seen = stHash_construct3(intHashFn, intEqualsFn, NULL, NULL);
-            do {
-                stRPCell *cell2 = column2->head;
-                do {
-                    uint64_t partition = mergePartitionsOrMasks(cell1->partition, cell2->partition,
-                            column1->depth, column2->depth);
-
-                    // We have not seen the combined partition before
-                    if(stHash_search(seen, &partition) == NULL) {
-                        // Add the partition to the column
-                        pCell = makeCell(partition, pCell, seen);
-
-                        // Check if the column has non-zero depth and only add the inverse partition if it does
-                        // because if zero length the inverse partition is the same as for the forward, and therefore
-                        // a duplicate
-                        if(newColumnDepth > 0) {
-                            uint64_t invertedPartition = invertPartition(partition, newColumnDepth);
-                            assert(stHash_search(seen, &invertedPartition) == NULL);
-
-                            pCell = makeCell(invertedPartition, pCell, seen);
-                        }
-                    }
-                } while((cell2 = cell2->nCell) != NULL);
-            } while((cell1 = cell1->nCell) != NULL);
-
-            // Cleanup
-            stHash_destruct(seen);
-        }
-        // If not forcing symmetry
-        else {
-            do {
-                stRPCell *cell2 = column2->head;
-                do {
-                    stRPCell *cell = stRPCell_construct(mergePartitionsOrMasks(cell1->partition, cell2->partition,
-                            column1->depth, column2->depth));
-                    // Link cells
-                    *pCell = cell;
-                    pCell = &cell->nCell;
-                } while((cell2 = cell2->nCell) != NULL);
-            } while((cell1 = cell1->nCell) != NULL);
-        }
-
         // Get the next merged column
         stRPMergeColumn *mColumn1 = column1->nColumn;
         stRPMergeColumn *mColumn2 = column2->nColumn;
@@ -881,59 +993,12 @@ stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2)
         }
 
         // Create new merged column
-        uint64_t fromMask = mergePartitionsOrMasks(mColumn1->maskFrom, mColumn2->maskFrom,
-                mColumn1->pColumn->depth, mColumn2->pColumn->depth);
-        uint64_t toMask = mergePartitionsOrMasks(mColumn1->maskTo, mColumn2->maskTo,
-                        mColumn1->nColumn->depth, mColumn2->nColumn->depth);
-        assert(popcount64(fromMask) == popcount64(toMask));
-        mColumn = stRPMergeColumn_construct(fromMask, toMask);
+        mColumn = createCrossProductOfTwoAlignedMergeColumns(hmm, mColumn1, mColumn2);
 
         // Connect links
         mColumn->pColumn = column;
         column->nColumn = mColumn;
 
-        // Create cross product of merged columns
-        stHashIterator *cellIt1 = stHash_getIterator(mColumn1->mergeCellsFrom);
-        stRPMergeCell *mCell1;
-        while((mCell1 = stHash_getNext(cellIt1)) != NULL) {
-            stHashIterator *cellIt2 = stHash_getIterator(mColumn2->mergeCellsFrom);
-            stRPMergeCell *mCell2;
-            while((mCell2 = stHash_getNext(cellIt2)) != NULL) {
-                uint64_t fromPartition = mergePartitionsOrMasks(mCell1->fromPartition,
-                        mCell2->fromPartition,
-                        mColumn1->pColumn->depth, mColumn2->pColumn->depth);
-
-                uint64_t toPartition = mergePartitionsOrMasks(mCell1->toPartition,
-                        mCell2->toPartition,
-                        mColumn1->nColumn->depth, mColumn2->nColumn->depth);
-
-                assert(popcount64(fromPartition) == popcount64(toPartition));
-
-                // includeInvertedPartitions forces that the partition and its inverse are included
-                // in the resulting combined hmm.
-                if(hmm->parameters->includeInvertedPartitions) {
-                    if(stHash_search(mColumn->mergeCellsFrom, &fromPartition) == NULL) {
-                        stRPMergeCell_construct(fromPartition, toPartition, mColumn);
-
-                        // If the mask includes no sequences then the the inverted will be identical, so we check
-                        // to avoid adding the same partition twice
-                        if(popcount64(fromMask) > 0) {
-                            uint64_t invertedFromPartition = mColumn->maskFrom &
-                                    invertPartition(fromPartition, mColumn1->pColumn->depth + mColumn2->pColumn->depth);
-                            uint64_t invertedToPartition = mColumn->maskTo &
-                                    invertPartition(toPartition, mColumn1->nColumn->depth + mColumn2->nColumn->depth);
-
-                            stRPMergeCell_construct(invertedFromPartition, invertedToPartition, mColumn);
-                        }
-                    }
-                } else {
-                    stRPMergeCell_construct(fromPartition, toPartition, mColumn);
-                }
-            }
-            stHash_destructIterator(cellIt2);
-        }
-        stHash_destructIterator(cellIt1);
-
         // Get next column
         column1 = mColumn1->nColumn;
         column2 = mColumn2->nColumn;
@@ -983,7 +1048,31 @@ static void stRPHmm_initialiseProbs(stRPHmm *hmm) {
     }
 }
 
-static inline void forwardCellCalc1(stRPHmm *hmm, stRPColumn *column, stRPCell *cell, uint64_t *bitCountVectors) {
+static stRPPartition *getColumnBitCountVectors(stRPColumn *column) {
+    /*
+     * Returns the bit count vectors for the active positions of the column, or NULL if the column has no
+     * active positions, in which case they are not needed to calculate emission probabilities.
+     */
+    if(column->totalActivePositions == 0) {
+        return NULL;
+    }
+    return calculateCountBitVectors(column->seqs, column->depth,
+            column->activePositions, column->totalActivePositions, column->activePositionsOffset);
+}
+
+static inline double cellEmissionLogProb(stRPHmm *hmm, stRPColumn *column, stRPCell *cell, stRPPartition *bitCountVectors) {
+    /*
+     * Returns the emission log probability of the cell. If the column has no active positions, as is common once
+     * likely homozygous positions are filtered, this is log(1) for every cell and no calculation is needed.
+     */
+    if(column->totalActivePositions == 0) {
+        return ST_MATH_LOG_ONE;
+    }
+    return emissionLogProbability(column, cell, bitCountVectors,
+            hmm->referencePriorProbs, (stRPHmmParameters *)hmm->parameters);
+}
+
+static inline void forwardCellCalc1(stRPHmm *hmm, stRPColumn *column, stRPCell *cell, stRPPartition *bitCountVectors) {
     // If the previous merge column exists then propagate forward probability from merge state
     if(column->pColumn != NULL) {
         stRPMergeCell *mCell = stRPMergeColumn_getPreviousMergeCell(cell, column->pColumn);
@@ -995,8 +1084,7 @@ static inline void forwardCellCalc1(stRPHmm *hmm, stRPColumn *column, stRPCell *
     }
 
     // Calculate the emission prob
-    double emissionProb = emissionLogProbability(column, cell, bitCountVectors,
-            hmm->referencePriorProbs, (stRPHmmParameters *)hmm->parameters);
+    double emissionProb = cellEmissionLogProb(hmm, column, cell, bitCountVectors);
 
     // Add emission prob to forward log prob
     cell->forwardLogProb += emissionProb;
@@ -1019,23 +1107,21 @@ static inline void forwardCellCalc2(stRPHmm *hmm, stRPColumn *column, stRPCell *
     }
 }
 
-static void stRPHmm_forward(stRPHmm *hmm) {
+static void stRPHmm_forwardColumn(stRPHmm *hmm, stRPColumn *column) {
     /*
-     * Forward algorithm for hmm.
+     * Forward algorithm for a single column of the hmm, propagating the forward probabilities
+     * of the cells into the next merge column.
      */
-    stRPColumn *column = hmm->firstColumn;
 
-    // Iterate through columns from first to last
-    while(1) {
-        // Get the bit count vectors for the column
-        uint64_t *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth,
-                column->activePositions, column->totalActivePositions);
+    // Get the bit count vectors for the column
+    stRPPartition *bitCountVectors = getColumnBitCountVectors(column);
 
-        // Iterate through states in column
-        stRPCell *cell = column->head;
+    // Iterate through states in column
+    stRPCell *cell = column->head;
 
-        // If OpenMP is available then parallelize the calculation of the emission calcs
+    // If OpenMP is available then parallelize the calculation of the emission calcs, if there are any
 #if defined(_OPENMP)
+    if(column->totalActivePositions > 0) {
         stRPCell *cells[CELL_BUFFER_SIZE];
         do {
             // Get as many cells as the buffer will fit / there are cells
@@ -1055,17 +1141,33 @@ static void stRPHmm_forward(stRPHmm *hmm) {
                 forwardCellCalc2(hmm, column, cells[i]);
             }
         } while(cell != NULL);
-#else
-        // Otherwise do it without the need for the cell buffer
-        do {
-            forwardCellCalc1(hmm, column, cell, bitCountVectors);
-            forwardCellCalc2(hmm, column, cell);
-        }
-        while((cell = cell->nCell) != NULL);
-#endif
 
         // Cleanup the bit count vectors
         free(bitCountVectors);
+        return;
+    }
+#endif
+
+    // Otherwise do it without the need for the cell buffer
+    do {
+        forwardCellCalc1(hmm, column, cell, bitCountVectors);
+        forwardCellCalc2(hmm, column, cell);
+    }
+    while((cell = cell->nCell) != NULL);
+
+    // Cleanup the bit count vectors
+    free(bitCountVectors);
+}
+
+static void stRPHmm_forward(stRPHmm *hmm) {
+    /*
+     * Forward algorithm for hmm.
+     */
+    stRPColumn *column = hmm->firstColumn;
+
+    // Iterate through columns from first to last
+    while(1) {
+        stRPHmm_forwardColumn(hmm, column);
 
         if(column->nColumn == NULL) {
             break;
@@ -1074,9 +1176,8 @@ static void stRPHmm_forward(stRPHmm *hmm) {
     }
 }
 
-static inline void backwardCellCalc(stRPHmm *hmm, stRPColumn *column, stRPCell *cell) {
-    // Retrieve the emission probability that was stored by the forward pass
-    double probabilityToPropagateLogProb = cell->backwardLogProb;
+static inline void backwardCellCalc2(stRPHmm *hmm, stRPColumn *column, stRPCell *cell, double emissionLogProb) {
+    double probabilityToPropagateLogProb = emissionLogProb;
 
     // If the next merge column exists then propagate backward probability from merge state
     if(column->nColumn != NULL) {
@@ -1099,12 +1200,30 @@ static inline void backwardCellCalc(stRPHmm *hmm, stRPColumn *column, stRPCell *
         hmm->backwardLogProb = logAddP(hmm->backwardLogProb, probabilityToPropagateLogProb,
                 hmm->parameters->maxNotSumTransitions);
     }
+}
+
+static inline void backwardCellCalc(stRPHmm *hmm, stRPColumn *column, stRPCell *cell) {
+    // Retrieve the emission probability that was stored by the forward pass
+    backwardCellCalc2(hmm, column, cell, cell->backwardLogProb);
 
     // Add to column total probability
     column->totalLogProb = logAddP(column->totalLogProb,
                  cell->forwardLogProb + cell->backwardLogProb, hmm->parameters->maxNotSumTransitions);
 }
 
+static void stRPHmm_backwardColumn(stRPHmm *hmm, stRPColumn *column) {
+    /*
+     * Backward algorithm for a single column of the hmm, propagating the backward probabilities
+     * of the cells into the previous merge column. Requires that the forward algorithm has been
+     * run on the column.
+     */
+    stRPCell *cell = column->head;
+    do {
+        backwardCellCalc(hmm, column, cell);
+    }
+    while((cell = cell->nCell) != NULL);
+}
+
 static void stRPHmm_backward(stRPHmm *hmm) {
     /*
      * Backward algorithm for hmm.
@@ -1113,12 +1232,7 @@ static void stRPHmm_backward(stRPHmm *hmm) {
 
     // Iterate through columns from last to first
     while(1) {
-        // Iterate through states in column
-        stRPCell *cell = column->head;
-        do {
-            backwardCellCalc(hmm, column, cell);
-        }
-        while((cell = cell->nCell) != NULL);
+        stRPHmm_backwardColumn(hmm, column);
 
         if(column->pColumn == NULL) {
             break;
@@ -1127,185 +1241,868 @@ static void stRPHmm_backward(stRPHmm *hmm) {
     }
 }
 
-void stRPHmm_forwardBackward(stRPHmm *hmm) {
+/*
+ * Concurrent forward-backward.
+ *
+ * The backward pass only depends on the forward pass for the emission probabilities it stores in the cells. If the
+ * emission probabilities are instead calculated first, the forward and backward passes are independent and can be run
+ * at the same time, the forward pass writing only forward probabilities and the backward pass only backward
+ * probabilities.
+ */
+
+static double **calculateEmissions(stRPHmm *hmm, stRPColumn **columns) {
     /*
-     * Runs the forward and backward algorithms and sets the total column probabilities.
-     *
-     * This function must be run upon an HMM to calculate cell posterior probabilities.
+     * Returns an array giving, for each column, an array of the emission log probabilities of its cells, in order.
      */
-    // Initialise state values
-    stRPHmm_initialiseProbs(hmm);
-    // Run the forward and backward passes
-    stRPHmm_forward(hmm);
-    stRPHmm_backward(hmm);
+    double **emissions = st_malloc(sizeof(double *) * hmm->columnNumber);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int64_t i=0; i<hmm->columnNumber; i++) {
+        stRPColumn *column = columns[i];
+        int64_t cellNumber = 0;
+        stRPCell *cell = column->head;
+        do {
+            cellNumber++;
+        } while((cell = cell->nCell) != NULL);
+
+        stRPPartition *bitCountVectors = getColumnBitCountVectors(column);
+        emissions[i] = st_malloc(sizeof(double) * cellNumber);
+        cell = column->head;
+        for(int64_t j=0; j<cellNumber; j++) {
+            emissions[i][j] = cellEmissionLogProb(hmm, column, cell, bitCountVectors);
+            cell = cell->nCell;
+        }
+        free(bitCountVectors);
+    }
+
+    return emissions;
 }
 
-static int cellCmpFn(const void *a, const void *b, const void *extraArg) {
+static void stRPHmm_forwardGivenEmissions(stRPHmm *hmm, stRPColumn **columns, double **emissions) {
     /*
-     * Sort cells by posterior probability in descending order.
+     * Forward algorithm for hmm given the emission probabilities of the cells.
      */
-    stRPCell *cell1 = (stRPCell *)a, *cell2 = (stRPCell *)b;
-    stRPColumn *column = (stRPColumn *)extraArg;
-    double p1 = stRPCell_posteriorProb(cell1, column), p2 = stRPCell_posteriorProb(cell2, column);
-    return p1 > p2 ? -1 : p1 < p2 ? 1 : 0;
+    for(int64_t i=0; i<hmm->columnNumber; i++) {
+        stRPColumn *column = columns[i];
+        stRPCell *cell = column->head;
+        int64_t j = 0;
+        do {
+            cell->forwardLogProb = column->pColumn != NULL ?
+                    stRPMergeColumn_getPreviousMergeCell(cell, column->pColumn)->forwardLogProb : ST_MATH_LOG_ONE;
+            cell->forwardLogProb += emissions[i][j++];
+            forwardCellCalc2(hmm, column, cell);
+        } while((cell = cell->nCell) != NULL);
+    }
 }
 
-static int mergeCellCmpFn(const void *a, const void *b, const void *extraArg) {
+static void stRPHmm_backwardGivenEmissions(stRPHmm *hmm, stRPColumn **columns, double **emissions) {
     /*
-     * Sort merge cells by posterior probability in descending order.
+     * Backward algorithm for hmm given the emission probabilities of the cells. Does not set the total column
+     * probabilities.
      */
-    stRPMergeCell *cell1 = (stRPMergeCell *)a, *cell2 = (stRPMergeCell *)b;
-    stRPMergeColumn *column = (stRPMergeColumn *)extraArg;
-    double p1 = stRPMergeCell_posteriorProb(cell1, column), p2 = stRPMergeCell_posteriorProb(cell2, column);
-    return p1 > p2 ? -1 : p1 < p2 ? 1 : 0;
+    for(int64_t i=hmm->columnNumber-1; i>=0; i--) {
+        stRPColumn *column = columns[i];
+        stRPCell *cell = column->head;
+        int64_t j = 0;
+        do {
+            backwardCellCalc2(hmm, column, cell, emissions[i][j++]);
+        } while((cell = cell->nCell) != NULL);
+    }
 }
 
-void filterMergeCells(stRPMergeColumn *mColumn, stSet *chosenMergeCellsSet) {
+void stRPHmm_forwardBackwardConcurrently(stRPHmm *hmm) {
     /*
-     * Removes merge cells from the column that are not in chosenMergeCellsSet
+     * Runs the forward and backward algorithms and sets the total column probabilities, as stRPHmm_forwardBackward,
+     * but first calculating all the emission probabilities, in parallel, and then running the forward and backward
+     * passes at the same time, if OpenMP is available.
      */
-    assert(stSet_size(chosenMergeCellsSet) > 0);
-    stList *mergeCells = stHash_getValues(mColumn->mergeCellsFrom);
-    for(int64_t i=0; i<stList_length(mergeCells); i++) {
-        stRPMergeCell *mCell = stList_get(mergeCells, i);
-        assert(mCell != NULL);
-        if(stSet_search(chosenMergeCellsSet, mCell) == NULL) {
-            // Remove the state from the merge column
-            assert(stHash_search(mColumn->mergeCellsFrom, &(mCell->fromPartition)) == mCell);
-            assert(stHash_search(mColumn->mergeCellsTo, &(mCell->toPartition)) == mCell);
-            stHash_remove(mColumn->mergeCellsFrom, &(mCell->fromPartition));
-            stHash_remove(mColumn->mergeCellsTo, &(mCell->toPartition));
+    stRPHmm_initialiseProbs(hmm);
 
-            // Cleanup
-            stRPMergeCell_destruct(mCell);
-        }
+    // Get the columns in order
+    stRPColumn **columns = st_malloc(sizeof(stRPColumn *) * hmm->columnNumber);
+    stRPColumn *column = hmm->firstColumn;
+    for(int64_t i=0; i<hmm->columnNumber; i++) {
+        columns[i] = column;
+        column = column->nColumn == NULL ? NULL : column->nColumn->nColumn;
     }
-    stList_destruct(mergeCells);
-    assert(stSet_size(chosenMergeCellsSet) == stHash_size(mColumn->mergeCellsFrom));
-    assert(stSet_size(chosenMergeCellsSet) == stHash_size(mColumn->mergeCellsTo));
+    assert(column == NULL);
+
+    double **emissions = calculateEmissions(hmm, columns);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+{
+#pragma omp sections nowait
+{
+#pragma omp section
+    stRPHmm_forwardGivenEmissions(hmm, columns, emissions);
+
+#pragma omp section
+    stRPHmm_backwardGivenEmissions(hmm, columns, emissions);
+
 }
+}
+#else
+    stRPHmm_forwardGivenEmissions(hmm, columns, emissions);
+    stRPHmm_backwardGivenEmissions(hmm, columns, emissions);
+#endif
 
-stSet *getLinkedMergeCells(stRPMergeColumn *mColumn,
-        stRPMergeCell *(*getNCell)(stRPCell *, stRPMergeColumn *),
-        stList *cells) {
-    /*
-     * Returns the set of merge cells in the column that are linked to a cell
-     * in cells.
-     */
-    stSet *chosenMergeCellsSet = stSet_construct();
-    for(int64_t i=0; i<stList_length(cells); i++) {
-        stRPMergeCell *mCell = getNCell(stList_get(cells, i), mColumn);
-        assert(mCell != NULL);
-        stSet_insert(chosenMergeCellsSet, mCell);
+    // Set the total column probabilities
+    for(int64_t i=0; i<hmm->columnNumber; i++) {
+        column = columns[i];
+        stRPCell *cell = column->head;
+        do {
+            column->totalLogProb = logAddP(column->totalLogProb,
+                    cell->forwardLogProb + cell->backwardLogProb, hmm->parameters->maxNotSumTransitions);
+        } while((cell = cell->nCell) != NULL);
+        free(emissions[i]);
     }
-    assert(stSet_size(chosenMergeCellsSet) > 0);
-    return chosenMergeCellsSet;
+
+    // Cleanup
+    free(emissions);
+    free(columns);
 }
 
-void relinkCells(stRPColumn *column, stList *cells) {
+/*
+ * Segment-parallel forward-backward.
+ *
+ * Between two merge columns the forward probabilities of the later merge column are a linear function, in the
+ * (max, +) or (logAdd, +) semiring, of those of the earlier merge column, and similarly for the backward probabilities
+ * in reverse. The hmm is therefore cut at merge columns with few merge cells into segments, and for each segment,
+ * independently, a transfer matrix is computed giving the log probability of the segment for each merge cell by which
+ * it is entered and each merge cell by which it is left. The forward and backward probabilities of the merge columns
+ * between segments are then calculated from the transfer matrices, after which the probabilities within each segment
+ * are again filled in independently.
+ */
+
+typedef struct _hmmSegment hmmSegment;
+struct _hmmSegment {
+    stRPColumn *firstColumn;
+    stRPColumn *lastColumn;
+    // The merge cells of the merge columns preceding and following the segment. If there is no such merge column the
+    // array is NULL and the number of merge cells is one. The entry merge cells are those of the previous segment.
+    stRPMergeCell **entryMergeCells;
+    int64_t entryNumber;
+    stRPMergeCell **exitMergeCells;
+    int64_t exitNumber;
+    // For each cell, in order, of the first column the index of its preceding merge cell, and likewise for each cell
+    // of the last column the index of its following merge cell
+    int64_t *entryIndices;
+    int64_t *exitIndices;
+    // The merge cells of the merge columns within the segment
+    stList *mergeCells;
+    // Entry i*exitNumber + j is the log probability of the segment given it is entered by the ith entry merge cell
+    // and left by the jth exit merge cell
+    double *transferMatrix;
+    // The forward log probabilities of the entry merge cells and the backward log probabilities of the exit merge cells
+    double *entryLogProbs;
+    double *exitLogProbs;
+};
+
+static stRPMergeCell **getMergeCellArray(stRPMergeColumn *mColumn, int64_t *mergeCellNumber) {
     /*
-     * Re-links the cells in the list 'cells' to make up the list of cells in the column.
+     * Returns an array of the merge cells in the merge column, or NULL if the merge column is NULL.
      */
-    stRPCell **pCell = &column->head; // Pointer to previous cell, used to
-    // remove cells from the linked list
-    for(int64_t i=0; i<stList_length(cells); i++) {
-        stRPCell *cell = stList_get(cells, i);
-        *pCell = cell;
-        pCell = &cell->nCell;
+    if(mColumn == NULL) {
+        *mergeCellNumber = 1;
+        return NULL;
     }
-    *pCell = NULL;
-    assert(column->head != NULL);
+    stList *mergeCells = stHash_getValues(mColumn->mergeCellsFrom);
+    *mergeCellNumber = stList_length(mergeCells);
+    stRPMergeCell **mergeCellArray = st_malloc(sizeof(stRPMergeCell *) * (*mergeCellNumber));
+    for(int64_t i=0; i<*mergeCellNumber; i++) {
+        mergeCellArray[i] = stList_get(mergeCells, i);
+    }
+    stList_destruct(mergeCells);
+    return mergeCellArray;
 }
 
-stList *getLinkedCells(stRPColumn *column,
-        stRPMergeCell *(*getPCell)(stRPCell *, stRPMergeColumn *),
-        stRPMergeColumn *mColumn) {
+static int64_t *getMergeCellIndices(stRPColumn *column, stRPMergeCell **mergeCells, int64_t mergeCellNumber,
+        bool following) {
     /*
-     * Returns the set of cells in column that are linked to a cell in mColumn.
+     * Returns an array giving, for each cell in the column, the index in mergeCells of the following merge cell of
+     * the cell (if following is true) or otherwise the preceding merge cell.
      */
-
-    // Put cells into an array and sort by descending posterior prob
-    // only keeping cells that still have a preceding merge cell
-
-    stList *cells = stList_construct();
+    int64_t cellNumber = 0;
     stRPCell *cell = column->head;
     do {
-        if(mColumn == NULL || getPCell(cell, mColumn) != NULL) {
-            stList_append(cells, cell);
+        cellNumber++;
+    } while((cell = cell->nCell) != NULL);
+
+    int64_t *indices = st_calloc(cellNumber, sizeof(int64_t));
+    if(mergeCells != NULL) {
+        cell = column->head;
+        for(int64_t i=0; i<cellNumber; i++) {
+            stRPMergeCell *mCell = following ? stRPMergeColumn_getNextMergeCell(cell, column->nColumn) :
+                                   stRPMergeColumn_getPreviousMergeCell(cell, column->pColumn);
+            while(mergeCells[indices[i]] != mCell) {
+                indices[i]++;
+                assert(indices[i] < mergeCellNumber);
+            }
             cell = cell->nCell;
         }
-        else {
-            stRPCell *nCell = cell->nCell;
-            stRPCell_destruct(cell);
-            cell = nCell;
-        }
-    } while(cell != NULL);
-    stList_sort2(cells, cellCmpFn, column);
-    assert(stList_length(cells) > 0);
-
-    return cells;
+    }
+    return indices;
 }
 
-void stRPHmm_pruneForwards(stRPHmm *hmm) {
+static hmmSegment *hmmSegment_construct(stRPColumn *firstColumn, stRPColumn *lastColumn, hmmSegment *pSegment) {
     /*
-     * Remove cells from hmm whos posterior probability is below the given threshold
+     * Creates a segment of the hmm from firstColumn to lastColumn, inclusive, following the segment pSegment,
+     * or NULL if the segment is the first.
      */
+    hmmSegment *segment = st_calloc(1, sizeof(hmmSegment));
+    segment->firstColumn = firstColumn;
+    segment->lastColumn = lastColumn;
+
+    // Entry and exit merge cells
+    if(pSegment != NULL) {
+        assert(pSegment->lastColumn->nColumn == firstColumn->pColumn);
+        segment->entryMergeCells = pSegment->exitMergeCells;
+        segment->entryNumber = pSegment->exitNumber;
+    }
+    else {
+        assert(firstColumn->pColumn == NULL);
+        segment->entryNumber = 1;
+    }
+    segment->exitMergeCells = getMergeCellArray(lastColumn->nColumn, &segment->exitNumber);
+    segment->entryIndices = getMergeCellIndices(firstColumn, segment->entryMergeCells, segment->entryNumber, 0);
+    segment->exitIndices = getMergeCellIndices(lastColumn, segment->exitMergeCells, segment->exitNumber, 1);
 
-    // For each column
-    stRPColumn *column = hmm->firstColumn;
-    stRPMergeColumn *mColumn = NULL;
-
-    while(1) {
-        assert(column->head != NULL);
+    // Merge cells within the segment
+    segment->mergeCells = stList_construct();
+    for(stRPColumn *column = firstColumn; column != lastColumn; column = column->nColumn->nColumn) {
+        stList *mergeCells = stHash_getValues(column->nColumn->mergeCellsFrom);
+        stList_appendAll(segment->mergeCells, mergeCells);
+        stList_destruct(mergeCells);
+    }
 
-        // Get cells that have a valid previous cell
-        stList *cells = getLinkedCells(column, stRPMergeColumn_getPreviousMergeCell, mColumn);
+    segment->transferMatrix = st_malloc(sizeof(double) * segment->entryNumber * segment->exitNumber);
+    segment->entryLogProbs = st_malloc(sizeof(double) * segment->entryNumber);
+    segment->exitLogProbs = st_malloc(sizeof(double) * segment->exitNumber);
 
-        // Get rid of the excess cells
-        while(stList_length(cells) > hmm->parameters->minPartitionsInAColumn &&
-              (stList_length(cells) > hmm->parameters->maxPartitionsInAColumn ||
-               stRPCell_posteriorProb(stList_peek(cells), column) <
-                       hmm->parameters->minPosteriorProbabilityForPartition)) {
-            stRPCell_destruct(stList_pop(cells));
+    return segment;
+}
+
+static void hmmSegment_destruct(hmmSegment *segment) {
+    // The entry merge cells are owned by the previous segment
+    free(segment->exitMergeCells);
+    free(segment->entryIndices);
+    free(segment->exitIndices);
+    stList_destruct(segment->mergeCells);
+    free(segment->transferMatrix);
+    free(segment->entryLogProbs);
+    free(segment->exitLogProbs);
+    free(segment);
+}
+
+static stList *getHmmSegments(stRPHmm *hmm, int64_t segmentNumber, int64_t maxMergeCellsAtSegmentBoundary) {
+    /*
+     * Divides the hmm into at most segmentNumber segments containing similar numbers of cells, cutting only at
+     * merge columns with no more than maxMergeCellsAtSegmentBoundary merge cells.
+     */
+    int64_t totalCells = 0;
+    stRPColumn *column = hmm->firstColumn;
+    while(1) {
+        stRPCell *cell = column->head;
+        do {
+            totalCells++;
+        } while((cell = cell->nCell) != NULL);
+        if(column->nColumn == NULL) {
+            break;
         }
+        column = column->nColumn->nColumn;
+    }
+    int64_t cellsPerSegment = totalCells / segmentNumber > 0 ? totalCells / segmentNumber : 1;
 
-        // Relink the cells (from most probable to least probable)
-        relinkCells(column, cells);
+    stList *segments = stList_construct3(0, (void (*)(void *))hmmSegment_destruct);
+    stRPColumn *firstColumn = hmm->firstColumn;
+    hmmSegment *segment = NULL;
+    int64_t cells = 0;
+    column = hmm->firstColumn;
+    while(1) {
+        stRPCell *cell = column->head;
+        do {
+            cells++;
+        } while((cell = cell->nCell) != NULL);
+
+        // If the last column then finish the last segment
+        if(column->nColumn == NULL) {
+            stList_append(segments, hmmSegment_construct(firstColumn, column, segment));
+            break;
+        }
+
+        // Otherwise cut if the segment is large enough and the following merge column small enough
+        if(cells >= cellsPerSegment && stList_length(segments) < segmentNumber-1 &&
+           stHash_size(column->nColumn->mergeCellsFrom) <= maxMergeCellsAtSegmentBoundary) {
+            segment = hmmSegment_construct(firstColumn, column, segment);
+            stList_append(segments, segment);
+            firstColumn = column->nColumn->nColumn;
+            cells = 0;
+        }
+
+        column = column->nColumn->nColumn;
+    }
+
+    return segments;
+}
+
+static void hmmSegment_calculateEmissions(stRPHmm *hmm, hmmSegment *segment) {
+    /*
+     * Calculates the emission log probability of each cell in the segment, storing it in the backwardLogProb
+     * field of the cell, as the forward pass does.
+     */
+    stRPColumn *column = segment->firstColumn;
+    while(1) {
+        stRPPartition *bitCountVectors = getColumnBitCountVectors(column);
+        stRPCell *cell = column->head;
+        do {
+            cell->backwardLogProb = cellEmissionLogProb(hmm, column, cell, bitCountVectors);
+        } while((cell = cell->nCell) != NULL);
+        free(bitCountVectors);
+
+        if(column == segment->lastColumn) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+}
+
+static void hmmSegment_forward(stRPHmm *hmm, hmmSegment *segment, double *entryLogProbs, double *exitLogProbs) {
+    /*
+     * Forward algorithm for the segment, given the forward log probabilities of the entry merge cells, calculating
+     * those of the exit merge cells. Requires that the emission probabilities have been calculated.
+     * The entry and exit merge cells, which are shared with the adjacent segments, are not modified.
+     */
+    bool maxNotSum = hmm->parameters->maxNotSumTransitions;
+
+    // Initialise the probabilities
+    for(int64_t i=0; i<stList_length(segment->mergeCells); i++) {
+        ((stRPMergeCell *)stList_get(segment->mergeCells, i))->forwardLogProb = ST_MATH_LOG_ZERO;
+    }
+    for(int64_t i=0; i<segment->exitNumber; i++) {
+        exitLogProbs[i] = ST_MATH_LOG_ZERO;
+    }
+
+    stRPColumn *column = segment->firstColumn;
+    while(1) {
+        stRPCell *cell = column->head;
+        int64_t i = 0;
+        do {
+            // Propagate forward probability from the previous merge cell and add the emission probability
+            cell->forwardLogProb = column == segment->firstColumn ? entryLogProbs[segment->entryIndices[i]] :
+                    stRPMergeColumn_getPreviousMergeCell(cell, column->pColumn)->forwardLogProb;
+            cell->forwardLogProb += cell->backwardLogProb;
+
+            // Propagate forward probability to the next merge cell
+            if(column == segment->lastColumn) {
+                exitLogProbs[segment->exitIndices[i]] = logAddP(exitLogProbs[segment->exitIndices[i]],
+                        cell->forwardLogProb, maxNotSum);
+            }
+            else {
+                stRPMergeCell *mCell = stRPMergeColumn_getNextMergeCell(cell, column->nColumn);
+                mCell->forwardLogProb = logAddP(mCell->forwardLogProb, cell->forwardLogProb, maxNotSum);
+            }
+            i++;
+        } while((cell = cell->nCell) != NULL);
+
+        if(column == segment->lastColumn) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+}
+
+static void hmmSegment_backward(stRPHmm *hmm, hmmSegment *segment) {
+    /*
+     * Backward algorithm for the segment, given the backward log probabilities of the exit merge cells.
+     * Requires that hmmSegment_forward has been run, and, like it, does not modify the entry and exit merge cells.
+     */
+    bool maxNotSum = hmm->parameters->maxNotSumTransitions;
+
+    for(int64_t i=0; i<stList_length(segment->mergeCells); i++) {
+        ((stRPMergeCell *)stList_get(segment->mergeCells, i))->backwardLogProb = ST_MATH_LOG_ZERO;
+    }
+
+    stRPColumn *column = segment->lastColumn;
+    while(1) {
+        stRPCell *cell = column->head;
+        int64_t i = 0;
+        do {
+            // Retrieve the emission probability stored by the forward pass
+            double probabilityToPropagateLogProb = cell->backwardLogProb;
+
+            // Propagate backward probability from the next merge cell
+            cell->backwardLogProb = column == segment->lastColumn ? segment->exitLogProbs[segment->exitIndices[i]] :
+                    stRPMergeColumn_getNextMergeCell(cell, column->nColumn)->backwardLogProb;
+            probabilityToPropagateLogProb += cell->backwardLogProb;
+
+            // Propagate backward probability to the previous merge cell
+            if(column != segment->firstColumn) {
+                stRPMergeCell *mCell = stRPMergeColumn_getPreviousMergeCell(cell, column->pColumn);
+                mCell->backwardLogProb = logAddP(mCell->backwardLogProb, probabilityToPropagateLogProb, maxNotSum);
+            }
+
+            // Add to column total probability
+            column->totalLogProb = logAddP(column->totalLogProb,
+                    cell->forwardLogProb + cell->backwardLogProb, maxNotSum);
+            i++;
+        } while((cell = cell->nCell) != NULL);
+
+        if(column == segment->firstColumn) {
+            break;
+        }
+        column = column->pColumn->pColumn;
+    }
+}
+
+static void hmmSegment_calculateTransferMatrix(stRPHmm *hmm, hmmSegment *segment) {
+    /*
+     * Calculates the transfer matrix of the segment by running the forward algorithm from each entry merge cell.
+     */
+    double entryLogProbs[segment->entryNumber];
+    for(int64_t i=0; i<segment->entryNumber; i++) {
+        entryLogProbs[i] = ST_MATH_LOG_ZERO;
+    }
+    for(int64_t i=0; i<segment->entryNumber; i++) {
+        entryLogProbs[i] = ST_MATH_LOG_ONE;
+        hmmSegment_forward(hmm, segment, entryLogProbs, &segment->transferMatrix[i * segment->exitNumber]);
+        entryLogProbs[i] = ST_MATH_LOG_ZERO;
+    }
+}
+
+void stRPHmm_forwardBackwardBySegments(stRPHmm *hmm, int64_t segmentNumber, int64_t maxMergeCellsAtSegmentBoundary) {
+    /*
+     * Runs the forward and backward algorithms and sets the total column probabilities, as stRPHmm_forwardBackward,
+     * dividing the hmm into at most segmentNumber segments that are computed in parallel, if OpenMP is available.
+     * Segments are only cut at merge columns with at most maxMergeCellsAtSegmentBoundary merge cells, as the cost of
+     * computing the transfer matrix of a segment is proportional to the number of merge cells at its start.
+     *
+     * In (max, +) mode (hmm->parameters->maxNotSumTransitions) the results are identical to stRPHmm_forwardBackward,
+     * otherwise they differ only by floating point rounding.
+     */
+    bool maxNotSum = hmm->parameters->maxNotSumTransitions;
+
+    stRPHmm_initialiseProbs(hmm);
+
+    stList *segments = getHmmSegments(hmm, segmentNumber, maxMergeCellsAtSegmentBoundary);
+    int64_t n = stList_length(segments);
+
+    // Calculate the emission probabilities and transfer matrix of each segment
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int64_t i=0; i<n; i++) {
+        hmmSegment *segment = stList_get(segments, i);
+        hmmSegment_calculateEmissions(hmm, segment);
+        hmmSegment_calculateTransferMatrix(hmm, segment);
+    }
+
+    // Calculate the forward probabilities of the entry merge cells of each segment
+    ((hmmSegment *)stList_get(segments, 0))->entryLogProbs[0] = ST_MATH_LOG_ONE;
+    for(int64_t i=0; i<n; i++) {
+        hmmSegment *segment = stList_get(segments, i);
+        double *exitLogProbs = i+1 < n ? ((hmmSegment *)stList_get(segments, i+1))->entryLogProbs : &hmm->forwardLogProb;
+        for(int64_t k=0; k<segment->exitNumber; k++) {
+            exitLogProbs[k] = ST_MATH_LOG_ZERO;
+            for(int64_t j=0; j<segment->entryNumber; j++) {
+                exitLogProbs[k] = logAddP(exitLogProbs[k], segment->entryLogProbs[j] +
+                        segment->transferMatrix[j * segment->exitNumber + k], maxNotSum);
+            }
+        }
+    }
+
+    // Calculate the backward probabilities of the exit merge cells of each segment
+    ((hmmSegment *)stList_peek(segments))->exitLogProbs[0] = ST_MATH_LOG_ONE;
+    for(int64_t i=n-1; i>=0; i--) {
+        hmmSegment *segment = stList_get(segments, i);
+        double *entryLogProbs = i > 0 ? ((hmmSegment *)stList_get(segments, i-1))->exitLogProbs : &hmm->backwardLogProb;
+        for(int64_t j=0; j<segment->entryNumber; j++) {
+            entryLogProbs[j] = ST_MATH_LOG_ZERO;
+            for(int64_t k=0; k<segment->exitNumber; k++) {
+                entryLogProbs[j] = logAddP(entryLogProbs[j], segment->transferMatrix[j * segment->exitNumber + k] +
+                        segment->exitLogProbs[k], maxNotSum);
+            }
+        }
+    }
+
+    // Fill in the probabilities within each segment
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int64_t i=0; i<n; i++) {
+        hmmSegment *segment = stList_get(segments, i);
+        double exitLogProbs[segment->exitNumber];
+        hmmSegment_forward(hmm, segment, segment->entryLogProbs, exitLogProbs);
+        hmmSegment_backward(hmm, segment);
+    }
+
+    // Set the probabilities of the merge cells between segments
+    for(int64_t i=1; i<n; i++) {
+        hmmSegment *segment = stList_get(segments, i);
+        hmmSegment *pSegment = stList_get(segments, i-1);
+        for(int64_t j=0; j<segment->entryNumber; j++) {
+            segment->entryMergeCells[j]->forwardLogProb = segment->entryLogProbs[j];
+            segment->entryMergeCells[j]->backwardLogProb = pSegment->exitLogProbs[j];
+        }
+    }
+
+    // Cleanup
+    stList_destruct(segments);
+}
+
+void stRPHmm_forwardBackward(stRPHmm *hmm) {
+    /*
+     * Runs the forward and backward algorithms and sets the total column probabilities.
+     *
+     * This function must be run upon an HMM to calculate cell posterior probabilities.
+     */
+    // If requested divide the hmm into segments that are computed in parallel
+    if(hmm->parameters->forwardBackwardSegmentNumber > 1) {
+        stRPHmm_forwardBackwardBySegments(hmm, hmm->parameters->forwardBackwardSegmentNumber,
+                hmm->parameters->maxMergeCellsAtSegmentBoundary);
+        return;
+    }
+    // If requested calculate the emission probabilities first and run the forward and backward passes concurrently
+    if(hmm->parameters->concurrentForwardBackward) {
+        stRPHmm_forwardBackwardConcurrently(hmm);
+        return;
+    }
+    // Initialise state values
+    stRPHmm_initialiseProbs(hmm);
+    // Run the forward and backward passes
+    stRPHmm_forward(hmm);
+    stRPHmm_backward(hmm);
+}
+
+/*
+ * A cell or merge cell together with its posterior probability, used when pruning
+ * so that the posterior probability of each cell is calculated just once.
+ */
+typedef struct _posteriorProbAndCell posteriorProbAndCell;
+struct _posteriorProbAndCell {
+    double posteriorProb;
+    void *cell; // Either a stRPCell or a stRPMergeCell
+};
+
+static int posteriorProbAndCellCmpFn(const void *a, const void *b) {
+    /*
+     * Sort cells by posterior probability in descending order.
+     */
+    double p1 = ((posteriorProbAndCell *)a)->posteriorProb, p2 = ((posteriorProbAndCell *)b)->posteriorProb;
+    return p1 > p2 ? -1 : p1 < p2 ? 1 : 0;
+}
+
+static void selectMostProbableCells(posteriorProbAndCell *cells, int64_t cellNumber, int64_t k) {
+    /*
+     * Reorders the cells so that the first k are the k cells with highest posterior probability,
+     * using quickselect. The order within the first k cells is arbitrary.
+     */
+    int64_t left = 0, right = cellNumber-1, target = k-1;
+    if(k <= 0 || k >= cellNumber) {
+        return;
+    }
+    while(left < right) {
+        // Use the median of the first, middle and last cells as the pivot
+        double p1 = cells[left].posteriorProb, p2 = cells[(left+right)/2].posteriorProb, p3 = cells[right].posteriorProb;
+        double pivot = p1 > p2 ? (p2 > p3 ? p2 : (p1 > p3 ? p3 : p1)) : (p1 > p3 ? p1 : (p2 > p3 ? p3 : p2));
+
+        // Partition into cells with probability greater than or equal to the pivot followed by those less than
+        // or equal to the pivot
+        int64_t i = left, j = right;
+        while(i <= j) {
+            while(cells[i].posteriorProb > pivot) {
+                i++;
+            }
+            while(cells[j].posteriorProb < pivot) {
+                j--;
+            }
+            if(i <= j) {
+                posteriorProbAndCell swap = cells[i];
+                cells[i++] = cells[j];
+                cells[j--] = swap;
+            }
+        }
+
+        // Continue with the side containing the kth cell, if needed
+        if(target <= j) {
+            right = j;
+        }
+        else if(target >= i) {
+            left = i;
+        }
+        else {
+            break;
+        }
+    }
+}
+
+static int64_t pruneCells(const stRPHmmParameters *params, posteriorProbAndCell *cells, int64_t cellNumber,
+        double *retainedPosteriorMass) {
+    /*
+     * Reorders the cells so that the cells to keep come first, ordered by descending posterior probability,
+     * and returns the number of cells to keep.
+     *
+     * The cells kept are the most probable params->maxPartitionsInAColumn cells, less any of those whose
+     * posterior probability is below params->minPosteriorProbabilityForPartition, but never fewer than
+     * params->minPartitionsInAColumn cells (unless there are fewer cells than that to begin with).
+     *
+     * If params->targetPosteriorMassForPartitions is greater than zero the probability threshold is replaced by
+     * an adaptive one: the fewest most probable cells are kept whose summed posterior probability is at least
+     * that fraction of the total of all the cells, subject to the same floor and ceiling on the number of cells.
+     *
+     * If retainedPosteriorMass is not NULL it is set to the fraction of the total posterior probability of the
+     * cells that is held by the cells kept.
+     */
+
+    // Calculate the total posterior probability of the cells, which is not one if maximising over transitions
+    double totalPosteriorMass = 0.0;
+    for(int64_t i=0; i<cellNumber; i++) {
+        totalPosteriorMass += cells[i].posteriorProb;
+    }
+
+    // Calculate the number of cells to keep
+    int64_t cellsToKeep;
+    if(params->targetPosteriorMassForPartitions > 0) {
+        cellsToKeep = params->maxPartitionsInAColumn < cellNumber ? params->maxPartitionsInAColumn : cellNumber;
+    }
+    else {
+        int64_t probableCells = 0;
+        for(int64_t i=0; i<cellNumber; i++) {
+            if(cells[i].posteriorProb >= params->minPosteriorProbabilityForPartition) {
+                probableCells++;
+            }
+        }
+        cellsToKeep = probableCells < params->maxPartitionsInAColumn ? probableCells : params->maxPartitionsInAColumn;
+        if(cellsToKeep < params->minPartitionsInAColumn) {
+            cellsToKeep = params->minPartitionsInAColumn;
+        }
+        if(cellsToKeep > cellNumber) {
+            cellsToKeep = cellNumber;
+        }
+    }
+
+    // Select the cells to keep and sort them
+    selectMostProbableCells(cells, cellNumber, cellsToKeep);
+    qsort(cells, cellsToKeep, sizeof(posteriorProbAndCell), posteriorProbAndCellCmpFn);
+
+    // Sum the posterior probability of the cells kept, in the adaptive case stopping once the target is reached
+    double posteriorMass = 0.0;
+    int64_t i = 0;
+    while(i < cellsToKeep && (params->targetPosteriorMassForPartitions <= 0 || i < params->minPartitionsInAColumn ||
+          posteriorMass < params->targetPosteriorMassForPartitions * totalPosteriorMass)) {
+        posteriorMass += cells[i++].posteriorProb;
+    }
+    cellsToKeep = i;
+
+    if(retainedPosteriorMass != NULL) {
+        *retainedPosteriorMass = totalPosteriorMass > 0 ? posteriorMass / totalPosteriorMass : 1.0;
+    }
+
+    return cellsToKeep;
+}
+
+static void filterMergeCells(stRPMergeColumn *mColumn) {
+    /*
+     * Removes merge cells from the column that are not marked as chosen, and resets the
+     * chosen mark of those that remain.
+     */
+    stList *mergeCells = stHash_getValues(mColumn->mergeCellsFrom);
+    for(int64_t i=0; i<stList_length(mergeCells); i++) {
+        stRPMergeCell *mCell = stList_get(mergeCells, i);
+        assert(mCell != NULL);
+        if(!mCell->chosen) {
+            // Remove the state from the merge column
+            assert(stHash_search(mColumn->mergeCellsFrom, &(mCell->fromPartition)) == mCell);
+            assert(stHash_search(mColumn->mergeCellsTo, &(mCell->toPartition)) == mCell);
+            stHash_remove(mColumn->mergeCellsFrom, &(mCell->fromPartition));
+            stHash_remove(mColumn->mergeCellsTo, &(mCell->toPartition));
+
+            // Cleanup
+            stRPMergeCell_destruct(mCell);
+        }
+        else {
+            mCell->chosen = 0;
+        }
+    }
+    stList_destruct(mergeCells);
+    assert(stHash_size(mColumn->mergeCellsFrom) > 0);
+    assert(stHash_size(mColumn->mergeCellsFrom) == stHash_size(mColumn->mergeCellsTo));
+}
+
+static posteriorProbAndCell *getLinkedMergeCells(stRPMergeColumn *mColumn,
+        stRPMergeCell *(*getNCell)(stRPCell *, stRPMergeColumn *),
+        posteriorProbAndCell *cells, int64_t cellNumber, int64_t *mergeCellNumber) {
+    /*
+     * Returns the merge cells in the column that are linked to a cell in cells, with their posterior
+     * probabilities, marking each as chosen. Sets *mergeCellNumber to the number of merge cells returned.
+     */
+    posteriorProbAndCell *mergeCells = st_malloc(sizeof(posteriorProbAndCell) * cellNumber);
+    *mergeCellNumber = 0;
+    for(int64_t i=0; i<cellNumber; i++) {
+        stRPMergeCell *mCell = getNCell(cells[i].cell, mColumn);
+        assert(mCell != NULL);
+        if(!mCell->chosen) {
+            mCell->chosen = 1;
+            mergeCells[*mergeCellNumber].cell = mCell;
+            mergeCells[(*mergeCellNumber)++].posteriorProb = stRPMergeCell_posteriorProb(mCell, mColumn);
+        }
+    }
+    assert(*mergeCellNumber > 0);
+    return mergeCells;
+}
+
+static void relinkCells(stRPColumn *column, posteriorProbAndCell *cells, int64_t cellNumber) {
+    /*
+     * Re-links the cells in the array 'cells' to make up the list of cells in the column.
+     */
+    stRPCell **pCell = &column->head; // Pointer to previous cell, used to
+    // remove cells from the linked list
+    for(int64_t i=0; i<cellNumber; i++) {
+        stRPCell *cell = cells[i].cell;
+        *pCell = cell;
+        pCell = &cell->nCell;
+    }
+    *pCell = NULL;
+    assert(column->head != NULL);
+}
+
+static posteriorProbAndCell *getLinkedCells(stRPColumn *column,
+        stRPMergeCell *(*getPCell)(stRPCell *, stRPMergeColumn *),
+        stRPMergeColumn *mColumn, int64_t *cellNumber) {
+    /*
+     * Returns the cells in column that are linked to a cell in mColumn, with their posterior probabilities.
+     * Cells that are not linked are destroyed. Sets *cellNumber to the number of cells returned.
+     */
+    int64_t maxCellNumber = 0;
+    stRPCell *cell = column->head;
+    do {
+        maxCellNumber++;
+    } while((cell = cell->nCell) != NULL);
+
+    // Put cells into an array only keeping cells that still have a preceding merge cell
+    posteriorProbAndCell *cells = st_malloc(sizeof(posteriorProbAndCell) * maxCellNumber);
+    *cellNumber = 0;
+    cell = column->head;
+    do {
+        if(mColumn == NULL || getPCell(cell, mColumn) != NULL) {
+            cells[*cellNumber].cell = cell;
+            cells[(*cellNumber)++].posteriorProb = stRPCell_posteriorProb(cell, column);
+            cell = cell->nCell;
+        }
+        else {
+            stRPCell *nCell = cell->nCell;
+            stRPCell_destruct(cell);
+            cell = nCell;
+        }
+    } while(cell != NULL);
+    assert(*cellNumber > 0);
+
+    return cells;
+}
+
+static posteriorProbAndCell *pruneColumnForwards(stRPHmm *hmm, stRPColumn *column, stRPMergeColumn *mColumn,
+        int64_t *cellNumber, double *retainedPosteriorMass) {
+    /*
+     * Removes the cells from column that are not linked to a merge cell in the previous merge column mColumn
+     * (if not NULL) or whose posterior probability is too low. Returns the remaining cells, ordered from most
+     * to least probable, and sets *cellNumber to their number. If retainedPosteriorMass is not NULL it is set
+     * as by pruneCells.
+     */
+    assert(column->head != NULL);
+
+    // Get cells that have a valid previous cell
+    int64_t linkedCellNumber;
+    posteriorProbAndCell *cells = getLinkedCells(column, stRPMergeColumn_getPreviousMergeCell, mColumn,
+            &linkedCellNumber);
+
+    // Get rid of the excess cells
+    *cellNumber = pruneCells(hmm->parameters, cells, linkedCellNumber, retainedPosteriorMass);
+    for(int64_t i=*cellNumber; i<linkedCellNumber; i++) {
+        stRPCell_destruct(cells[i].cell);
+    }
+
+    // Relink the cells (from most probable to least probable)
+    relinkCells(column, cells, *cellNumber);
+
+    return cells;
+}
+
+static void pruneMergeColumnForwards(stRPHmm *hmm, stRPMergeColumn *mColumn,
+        posteriorProbAndCell *cells, int64_t cellNumber, double *retainedPosteriorMass) {
+    /*
+     * Removes the merge cells from mColumn that are not linked to a cell in cells, the remaining
+     * cells of the previous column, or whose posterior probability is too low. If retainedPosteriorMass is not
+     * NULL it is set as by pruneCells.
+     */
+
+    //  Get merge cells that are connected to a cell in the previous column
+    int64_t mergeCellNumber;
+    posteriorProbAndCell *mergeCells = getLinkedMergeCells(mColumn,
+            stRPMergeColumn_getNextMergeCell, cells, cellNumber, &mergeCellNumber);
+
+    // Shrink the the number of chosen cells to less than equal to the desired number
+    int64_t chosenMergeCellNumber = pruneCells(hmm->parameters, mergeCells, mergeCellNumber, retainedPosteriorMass);
+    for(int64_t i=chosenMergeCellNumber; i<mergeCellNumber; i++) {
+        ((stRPMergeCell *)mergeCells[i].cell)->chosen = 0;
+    }
+
+    // Get rid of merge cells we don't need
+    filterMergeCells(mColumn);
+    assert(chosenMergeCellNumber == stHash_size(mColumn->mergeCellsFrom));
+
+    // Cleanup
+    free(mergeCells);
+}
+
+double stRPHmm_pruneForwards(stRPHmm *hmm) {
+    /*
+     * Remove cells from hmm whos posterior probability is below the given threshold.
+     * Returns the least fraction of the posterior probability of a column or merge column retained by the pruning.
+     */
+
+    // For each column
+    stRPColumn *column = hmm->firstColumn;
+    stRPMergeColumn *mColumn = NULL;
+    double minRetainedPosteriorMass = 1.0, retainedPosteriorMass;
+    int64_t cellsRetained = 0, columnsPruned = 0;
+
+    while(1) {
+        // Get rid of the excess cells
+        int64_t cellNumber;
+        posteriorProbAndCell *cells = pruneColumnForwards(hmm, column, mColumn, &cellNumber, &retainedPosteriorMass);
+        minRetainedPosteriorMass = retainedPosteriorMass < minRetainedPosteriorMass ?
+                                   retainedPosteriorMass : minRetainedPosteriorMass;
+        cellsRetained += cellNumber;
+        columnsPruned++;
 
         // Move on to the next merge column
         mColumn = column->nColumn;
 
         if(mColumn == NULL) {
             assert(column == hmm->lastColumn);
-            stList_destruct(cells);
+            free(cells);
             break;
         }
 
-        //  Get merge cells that are connected to a cell in the previous column
-        stSet *chosenMergeCellsSet = getLinkedMergeCells(mColumn,
-                stRPMergeColumn_getNextMergeCell, cells);
-
-        // Shrink the the number of chosen cells to less than equal to the desired number
-        stList *chosenMergeCellsList = stSet_getList(chosenMergeCellsSet);
-        stList_sort2(chosenMergeCellsList, mergeCellCmpFn, mColumn);
-        while(stList_length(chosenMergeCellsList) > hmm->parameters->minPartitionsInAColumn &&
-              (stList_length(chosenMergeCellsList) > hmm->parameters->maxPartitionsInAColumn ||
-               stRPMergeCell_posteriorProb(stList_peek(chosenMergeCellsList), mColumn) <
-                       hmm->parameters->minPosteriorProbabilityForPartition)) {
-            stSet_remove(chosenMergeCellsSet, stList_pop(chosenMergeCellsList));
-        }
-        assert(stList_length(chosenMergeCellsList) == stSet_size(chosenMergeCellsSet));
-        stList_destruct(chosenMergeCellsList);
-
-        // Get rid of merge cells we don't need
-        filterMergeCells(mColumn, chosenMergeCellsSet);
+        // Get rid of the excess merge cells
+        pruneMergeColumnForwards(hmm, mColumn, cells, cellNumber, &retainedPosteriorMass);
+        minRetainedPosteriorMass = retainedPosteriorMass < minRetainedPosteriorMass ?
+                                   retainedPosteriorMass : minRetainedPosteriorMass;
 
         // Cleanup
-        stList_destruct(cells);
-        stSet_destruct(chosenMergeCellsSet);
+        free(cells);
 
         column = mColumn->nColumn;
     }
+
+    st_logDebug("Pruned hmm over %s:%" PRIi64 "-%" PRIi64 " to an average of %f cells per column, "
+                "retaining at least %f of the posterior probability of each column\n", hmm->referenceName,
+                hmm->refStart, hmm->refStart + hmm->refLength, (double)cellsRetained / columnsPruned,
+                minRetainedPosteriorMass);
+
+    return minRetainedPosteriorMass;
 }
 
 void stRPHmm_pruneBackwards(stRPHmm *hmm) {
@@ -1321,45 +2118,302 @@ void stRPHmm_pruneBackwards(stRPHmm *hmm) {
         assert(column->head != NULL);
 
         // Get cells that have a valid previous cell
-        stList *cells = getLinkedCells(column, stRPMergeColumn_getNextMergeCell, mColumn);
+        int64_t cellNumber;
+        posteriorProbAndCell *cells = getLinkedCells(column, stRPMergeColumn_getNextMergeCell, mColumn, &cellNumber);
 
         // This must be true because the forward pass has already winnowed the number below the
         // threshold
-        assert(stList_length(cells) <= hmm->parameters->maxPartitionsInAColumn);
+        assert(cellNumber <= hmm->parameters->maxPartitionsInAColumn);
 
         // Relink the cells (from most probable to least probable)
-        relinkCells(column, cells);
+        qsort(cells, cellNumber, sizeof(posteriorProbAndCell), posteriorProbAndCellCmpFn);
+        relinkCells(column, cells, cellNumber);
 
         // Move on to the next merge column
         mColumn = column->pColumn;
 
         if(mColumn == NULL) {
             assert(column == hmm->firstColumn);
-            stList_destruct(cells);
+            free(cells);
             break;
         }
 
         //  Get merge cells that are connected to a cell in the previous column
-        stSet *chosenMergeCellsSet = getLinkedMergeCells(mColumn,
-                stRPMergeColumn_getPreviousMergeCell, cells);
+        int64_t mergeCellNumber;
+        posteriorProbAndCell *mergeCells = getLinkedMergeCells(mColumn,
+                stRPMergeColumn_getPreviousMergeCell, cells, cellNumber, &mergeCellNumber);
 
         // By the same logic, this number if pruned on the forwards pass
-        assert(stSet_size(chosenMergeCellsSet) <= hmm->parameters->maxPartitionsInAColumn);
+        assert(mergeCellNumber <= hmm->parameters->maxPartitionsInAColumn);
 
         // Get rid of merge cells we don't need
-        filterMergeCells(mColumn, chosenMergeCellsSet);
+        filterMergeCells(mColumn);
 
         // Cleanup
-        stList_destruct(cells);
-        stSet_destruct(chosenMergeCellsSet);
+        free(cells);
+        free(mergeCells);
 
         column = mColumn->pColumn;
     }
 }
 
-void stRPHmm_prune(stRPHmm *hmm) {
-    stRPHmm_pruneForwards(hmm);
+double stRPHmm_prune(stRPHmm *hmm) {
+    /*
+     * Prunes the hmm forwards then backwards, returning the least fraction of the posterior probability of a
+     * column or merge column retained (see stRPHmm_pruneForwards).
+     */
+    double minRetainedPosteriorMass = stRPHmm_pruneForwards(hmm);
     stRPHmm_pruneBackwards(hmm);
+    return minRetainedPosteriorMass;
+}
+
+static void setMergeColumnProbs(stRPMergeColumn *mColumn, bool resetForward, bool resetBackward) {
+    /*
+     * Resets the forward and/or backward probabilities of the cells in the merge column to log(0).
+     */
+    stHashIterator *it = stHash_getIterator(mColumn->mergeCellsFrom);
+    stRPMergeCell *mCell;
+    while((mCell = stHash_getNext(it)) != NULL) {
+        if(resetForward) {
+            mCell->forwardLogProb = ST_MATH_LOG_ZERO;
+        }
+        if(resetBackward) {
+            mCell->backwardLogProb = ST_MATH_LOG_ZERO;
+        }
+    }
+    stHash_destructIterator(it);
+}
+
+static stRPColumn *createCrossProductSegment(stRPHmm *hmm, stRPColumn **columns1, stRPColumn **columns2,
+        int64_t firstColumnIndex, int64_t lastColumnIndex, stRPMergeColumn *pMergeColumn,
+        stRPMergeColumn **nMergeColumn, stRPColumn **lastColumn) {
+    /*
+     * Creates the cross product of the aligned columns columns1[firstColumnIndex..lastColumnIndex] and
+     * columns2[firstColumnIndex..lastColumnIndex], including the merge columns in between. The first column is
+     * linked to pMergeColumn, if not NULL. If the last column is not the last column of the input hmms, the last column is
+     * linked to *nMergeColumn, which is created if NULL.
+     *
+     * Initialises the probabilities of the new columns and merge columns. Returns the first column and
+     * sets *lastColumn to the last column.
+     */
+    stRPColumn *firstColumn = NULL;
+    stRPMergeColumn *mColumn = pMergeColumn;
+
+    for(int64_t i=firstColumnIndex; i<=lastColumnIndex; i++) {
+        // Create the column
+        stRPColumn *column = createCrossProductOfTwoAlignedColumns(hmm, columns1[i], columns2[i]);
+        column->totalLogProb = ST_MATH_LOG_ZERO;
+        if(firstColumn == NULL) {
+            firstColumn = column;
+        }
+
+        // Link to the previous merge column
+        if(mColumn != NULL) {
+            mColumn->nColumn = column;
+            column->pColumn = mColumn;
+        }
+        *lastColumn = column;
+
+        // If the last column of the input hmms there is no following merge column
+        if(columns1[i]->nColumn == NULL) {
+            assert(i == lastColumnIndex);
+            break;
+        }
+
+        // Get the following merge column, creating it if needed
+        if(i < lastColumnIndex || *nMergeColumn == NULL) {
+            mColumn = createCrossProductOfTwoAlignedMergeColumns(hmm, columns1[i]->nColumn, columns2[i]->nColumn);
+            setMergeColumnProbs(mColumn, 1, 1);
+            if(i == lastColumnIndex) {
+                *nMergeColumn = mColumn;
+            }
+        }
+        else {
+            mColumn = *nMergeColumn;
+        }
+
+        // Connect links
+        mColumn->pColumn = column;
+        column->nColumn = mColumn;
+    }
+
+    return firstColumn;
+}
+
+static void destructCrossProductSegment(stRPColumn *column, stRPColumn *lastColumn) {
+    /*
+     * Destroys the columns from column to lastColumn inclusive and the merge columns between them,
+     * unlinking them from the merge columns on either side.
+     */
+    if(column->pColumn != NULL) {
+        column->pColumn->nColumn = NULL;
+    }
+    if(lastColumn->nColumn != NULL) {
+        lastColumn->nColumn->pColumn = NULL;
+    }
+    while(1) {
+        stRPMergeColumn *mColumn = column->nColumn;
+        stRPColumn_destruct(column);
+        if(column == lastColumn) {
+            break;
+        }
+        column = mColumn->nColumn;
+        stRPMergeColumn_destruct(mColumn);
+    }
+}
+
+static void forwardBackwardCrossProductSegment(stRPHmm *hmm, stRPColumn *firstColumn, stRPColumn *lastColumn,
+        bool runBackward) {
+    /*
+     * Runs the forward algorithm and optionally then the backward algorithm over the columns of a segment.
+     * The forward probabilities of the merge column preceding the segment and the backward probabilities of the
+     * merge column following the segment must already be calculated. These are the checkpoints. The forward
+     * probabilities of the merge column following the segment and the backward probabilities of the merge
+     * column preceding the segment are (re)calculated.
+     */
+
+    // Reset the probabilities that are accumulated in the enclosing merge columns / hmm
+    if(lastColumn->nColumn != NULL) {
+        setMergeColumnProbs(lastColumn->nColumn, 1, 0);
+    }
+    else {
+        hmm->forwardLogProb = ST_MATH_LOG_ZERO;
+    }
+    if(runBackward) {
+        if(firstColumn->pColumn != NULL) {
+            setMergeColumnProbs(firstColumn->pColumn, 0, 1);
+        }
+        else {
+            hmm->backwardLogProb = ST_MATH_LOG_ZERO;
+        }
+    }
+
+    // Forward
+    stRPColumn *column = firstColumn;
+    while(1) {
+        stRPHmm_forwardColumn(hmm, column);
+        if(column == lastColumn) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+
+    // Backward
+    if(runBackward) {
+        while(1) {
+            stRPHmm_backwardColumn(hmm, column);
+            if(column == firstColumn) {
+                break;
+            }
+            column = column->pColumn->pColumn;
+        }
+    }
+}
+
+stRPHmm *stRPHmm_createPrunedCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2) {
+    /*
+     * Equivalent to calling stRPHmm_createCrossProductOfTwoAlignedHmm, stRPHmm_forwardBackward
+     * and stRPHmm_prune in turn, but without ever holding the complete, unpruned cross product in memory.
+     *
+     * The columns are divided into segments of params->columnsBetweenCheckpoints columns (or the square root of the
+     * number of columns if this is zero). Only the merge columns between segments (the checkpoints) are kept
+     * throughout; the cross product of each segment is recomputed as needed:
+     *
+     *  (1) A forward pass over the segments, from first to last, calculating the forward probabilities of the checkpoints.
+     *  (2) A backward pass over the segments, from last to first, calculating the backward probabilities of the checkpoints.
+     *  (3) A forward pass over the segments that recomputes the forward and backward probabilities of each segment and
+     *  then prunes it, as in stRPHmm_pruneForwards. The pruned segments make up the returned hmm.
+     *
+     * The resulting hmm is then pruned using stRPHmm_pruneBackwards.
+     */
+
+    // Create a new empty hmm
+    stRPHmm *hmm = createEmptyCrossProductHmm(hmm1, hmm2);
+
+    // Get arrays of the aligned columns of the two hmms
+    int64_t columnNumber = hmm->columnNumber;
+    stRPColumn **columns1 = st_malloc(sizeof(stRPColumn *) * columnNumber);
+    stRPColumn **columns2 = st_malloc(sizeof(stRPColumn *) * columnNumber);
+    stRPColumn *column1 = hmm1->firstColumn, *column2 = hmm2->firstColumn;
+    for(int64_t i=0; i<columnNumber; i++) {
+        assert(column1 != NULL && column2 != NULL);
+        columns1[i] = column1;
+        columns2[i] = column2;
+        column1 = column1->nColumn == NULL ? NULL : column1->nColumn->nColumn;
+        column2 = column2->nColumn == NULL ? NULL : column2->nColumn->nColumn;
+    }
+    assert(column1 == NULL && column2 == NULL);
+
+    // Choose the segment length
+    int64_t segmentLength = hmm->parameters->columnsBetweenCheckpoints > 0 ?
+            hmm->parameters->columnsBetweenCheckpoints : (int64_t)ceil(sqrt(columnNumber));
+    int64_t segmentNumber = (columnNumber + segmentLength - 1) / segmentLength;
+
+    // The checkpoints, checkpoints[i] is the merge column following the ith segment
+    stRPMergeColumn **checkpoints = st_calloc(segmentNumber, sizeof(stRPMergeColumn *));
+
+    // (1) Forward pass, calculating the forward probabilities of the checkpoints
+    stRPColumn *firstColumn, *lastColumn;
+    for(int64_t i=0; i<segmentNumber; i++) {
+        firstColumn = createCrossProductSegment(hmm, columns1, columns2, segmentLength*i,
+                segmentLength*(i+1) < columnNumber ? segmentLength*(i+1)-1 : columnNumber-1,
+                i > 0 ? checkpoints[i-1] : NULL, &checkpoints[i], &lastColumn);
+        forwardBackwardCrossProductSegment(hmm, firstColumn, lastColumn, 0);
+        destructCrossProductSegment(firstColumn, lastColumn);
+    }
+
+    // (2) Backward pass, calculating the backward probabilities of the checkpoints
+    for(int64_t i=segmentNumber-1; i>=0; i--) {
+        firstColumn = createCrossProductSegment(hmm, columns1, columns2, segmentLength*i,
+                segmentLength*(i+1) < columnNumber ? segmentLength*(i+1)-1 : columnNumber-1,
+                i > 0 ? checkpoints[i-1] : NULL, &checkpoints[i], &lastColumn);
+        forwardBackwardCrossProductSegment(hmm, firstColumn, lastColumn, 1);
+        destructCrossProductSegment(firstColumn, lastColumn);
+    }
+
+    // (3) Recompute and prune each segment
+    posteriorProbAndCell *cells = NULL; // The remaining cells of the last column of the previous segment
+    int64_t cellNumber = 0;
+    for(int64_t i=0; i<segmentNumber; i++) {
+        stRPMergeColumn *mColumn = i > 0 ? checkpoints[i-1] : NULL;
+        stRPColumn *column = createCrossProductSegment(hmm, columns1, columns2, segmentLength*i,
+                segmentLength*(i+1) < columnNumber ? segmentLength*(i+1)-1 : columnNumber-1,
+                mColumn, &checkpoints[i], &lastColumn);
+        if(i == 0) {
+            hmm->firstColumn = column;
+        }
+        forwardBackwardCrossProductSegment(hmm, column, lastColumn, 1);
+
+        // Prune the preceding checkpoint, now that the total probability of the following column is known
+        if(mColumn != NULL) {
+            pruneMergeColumnForwards(hmm, mColumn, cells, cellNumber, NULL);
+            free(cells);
+        }
+
+        // Prune the columns and merge columns of the segment
+        while(1) {
+            cells = pruneColumnForwards(hmm, column, mColumn, &cellNumber, NULL);
+            if(column == lastColumn) {
+                break;
+            }
+            mColumn = column->nColumn;
+            pruneMergeColumnForwards(hmm, mColumn, cells, cellNumber, NULL);
+            free(cells);
+            column = mColumn->nColumn;
+        }
+    }
+    hmm->lastColumn = lastColumn;
+    free(cells);
+
+    // Cleanup
+    free(columns1);
+    free(columns2);
+    free(checkpoints);
+
+    // Remove the cells that are not linked to cells in the following columns
+    stRPHmm_pruneBackwards(hmm);
+
+    return hmm;
 }
 
 bool stRPHmm_overlapOnReference(stRPHmm *hmm1, stRPHmm *hmm2) {
@@ -1443,6 +2497,12 @@ stRPHmm *stRPHmm_split(stRPHmm *hmm, int64_t splitPoint) {
         st_errAbort("The split point %" PRIi64 " is after the last position of the reference interval\n", splitPoint);
     }
 
+    // Any retained traceback path is no longer valid
+    if(hmm->path != NULL) {
+        stList_destruct(hmm->path);
+        hmm->path = NULL;
+    }
+
     stRPHmm *suffixHmm = st_calloc(1, sizeof(stRPHmm));
 
     // Set the reference interval for the two hmms
@@ -1502,23 +2562,110 @@ stRPHmm *stRPHmm_split(stRPHmm *hmm, int64_t splitPoint) {
     return suffixHmm;
 }
 
-static bool sitesLinkageIsWellSupported(stRPHmm *hmm, int64_t leftSite, int64_t rightSite) {
+static int64_t getColumnIndex(int64_t *columnStarts, int64_t columnNumber, int64_t site) {
+    /*
+     * Returns the index of the column containing the given reference position, using a binary search of
+     * the sorted array of column reference starts.
+     */
+    assert(columnNumber > 0 && site >= columnStarts[0]);
+    int64_t i = 0, j = columnNumber;
+    while(j - i > 1) {
+        int64_t k = i + (j - i) / 2;
+        if(columnStarts[k] <= site) {
+            i = k;
+        }
+        else {
+            j = k;
+        }
+    }
+    return i;
+}
+
+static stRPPartition getSequencesIncludingSite(stRPColumn *column, int64_t site) {
+    /*
+     * Returns a bit mask of the sequences in the column that include the given reference position,
+     * the ith bit being set if the ith sequence of the column includes the position.
+     */
+    assert(column->depth <= MAX_READ_PARTITIONING_DEPTH);
+    stRPPartition mask = 0;
+    for(int64_t i=0; i<column->depth; i++) {
+        stProfileSeq *pSeq = column->seqHeaders[i];
+        if(pSeq->refStart <= site && pSeq->refStart + pSeq->length > site) {
+            mask |= ((stRPPartition)1) << i;
+        }
+    }
+    return mask;
+}
+
+static bool sitesLinkageIsWellSupported(stRPHmm *hmm, stRPColumn *leftColumn, int64_t rightSite) {
     /*
-     * Returns true if the two sites, specified by reference coordinates leftSite and rightSite, are linked by
+     * Returns true if the site contained in leftColumn and the reference position rightSite are linked by
      * hmm->parameters->minReadCoverageToSupportPhasingBetweenHeterozygousSites, otherwise false.
+     * As each sequence covers a contiguous reference interval the sequences shared by the two sites are those of
+     * leftColumn that include rightSite.
      */
-    stRPColumn *leftColumn = getColumn(hmm->firstColumn, leftSite);
-    stRPColumn *rightColumn = getColumn(leftColumn, rightSite);
+    return popcountPartition(getSequencesIncludingSite(leftColumn, rightSite)) >=
+           hmm->parameters->minReadCoverageToSupportPhasingBetweenHeterozygousSites;
+}
 
-    stSet *sequencesInCommon = stRPColumn_getSequencesInCommon(leftColumn, rightColumn);
+stList *stRPHmm_getHeterozygousSites(stRPHmm *hmm, stList *path) {
+    /*
+     * Returns the reference coordinates, as an ordered list of stIntTuples, of the sites at which the haplotypes
+     * predicted by the given path through the hmm differ. Only positions not filtered out are considered.
+     *
+     * This gives the same sites as comparing the haplotype strings of the genome fragment constructed
+     * for the path, restricted to the unfiltered positions, without constructing the genome fragment.
+     */
+    stList *hetSites = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
 
-    // Condition to determine if well supported by reads
-    bool wellSupported = stSet_size(sequencesInCommon) >= hmm->parameters->minReadCoverageToSupportPhasingBetweenHeterozygousSites;
+    stRPColumn *column = hmm->firstColumn;
+    for(int64_t i=0; i<stList_length(path); i++) {
+        stRPCell *cell = stList_get(path, i);
+        assert(cell != NULL);
+        assert(column != NULL);
 
-    // Cleanup
-    stSet_destruct(sequencesInCommon);
+        addPredictedHeterozygousSites(hetSites, cell->partition, column,
+                                      hmm->referencePriorProbs, (stRPHmmParameters *)hmm->parameters);
 
-    return wellSupported;
+        column = column->nColumn == NULL ? NULL : column->nColumn->nColumn;
+    }
+    assert(column == NULL);
+
+    return hetSites;
+}
+
+static stList *getPathOfSplitHmm(stRPHmm *hmm, stList *path, int64_t *columnStarts, int64_t *pathIndex) {
+    /*
+     * Returns the path through the hmm corresponding to the given path through the hmm it was split from.
+     * columnStarts gives the reference start of the column of each cell in the path, and *pathIndex the index in the
+     * path of the first column of the hmm, which is updated to the index of the last column of the hmm.
+     */
+    stList *splitPath = stList_construct();
+    stRPColumn *column = hmm->firstColumn;
+    while(1) {
+        // Find the cell of the path whose column contains the column
+        while(*pathIndex+1 < stList_length(path) && columnStarts[*pathIndex+1] <= column->refStart) {
+            (*pathIndex)++;
+        }
+        stRPCell *cell = stList_get(path, *pathIndex);
+
+        // If the column was created by splitting a column, find the copy of the cell
+        if(column->refStart != columnStarts[*pathIndex]) {
+            stRPCell *cell2 = column->head;
+            while(cell2->partition != cell->partition) {
+                cell2 = cell2->nCell;
+                assert(cell2 != NULL);
+            }
+            cell = cell2;
+        }
+        stList_append(splitPath, cell);
+
+        if(column->nColumn == NULL) {
+            break;
+        }
+        column = column->nColumn->nColumn;
+    }
+    return splitPath;
 }
 
 stList *stRPHMM_splitWherePhasingIsUncertain(stRPHmm *hmm) {
@@ -1536,21 +2683,29 @@ stList *stRPHMM_splitWherePhasingIsUncertain(stRPHmm *hmm) {
     // Now compute a high probability path through the hmm
     stList *path = stRPHmm_forwardTraceBack(hmm);
 
-    // Get two haplotypes for the path through the HMM
-    stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
-
-    // Find high confidence heterozygous sites
-    stList *hetSites = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
-    for(int64_t i=0; i<gF->length; i++) {
-        // If heterozygous site
-        if(gF->haplotypeString1[i] != gF->haplotypeString2[i]) {
-            stList_append(hetSites, stIntTuple_construct1(gF->refStart + i));
-        }
-    }
+    // Find the heterozygous sites predicted by the path through the HMM
+    stList *hetSites = stRPHmm_getHeterozygousSites(hmm, path);
 
     // Split hmms
     stList *splitHmms = stList_construct3(0,  (void (*)(void *))stRPHmm_destruct2);
 
+    // Record the reference start of the column of each cell in the path, and the column itself, as splitting
+    // modifies the columns. Splitting a column does not change the sequences it contains, so the recorded
+    // columns can still be used to find the sequences including a site
+    int64_t columnNumber = stList_length(path);
+    int64_t *columnStarts = st_malloc(sizeof(int64_t) * columnNumber);
+    stRPColumn **columns = st_malloc(sizeof(stRPColumn *) * columnNumber);
+    stRPColumn *column = hmm->firstColumn;
+    for(int64_t i=0; i<columnNumber; i++) {
+        columnStarts[i] = column->refStart;
+        columns[i] = column;
+        column = column->nColumn == NULL ? NULL : column->nColumn->nColumn;
+    }
+
+    // Whether the phasing of the hmm is independent of any hmm preceding it that it was split from
+    bool leftIndependent = 1;
+    int64_t pathIndex = 0;
+
     // For each pair of contiguous het sites if not supported by sufficient reads split the hmm
     for(int64_t i=0; i<stList_length(hetSites)-1; i++) {
         int64_t j = stIntTuple_get(stList_get(hetSites, i), 0);
@@ -1558,13 +2713,22 @@ stList *stRPHMM_splitWherePhasingIsUncertain(stRPHmm *hmm) {
         assert(k > j);
 
         // If not well supported by reads
-        if(!sitesLinkageIsWellSupported(hmm, j, k)) {
+        if(!sitesLinkageIsWellSupported(hmm, columns[getColumnIndex(columnStarts, columnNumber, j)], k)) {
             // Split hmm
             int64_t splitPoint = j+(k-j+1)/2;
+            bool rightIndependent = getSequencesIncludingSite(
+                    columns[getColumnIndex(columnStarts, columnNumber, splitPoint-1)], splitPoint) == 0;
             stRPHmm *rightHmm = stRPHmm_split(hmm, splitPoint);
             assert(rightHmm->refStart == splitPoint);
             assert(hmm->refStart + hmm->refLength == splitPoint);
 
+            // If no sequence spans either end of the prefix of the hmm then the path through it is
+            // the same as would be computed for it alone, so retain it
+            if(leftIndependent && rightIndependent) {
+                hmm->path = getPathOfSplitHmm(hmm, path, columnStarts, &pathIndex);
+            }
+            leftIndependent = rightIndependent;
+
             // Add prefix of hmm to list of split hmms
             stList_append(splitHmms, hmm);
 
@@ -1574,12 +2738,16 @@ stList *stRPHMM_splitWherePhasingIsUncertain(stRPHmm *hmm) {
     }
 
     // Add the remaining part of the hmm to split hmms
+    if(leftIndependent) {
+        hmm->path = getPathOfSplitHmm(hmm, path, columnStarts, &pathIndex);
+    }
     stList_append(splitHmms, hmm);
 
     // Cleanup
     stList_destruct(hetSites);
     stList_destruct(path);
-    stGenomeFragment_destruct(gF);
+    free(columnStarts);
+    free(columns);
 
     return splitHmms;
 }
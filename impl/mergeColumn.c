@@ -10,22 +10,14 @@
  * Read partitioning hmm merge column (stRPMergeColumn) functions
  */
 
-static uint64_t intHashFn(const void *a) {
-    return *(uint64_t *)a;
-}
-
-static int intEqualsFn(const void *key1, const void *key2) {
-    return *(uint64_t *)key1 == *(uint64_t *)key2;
-}
-
-stRPMergeColumn *stRPMergeColumn_construct(uint64_t maskFrom, uint64_t maskTo) {
+stRPMergeColumn *stRPMergeColumn_construct(stRPPartition maskFrom, stRPPartition maskTo) {
     stRPMergeColumn *mColumn = st_calloc(1, sizeof(stRPMergeColumn));
     mColumn->maskFrom = maskFrom;
     mColumn->maskTo = maskTo;
 
     // Maps between partitions and cells
-    mColumn->mergeCellsFrom = stHash_construct3(intHashFn, intEqualsFn, NULL, (void (*)(void *))stRPMergeCell_destruct);
-    mColumn->mergeCellsTo = stHash_construct3(intHashFn, intEqualsFn, NULL, NULL);
+    mColumn->mergeCellsFrom = stHash_construct3(partitionHashFn, partitionEqualsFn, NULL, (void (*)(void *))stRPMergeCell_destruct);
+    mColumn->mergeCellsTo = stHash_construct3(partitionHashFn, partitionEqualsFn, NULL, NULL);
 
     return mColumn;
 }
@@ -63,7 +55,7 @@ stRPMergeCell *stRPMergeColumn_getNextMergeCell(stRPCell *cell, stRPMergeColumn
     /*
      * Get the merge cell that this cell feeds into.
      */
-    uint64_t i = maskPartition(cell->partition, mergeColumn->maskFrom);
+    stRPPartition i = maskPartition(cell->partition, mergeColumn->maskFrom);
     stRPMergeCell *mCell = stHash_search(mergeColumn->mergeCellsFrom, &i);
     return mCell;
 }
@@ -72,7 +64,7 @@ stRPMergeCell *stRPMergeColumn_getPreviousMergeCell(stRPCell *cell, stRPMergeCol
     /*
      * Get the merge cell that this cell feeds from.
      */
-    uint64_t i = maskPartition(cell->partition,  mergeColumn->maskTo);
+    stRPPartition i = maskPartition(cell->partition,  mergeColumn->maskTo);
     stRPMergeCell *mCell = stHash_search(mergeColumn->mergeCellsTo, &i);
     return mCell;
 }
@@ -88,14 +80,14 @@ int64_t stRPMergeColumn_numberOfPartitions(stRPMergeColumn *mColumn) {
  * Read partitioning hmm merge cell (stRPMergeCell) functions
  */
 
-stRPMergeCell *stRPMergeCell_construct(uint64_t fromPartition, uint64_t toPartition,
+stRPMergeCell *stRPMergeCell_construct(stRPPartition fromPartition, stRPPartition toPartition,
         stRPMergeColumn *mColumn) {
     /*
      * Create a merge cell, adding it to the merge column mColumn.
      */
-    assert(popcount64(fromPartition) == popcount64(toPartition));
-    assert(popcount64(mColumn->maskFrom) == popcount64(mColumn->maskTo));
-    assert(popcount64(fromPartition) <= popcount64(mColumn->maskFrom));
+    assert(popcountPartition(fromPartition) == popcountPartition(toPartition));
+    assert(popcountPartition(mColumn->maskFrom) == popcountPartition(mColumn->maskTo));
+    assert(popcountPartition(fromPartition) <= popcountPartition(mColumn->maskFrom));
 
     stRPMergeCell *mCell = st_calloc(1, sizeof(stRPMergeCell));
     mCell->fromPartition = fromPartition;
@@ -13,10 +13,30 @@
 
 
 
+static hts_idx_t *loadBamRegions(samFile *in, char *bamInFile, bam_hdr_t *bamHdr, stList *regionStrings,
+                                 stBamRegion **regions, int64_t *regionNumber) {
+    /*
+     * If regionStrings is not NULL, returns the index of the bam file and sets *regions to the merged regions to
+     * read with readNextAlignment, otherwise returns NULL and sets *regions to NULL so the whole file is read.
+     */
+    *regions = NULL;
+    *regionNumber = 0;
+    if (regionStrings == NULL) {
+        return NULL;
+    }
+    hts_idx_t *idx = sam_index_load(in, bamInFile);
+    if (idx == NULL) {
+        st_errAbort("ERROR: Cannot load index for bam file %s\n", bamInFile);
+    }
+    *regions = getBamRegions(regionStrings, bamHdr, regionNumber);
+    return idx;
+}
+
 void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionTable *readHaplotypePartitions,
-                        char *marginPhaseTag) {
+                        char *marginPhaseTag, stList *regionStrings) {
     /*
-     * Write out haplotyped sam file
+     * Write out haplotyped sam file. If regionStrings is not NULL only the reads overlapping the regions are
+     * written, read using the bam index.
      */
 
     // Prep
@@ -27,13 +47,19 @@ void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartit
     if (in == NULL) {
         st_errAbort("ERROR: Cannot open bam file %s\n", bamInFile);
     }
+    htslibThreadPool_attach(in);
     bam_hdr_t *bamHdr = bam_hdr_read(in->fp.bgzf);
     bam1_t *aln = bam_init1();
+    stBamRegion *regions;
+    int64_t regionNumber, regionIndex = 0;
+    hts_itr_t *itr = NULL;
+    hts_idx_t *idx = loadBamRegions(in, bamInFile, bamHdr, regionStrings, &regions, &regionNumber);
 
     int r;
     st_logDebug("\tWriting haplotype output to: %s \n", haplotypedSamFile);
 
     samFile *out = hts_open(haplotypedSamFile, "w");
+    htslibThreadPool_attach(out);
     r = sam_hdr_write(out, bamHdr);
 
     // Read in input file, write out each read to one sam file
@@ -41,7 +67,12 @@ void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartit
     int32_t readCountH2 = 0;
     int32_t readCountFiltered = 0;
     char *haplotypeString;
-    while(sam_read1(in,bamHdr,aln) > 0) {
+    while(readNextAlignment(in, bamHdr, aln, idx, regions, regionNumber, &regionIndex, &itr) > 0) {
+
+        // Write a read overlapping several regions once
+        if (regions != NULL && alignmentInPreviousBamRegion(aln, regions, regionIndex)) {
+            continue;
+        }
 
         char *readName = bam_get_qname(aln);
         if (marginPhaseTag != NULL) {
@@ -71,6 +102,10 @@ void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartit
     st_logInfo("\tSAM read counts:\n\t\thap1: %d\thap2: %d\tfiltered out: %d \n", readCountH1, readCountH2, readCountFiltered);
 
     // Cleanup
+    if (idx != NULL) {
+        hts_idx_destroy(idx);
+        free(regions);
+    }
     bam_destroy1(aln);
     bam_hdr_destroy(bamHdr);
     sam_close(in);
@@ -79,9 +114,10 @@ void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartit
 }
 
 void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionTable *readHaplotypePartitions,
-                    char *marginPhaseTag) {
+                    char *marginPhaseTag, stList *regionStrings) {
     /*
-     * Write out sam files with reads in each split based on which haplotype partition they are in.
+     * Write out sam files with reads in each split based on which haplotype partition they are in. If
+     * regionStrings is not NULL only the reads overlapping the regions are written, read using the bam index.
      */
 
     // Prep
@@ -94,19 +130,27 @@ void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionT
     if (in == NULL) {
         st_errAbort("ERROR: Cannot open bam file %s\n", bamInFile);
     }
+    htslibThreadPool_attach(in);
     bam_hdr_t *bamHdr = sam_hdr_read(in);
     bam1_t *aln = bam_init1();
+    stBamRegion *regions;
+    int64_t regionNumber, regionIndex = 0;
+    hts_itr_t *itr = NULL;
+    hts_idx_t *idx = loadBamRegions(in, bamInFile, bamHdr, regionStrings, &regions, &regionNumber);
 
     int r;
     st_logDebug("\tWriting haplotype output to: %s, %s, and %s \n", haplotype1SamOutFile,
                 haplotype2SamOutFile, unmatchedSamOutFile);
     samFile *out1 = hts_open(haplotype1SamOutFile, "w");
+    htslibThreadPool_attach(out1);
     r = sam_hdr_write(out1, bamHdr);
 
     samFile *out2 = hts_open(haplotype2SamOutFile, "w");
+    htslibThreadPool_attach(out2);
     r = sam_hdr_write(out2, bamHdr);
 
     samFile *outUnmatched = hts_open(unmatchedSamOutFile, "w");
+    htslibThreadPool_attach(outUnmatched);
     r = sam_hdr_write(outUnmatched, bamHdr);
 
 
@@ -115,7 +159,12 @@ void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionT
     int32_t readCountH2 = 0;
     int32_t readCountFiltered = 0;
     char *haplotypeString;
-    while(sam_read1(in,bamHdr,aln) > 0) {
+    while(readNextAlignment(in, bamHdr, aln, idx, regions, regionNumber, &regionIndex, &itr) > 0) {
+
+        // Write a read overlapping several regions once
+        if (regions != NULL && alignmentInPreviousBamRegion(aln, regions, regionIndex)) {
+            continue;
+        }
 
         char *readName = bam_get_qname(aln);
         if (marginPhaseTag != NULL) {
@@ -148,6 +197,10 @@ void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionT
     st_logInfo("\tSAM read counts:\n\t\thap1: %d\thap2: %d\tfiltered out: %d \n", readCountH1, readCountH2, readCountFiltered);
 
     // Cleanup
+    if (idx != NULL) {
+        hts_idx_destroy(idx);
+        free(regions);
+    }
     bam_destroy1(aln);
     bam_hdr_destroy(bamHdr);
     sam_close(in);
@@ -159,6 +212,44 @@ void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionT
     free(unmatchedSamOutFile);
 }
 
+stList *orderReferenceNamesByFastaIndex(stList *referenceNames, char *referenceFastaFile) {
+    /*
+     * Returns a list of the distinct names in referenceNames, ordered as the sequences of the fasta index of
+     * referenceFastaFile, followed by any names not in the index in the order they are first given.
+     * The returned list does not own the names.
+     */
+    stList *orderedReferenceNames = stList_construct();
+    stSet *names = stSet_construct3(stHash_stringKey, stHash_stringEqualKey, NULL);
+    for(int64_t i=0; i<stList_length(referenceNames); i++) {
+        stSet_insert(names, stList_get(referenceNames, i));
+    }
+
+    // Add the names in the order of the fasta index
+    faidx_t *fai = referenceFastaFile == NULL ? NULL : fai_load(referenceFastaFile);
+    if(fai != NULL) {
+        for(int i=0; i<faidx_nseq(fai); i++) {
+            char *name = stSet_search(names, (void *)faidx_iseq(fai, i));
+            if(name != NULL) {
+                stList_append(orderedReferenceNames, name);
+                stSet_remove(names, name);
+            }
+        }
+        fai_destroy(fai);
+    }
+
+    // Add the remaining names
+    for(int64_t i=0; i<stList_length(referenceNames); i++) {
+        char *name = stList_get(referenceNames, i);
+        if(stSet_search(names, name) != NULL) {
+            stList_append(orderedReferenceNames, name);
+            stSet_remove(names, name);
+        }
+    }
+
+    stSet_destruct(names);
+    return orderedReferenceNames;
+}
+
 bcf_hdr_t* writeVcfHeader(vcfFile *out, stList *genomeFragments, char *referenceName) {
     /*
      * Write the header of a vcf file.
@@ -177,14 +268,31 @@ bcf_hdr_t* writeVcfHeader(vcfFile *out, stList *genomeFragments, char *reference
     ksprintf(&str, "##reference=file://%s\n", referenceName);
     bcf_hdr_append(hdr, str.s);
 
-    // Contigs
-    // TODO: assert unique fragments, get full chrom length
+    // Contigs, once each in the order of the reference fasta index, with their lengths if known
+    stList *contigs = stList_construct();
     for(int64_t i=0; i<stList_length(genomeFragments); i++) {
         stRPHmm *hmm = stList_get(genomeFragments, i);
+        stList_append(contigs, hmm->referenceName); //hmm->referenceName is the chrom
+    }
+    stList *orderedContigs = orderReferenceNamesByFastaIndex(contigs, referenceName);
+    faidx_t *fai = fai_load(referenceName);
+    for(int64_t i=0; i<stList_length(orderedContigs); i++) {
+        char *contig = stList_get(orderedContigs, i);
+        int contigLength = fai == NULL ? -1 : faidx_seq_len(fai, contig);
         str.l = 0;
-        ksprintf(&str, "##contig=<ID=%s>\n", hmm->referenceName); //hmm->referenceName is the chrom
+        if(contigLength >= 0) {
+            ksprintf(&str, "##contig=<ID=%s,length=%d>\n", contig, contigLength);
+        }
+        else {
+            ksprintf(&str, "##contig=<ID=%s>\n", contig);
+        }
         bcf_hdr_append(hdr, str.s);
     }
+    if(fai != NULL) {
+        fai_destroy(fai);
+    }
+    stList_destruct(orderedContigs);
+    stList_destruct(contigs);
 
     // INFO fields
     str.l = 0;
@@ -961,12 +1069,30 @@ void stReadHaplotypePartitionTable_destruct(stReadHaplotypePartitionTable *hpt)
 //  Populating HaplotypePartitionTable from GenomeFragment and HMM
 //
 
+static bool getReadIntervalInPhaseBlock(stProfileSeq *read, stGenomeFragment *gF, int64_t *readStart,
+                                        int64_t *length) {
+    /*
+     * Gets the part of the read within the reference interval of the phase block's genome fragment,
+     * [gF->refStart, gF->refStart + gF->length), as the offset of its start within the read and its length.
+     * Returns false if the read does not overlap the phase block.
+     */
+    int64_t blockStart = gF->refStart, blockEnd = gF->refStart + gF->length;
+    if(read->refStart >= blockEnd || read->refStart + read->length <= blockStart) {
+        return false;
+    }
+    *readStart = read->refStart < blockStart ? blockStart - read->refStart : 0;
+    *length = (read->refStart + read->length > blockEnd ? blockEnd - read->refStart : read->length) - *readStart;
+    return true;
+}
+
 void populateReadHaplotypePartitionTable(stReadHaplotypePartitionTable *hpt, stGenomeFragment *gF, stRPHmm *hmm,
-                                         stList *path) {
+                                         stList *path, bool invertHaplotypes) {
     //todo track all partitioned reads and quit early if examined
     // same for whole GenomeFragment
+    // gF gives the phase block, which may be a stitched genome fragment containing the hmm's genome fragment,
+    // in which case invertHaplotypes swaps the hmm's haplotypes to those of the phase block
+    // The phase block is labelled by its zero-based start
     int64_t phaseBlock = gF->refStart - 1;
-    int64_t phaseBlockEnd = phaseBlock + gF->length;
 
     // variables for partitions
     char *readName;
@@ -983,17 +1109,18 @@ void populateReadHaplotypePartitionTable(stReadHaplotypePartitionTable *hpt, stG
         for(int64_t j=0; j<column->depth; j++) {
             stProfileSeq *read = column->seqHeaders[j];
             readName = read->readId;
-            readStart = (read->refStart < phaseBlock ? phaseBlock - read->refStart : 0);
-            length = (read->refStart + read->length > phaseBlockEnd ?
-                      phaseBlockEnd - read->refStart :
-                      read->length - readStart);
-            haplotype = (int8_t) (seqInHap1(cell->partition, j) ? 1 : 2);
+
+            // Skip reads of the hmm outside the phase block, as when the phase block is clipped to a chunk
+            if(!getReadIntervalInPhaseBlock(read, gF, &readStart, &length)) {
+                continue;
+            }
+            haplotype = (int8_t) (seqInHap1(cell->partition, j) != invertHaplotypes ? 1 : 2);
 
             //todo more sanity check
-            assert(length >= 0);
+            assert(length > 0);
             assert(length <= read->length);
             assert(readStart >= 0);
-            assert(readStart <= read->length);
+            assert(readStart < read->length);
 
             // save to hpt
             stReadHaplotypePartitionTable_add(hpt, readName, readStart, phaseBlock, length, haplotype);
@@ -1006,3 +1133,96 @@ void populateReadHaplotypePartitionTable(stReadHaplotypePartitionTable *hpt, stG
     }
 
 }
+
+static int profileSeq_refStartCmpFn(const void *a, const void *b) {
+    /*
+     * Orders profile sequences by start coordinate.
+     */
+    int64_t i = ((stProfileSeq *)a)->refStart, j = ((stProfileSeq *)b)->refStart;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
+
+stHash *getReferenceNamesToSortedProfileSeqs(stList *profileSeqs, int64_t *maxLength) {
+    /*
+     * Buckets the profile sequences by reference sequence, returning a hash from each reference sequence name to
+     * the list of its profile sequences sorted by start coordinate, for populateReadHaplotypePartitionTableByScoring.
+     * The lists do not own the profile sequences. Sets maxLength to the length of the longest profile sequence.
+     */
+    stHash *referenceNamesToProfileSeqs = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL,
+                                                            (void (*)(void *))stList_destruct);
+    *maxLength = 0;
+    for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+        stProfileSeq *read = stList_get(profileSeqs, i);
+        stList *reads = stHash_search(referenceNamesToProfileSeqs, read->referenceName);
+        if(reads == NULL) {
+            reads = stList_construct();
+            stHash_insert(referenceNamesToProfileSeqs, read->referenceName, reads);
+        }
+        stList_append(reads, read);
+        if(read->length > *maxLength) {
+            *maxLength = read->length;
+        }
+    }
+
+    stHashIterator *it = stHash_getIterator(referenceNamesToProfileSeqs);
+    char *referenceName;
+    while((referenceName = stHash_getNext(it)) != NULL) {
+        stList_sort(stHash_search(referenceNamesToProfileSeqs, referenceName), profileSeq_refStartCmpFn);
+    }
+    stHash_destructIterator(it);
+
+    return referenceNamesToProfileSeqs;
+}
+
+void populateReadHaplotypePartitionTableByScoring(stReadHaplotypePartitionTable *hpt, stGenomeFragment *gF,
+                                                  stHash *referenceNamesToSortedProfileSeqs, int64_t maxLength,
+                                                  stRPHmmParameters *params) {
+    /*
+     * Adds the reads that overlap the genome fragment, but were not phased with it, such as those discarded to
+     * bound the coverage depth, assigning each to the haplotype of the genome fragment that more probably
+     * generated it (see getLogProbOfReadGivenHaplotype). The reads are given bucketed by reference sequence and
+     * sorted by start coordinate, with maxLength the length of the longest (see
+     * getReferenceNamesToSortedProfileSeqs), so only the reads that may overlap the genome fragment are visited.
+     */
+    // The phase block is labelled by its zero-based start
+    int64_t phaseBlock = gF->refStart - 1;
+
+    stList *reads = stHash_search(referenceNamesToSortedProfileSeqs, gF->referenceName);
+    if(reads == NULL) {
+        return;
+    }
+
+    // Binary search for the first read that could overlap the genome fragment
+    int64_t first = 0, last = stList_length(reads);
+    while(first < last) {
+        int64_t mid = first + (last - first) / 2;
+        stProfileSeq *read = stList_get(reads, mid);
+        if(read->refStart + maxLength <= gF->refStart) {
+            first = mid + 1;
+        }
+        else {
+            last = mid;
+        }
+    }
+
+    for(int64_t i=first; i<stList_length(reads); i++) {
+        stProfileSeq *read = stList_get(reads, i);
+        if(read->refStart >= gF->refStart + gF->length) {
+            break;
+        }
+        int64_t readStart, length;
+        if(!getReadIntervalInPhaseBlock(read, gF, &readStart, &length)) {
+            continue;
+        }
+
+        // Score the read against each haplotype
+        double hap1LogProb = getLogProbOfReadGivenHaplotype(gF->haplotypeString1, gF->refStart, gF->length,
+                                                            read, params);
+        double hap2LogProb = getLogProbOfReadGivenHaplotype(gF->haplotypeString2, gF->refStart, gF->length,
+                                                            read, params);
+        int8_t haplotype = (int8_t) (hap1LogProb >= hap2LogProb ? 1 : 2);
+
+        // save to hpt
+        stReadHaplotypePartitionTable_add(hpt, read->readId, readStart, phaseBlock, length, haplotype);
+    }
+}
@@ -4,7 +4,12 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <htslib/sam.h>
+#include <htslib/thread_pool.h>
 #include <util.h>
 #include "stRPHmm.h"
 #include "jsmn.h"
@@ -16,7 +21,7 @@ stBaseMapper* stBaseMapper_construct() {
     stBaseMapper *bm = (stBaseMapper*)st_malloc(sizeof(stBaseMapper));
     bm->charToNum = st_calloc(256, sizeof(uint8_t));
     bm->numToChar = st_calloc(ALPHABET_SIZE, sizeof(uint8_t));
-    bm->wildcard = "";
+    bm->wildcard = stString_copy("");
     bm->size = 0;
     return bm;
 }
@@ -27,9 +32,51 @@ stBaseMapper* stBaseMapper_construct() {
 void stBaseMapper_destruct(stBaseMapper *bm) {
     free(bm->charToNum);
     free(bm->numToChar);
+    free(bm->wildcard);
     free(bm);
 }
 
+/*
+ * Shared htslib thread pool, used to compress and decompress every bam and vcf file
+ */
+static htsThreadPool htslibThreadPool = { NULL, 0 };
+
+void htslibThreadPool_construct(int64_t threadNumber) {
+    /*
+     * Creates the thread pool with the given number of threads. With fewer than two threads no pool is
+     * created and files are compressed and decompressed on the calling thread, as before.
+     */
+    assert(htslibThreadPool.pool == NULL);
+    if (threadNumber < 2) {
+        return;
+    }
+    htslibThreadPool.pool = hts_tpool_init((int) threadNumber);
+    if (htslibThreadPool.pool == NULL) {
+        st_errAbort("ERROR: Could not create a pool of %" PRIi64 " threads for htslib\n", threadNumber);
+    }
+    htslibThreadPool.qsize = 0;
+}
+
+void htslibThreadPool_destruct() {
+    /*
+     * Destroys the thread pool, which must only be done once all the files it is attached to are closed.
+     */
+    if (htslibThreadPool.pool != NULL) {
+        hts_tpool_destroy(htslibThreadPool.pool);
+        htslibThreadPool.pool = NULL;
+    }
+}
+
+void htslibThreadPool_attach(htsFile *fp) {
+    /*
+     * Attaches the thread pool, if there is one, to an open htslib file. Uncompressed files, to which the pool
+     * can not be attached, are left as they are.
+     */
+    if (htslibThreadPool.pool != NULL && hts_set_thread_pool(fp, &htslibThreadPool) != 0) {
+        st_logDebug("\tCould not attach the htslib thread pool to file %s\n", fp->fn);
+    }
+}
+
 /*
  * Add bases into the baseMapper object.
  */
@@ -46,10 +93,11 @@ void stBaseMapper_addBases(stBaseMapper *bm, char *bases) {
 }
 
 /*
- * Set the baseMapper wildcard.
+ * Set the baseMapper wildcard, copying the given characters.
  */
 void stBaseMapper_setWildcard(stBaseMapper* bm, char *wildcard) {
-    bm->wildcard = wildcard;
+    free(bm->wildcard);
+    bm->wildcard = stString_copy(wildcard);
 }
 
 /*
@@ -68,6 +116,19 @@ uint8_t stBaseMapper_getValueForChar(stBaseMapper *bm, char base) {
     return UINT8_MAX;
 }
 
+/*
+ * As stBaseMapper_getValueForChar, but a wildcard base is resolved to a base chosen by hashing the seed rather
+ * than at random, so the result depends only on the arguments and can be computed in parallel.
+ */
+uint8_t stBaseMapper_getValueForCharWithSeed(stBaseMapper *bm, char base, uint64_t seed) {
+    if (base != '\0' && strchr(bm->wildcard, base) != NULL) {
+        assert(bm->size-1 < UINT8_MAX);
+        // Knuth's multiplicative hash, so that consecutive seeds give unrelated bases
+        return (uint8_t) (((seed * 2654435761u) >> 16) % (bm->size-1));
+    }
+    return stBaseMapper_getValueForChar(bm, base);
+}
+
 /*
  * Given the numeric value for a base, return the char.
  */
@@ -87,6 +148,19 @@ char *json_token_tostr(char *js, jsmntok_t *t)
     return js + t->start;
 }
 
+/*
+ * Convert the json token of a boolean parameter into a bool, aborting if it is not "true" or "false".
+ */
+static bool json_token_tobool(char *keyString, char *tokStr) {
+    if (strcmp(tokStr, "true") == 0) {
+        return true;
+    }
+    if (strcmp(tokStr, "false") != 0) {
+        st_errAbort("ERROR: Parameter %s must be true or false, got: %s\n", keyString, tokStr);
+    }
+    return false;
+}
+
 /*
  * Get model parameters from params file.
  * Set hmm parameters.
@@ -118,7 +192,17 @@ stRPHmmParameters *parseParameters(char *paramsFile, stBaseMapper *baseMapper) {
     params->minPartitionsInAColumn = 50;
     params->maxPartitionsInAColumn = 200;
     params->minPosteriorProbabilityForPartition = 0.001;
+    params->targetPosteriorMassForPartitions = 0.0;
     params->minReadCoverageToSupportPhasingBetweenHeterozygousSites = 0;
+    params->checkpointForwardBackward = false;
+    params->columnsBetweenCheckpoints = 0;
+    params->forwardBackwardSegmentNumber = 0;
+    params->maxMergeCellsAtSegmentBoundary = 16;
+    params->concurrentForwardBackward = false;
+    params->orderMergesByEstimatedCost = false;
+    params->preSplitReadsAtWeaklyLinkedSites = false;
+    params->genotypeFilteredPositionsFromPileup = false;
+    params->ensembleSubsampleNumber = 0;
 
     // Hmm training options
     params->trainingIterations = 0;
@@ -133,6 +217,7 @@ stRPHmmParameters *parseParameters(char *paramsFile, stBaseMapper *baseMapper) {
     params->filterMatchThreshold = 0.90;
     params->filterLikelyHomozygousSites = false;
     params->mapqFilter = 0;
+    params->preferHighMapqWhenDownsampling = false;
 
     // Other marginPhase program options
     params->useReferencePrior = false;
@@ -245,6 +330,15 @@ stRPHmmParameters *parseParameters(char *paramsFile, stBaseMapper *baseMapper) {
             params->minPosteriorProbabilityForPartition = atof(tokStr);
             i++;
         }
+        else if (strcmp(keyString, "targetPosteriorMassForPartitions") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->targetPosteriorMassForPartitions = atof(tokStr);
+            if (params->targetPosteriorMassForPartitions > 1.0) {
+                st_errAbort("ERROR: targetPosteriorMassForPartitions must be at most 1, got %s\n", tokStr);
+            }
+            i++;
+        }
         else if (strcmp(keyString, "maxCoverageDepth") == 0) {
             jsmntok_t tok = tokens[i+1];
             char *tokStr = json_token_tostr(js, &tok);
@@ -386,6 +480,78 @@ stRPHmmParameters *parseParameters(char *paramsFile, stBaseMapper *baseMapper) {
             params->mapqFilter = atoi(tokStr);
             i++;
         }
+        else if (strcmp(keyString, "preferHighMapqWhenDownsampling") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->preferHighMapqWhenDownsampling = json_token_tobool(keyString, tokStr);
+            i++;
+        }
+        else if (strcmp(keyString, "checkpointForwardBackward") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->checkpointForwardBackward = json_token_tobool(keyString, tokStr);
+            i++;
+        }
+        else if (strcmp(keyString, "columnsBetweenCheckpoints") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->columnsBetweenCheckpoints = atoi(tokStr);
+            if (params->columnsBetweenCheckpoints < 0) {
+                st_errAbort("ERROR: columnsBetweenCheckpoints must be non-negative, got %s\n", tokStr);
+            }
+            i++;
+        }
+        else if (strcmp(keyString, "forwardBackwardSegmentNumber") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->forwardBackwardSegmentNumber = atoi(tokStr);
+            if (params->forwardBackwardSegmentNumber < 0) {
+                st_errAbort("ERROR: forwardBackwardSegmentNumber must be non-negative, got %s\n", tokStr);
+            }
+            i++;
+        }
+        else if (strcmp(keyString, "maxMergeCellsAtSegmentBoundary") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->maxMergeCellsAtSegmentBoundary = atoi(tokStr);
+            if (params->maxMergeCellsAtSegmentBoundary < 1) {
+                st_errAbort("ERROR: maxMergeCellsAtSegmentBoundary must be positive, got %s\n", tokStr);
+            }
+            i++;
+        }
+        else if (strcmp(keyString, "concurrentForwardBackward") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->concurrentForwardBackward = json_token_tobool(keyString, tokStr);
+            i++;
+        }
+        else if (strcmp(keyString, "genotypeFilteredPositionsFromPileup") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->genotypeFilteredPositionsFromPileup = json_token_tobool(keyString, tokStr);
+            i++;
+        }
+        else if (strcmp(keyString, "ensembleSubsampleNumber") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->ensembleSubsampleNumber = atoi(tokStr);
+            if (params->ensembleSubsampleNumber < 0) {
+                st_errAbort("ERROR: ensembleSubsampleNumber must be non-negative, got %s\n", tokStr);
+            }
+            i++;
+        }
+        else if (strcmp(keyString, "orderMergesByEstimatedCost") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->orderMergesByEstimatedCost = json_token_tobool(keyString, tokStr);
+            i++;
+        }
+        else if (strcmp(keyString, "preSplitReadsAtWeaklyLinkedSites") == 0) {
+            jsmntok_t tok = tokens[i+1];
+            char *tokStr = json_token_tostr(js, &tok);
+            params->preSplitReadsAtWeaklyLinkedSites = json_token_tobool(keyString, tokStr);
+            i++;
+        }
         else {
             st_errAbort("ERROR: Unrecognised key in params file: %s\n", keyString);
         }
@@ -417,171 +583,248 @@ void countIndels(uint32_t *cigar, uint32_t ncigar, int64_t *numInsertions, int64
     }
 }
 
-void appendProbsToList(stList *probabilityList, uint8_t pA, uint8_t pC, uint8_t pG, uint8_t pT, uint8_t pGap) {
-    uint8_t *aPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *cPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *gPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *tPtr = calloc(1, sizeof(uint8_t));
-    uint8_t *gapPtr = calloc(1, sizeof(uint8_t));
-    *aPtr = pA;
-    *cPtr = pC;
-    *gPtr = pG;
-    *tPtr = pT;
-    *gapPtr = pGap;
-    stList_append(probabilityList, aPtr);
-    stList_append(probabilityList, cPtr);
-    stList_append(probabilityList, gPtr);
-    stList_append(probabilityList, tPtr);
-    stList_append(probabilityList, gapPtr);
+static char *readFileContents(char *fileName) {
+    /*
+     * Reads the whole of a file into a null terminated string.
+     */
+    FILE *fp = fopen(fileName, "r");
+    if (fp == NULL) {
+        st_errAbort("Could not open single nucleotide probability file %s\n", fileName);
+    }
+    fseek(fp, 0, SEEK_END);
+    int64_t length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *contents = st_malloc(sizeof(char) * (length + 1));
+    if (fread(contents, sizeof(char), length, fp) != (size_t)length) {
+        st_errAbort("Could not read single nucleotide probability file %s\n", fileName);
+    }
+    contents[length] = '\0';
+    fclose(fp);
+    return contents;
 }
 
-stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLocation, char *readName,
-                                                       stBaseMapper *baseMapper, stRPHmmParameters *params) {
-    // get signalAlign file
-    FILE *fp = fopen(signalAlignReadLocation,"r");
-
-    // for scanning the file
-    int fieldSize = 2048;
-    char *line = calloc(2048, sizeof(char));
-    char *chromStr = calloc(fieldSize, sizeof(char));
-    char *refPosStr = calloc(fieldSize, sizeof(char));
-    char *pAStr = calloc(fieldSize, sizeof(char));
-    char *pCStr = calloc(fieldSize, sizeof(char));
-    char *pGStr = calloc(fieldSize, sizeof(char));
-    char *pTStr = calloc(fieldSize, sizeof(char));
-    char *pGapStr = calloc(fieldSize, sizeof(char));
-
-    // for handling the data
-    int64_t refPos;
-    uint8_t pA;
-    uint8_t pC;
-    uint8_t pG;
-    uint8_t pT;
-    uint8_t pGap;
-    uint8_t *aPtr;
-    uint8_t *cPtr;
-    uint8_t *gPtr;
-    uint8_t *tPtr;
-    uint8_t *gapPtr;
-
-    // parse header
-    while(!feof(fp)) {
-        fscanf( fp, "%[^\n]\n", line);
-        if (line[0] == '#') {
-            if (line[1] == '#') continue;
-            if (strcmp(line, "#CHROM\tPOS\tpA\tpC\tpG\tpT\tp_") != 0) {
-                st_errAbort("SignalAlign output file %s has unexpected header format: %s",
-                            signalAlignReadLocation, line);
-            } else {
-                break;
-            }
-        }
-    }
+static char *getNextLine(char *c) {
+    /*
+     * Gets the start of the line after the one containing c, or the end of the string.
+     */
+    while (*c != '\n' && *c != '\0') c++;
+    return *c == '\n' ? c + 1 : c;
+}
 
-    // get probabilities
-    stList* probabilityList = stList_construct3(0, free);
-    uint64_t firstReadPos = 0;
-    uint64_t lastReadPos = 0;
-    int64_t randomSeed = st_randomInt64(0,3);
-    while(!feof(fp)) {
-        // Scan
-        fscanf( fp, "%[^\t]\t%[^\t]\t%[^\t]\t%[^\t]\t%[^\t]\t%[^\t]\t%[^\n]\n",
-                chromStr, refPosStr, pAStr, pCStr, pGStr, pTStr, pGapStr);
+static int64_t parseSingleNuclProbInt(char **c, char *fileName, int64_t lineNumber) {
+    /*
+     * Parses a non-negative integer field ending in a tab, leaving c after the tab.
+     */
+    char *start = *c;
+    int64_t value = 0;
+    while (**c >= '0' && **c <= '9') {
+        value = value * 10 + (**c - '0');
+        (*c)++;
+    }
+    if (*c == start || **c != '\t') {
+        st_errAbort("Could not parse position on line %" PRIi64 " of single nucleotide probability file %s\n",
+                    lineNumber, fileName);
+    }
+    (*c)++;
+    return value;
+}
 
-        // Get reference position
-        refPos = atoi(refPosStr);
+static double parseSingleNuclProb(char **c, char *fileName, int64_t lineNumber) {
+    /*
+     * Parses a decimal field, with optional exponent, ending in a tab or the end of the line, leaving c after a
+     * tab or at the end of the line.
+     */
+    char *start = *c;
+    double value = 0.0, scale = 1.0;
+    bool negative = **c == '-';
+    if (**c == '-' || **c == '+') (*c)++;
+    while (**c >= '0' && **c <= '9') {
+        value = value * 10.0 + (**c - '0');
+        (*c)++;
+    }
+    if (**c == '.') {
+        (*c)++;
+        while (**c >= '0' && **c <= '9') {
+            scale /= 10.0;
+            value += scale * (**c - '0');
+            (*c)++;
+        }
+    }
+    if (**c == 'e' || **c == 'E') {
+        (*c)++;
+        bool negativeExponent = **c == '-';
+        if (**c == '-' || **c == '+') (*c)++;
+        int64_t exponent = 0;
+        while (**c >= '0' && **c <= '9') {
+            exponent = exponent * 10 + (**c - '0');
+            (*c)++;
+        }
+        value *= pow(10.0, negativeExponent ? -exponent : exponent);
+    }
+    if (*c == start || (**c != '\t' && **c != '\n' && **c != '\r' && **c != '\0')) {
+        st_errAbort("Could not parse probability on line %" PRIi64 " of single nucleotide probability file %s\n",
+                    lineNumber, fileName);
+    }
+    if (**c == '\t') (*c)++;
+    return negative ? -value : value;
+}
 
-        // Check for gaps todo this might actually be a bug or something in signalAlign
-        while (firstReadPos != 0 && refPos > lastReadPos + 1) {
-            appendProbsToList(probabilityList, ALPHABET_MIN_PROB, ALPHABET_MIN_PROB, ALPHABET_MIN_PROB,
-                              ALPHABET_MIN_PROB, ALPHABET_MAX_PROB);
-            lastReadPos++;
+static void normaliseSingleNuclProbs(uint8_t *probs, int64_t *randomSeed) {
+    /*
+     * Adjusts the nonzero integer probabilities of the five characters (A, C, G, T, gap) so they sum
+     * to ALPHABET_MAX_PROB, spreading the rounding error over the characters.
+     */
+    int64_t total = probs[0] + probs[1] + probs[2] + probs[3] + probs[4];
+    while (total > ALPHABET_MAX_PROB) {
+        int64_t i = (*randomSeed)++ % 5;
+        if (probs[i] != 0) {
+            probs[i]--;
+            total--;
+        }
+    }
+    while (total > 0 && total < ALPHABET_MAX_PROB) {
+        int64_t i = (*randomSeed)++ % 5;
+        if (probs[i] != 0) {
+            probs[i]++;
+            total++;
         }
+    }
+}
 
-        // Check for inserts
-        if (firstReadPos != 0 && refPos < lastReadPos + 1) continue;
+static void getSingleNuclProbCharIndices(stBaseMapper *baseMapper, int64_t *charIndices) {
+    /*
+     * Gets the indices in a profile of the characters A, C, G and T of single nucleotide probabilities.
+     */
+    charIndices[0] = stBaseMapper_getValueForChar(baseMapper, 'A');
+    charIndices[1] = stBaseMapper_getValueForChar(baseMapper, 'C');
+    charIndices[2] = stBaseMapper_getValueForChar(baseMapper, 'G');
+    charIndices[3] = stBaseMapper_getValueForChar(baseMapper, 'T');
+}
 
-        // Update first and last read position
-        if (firstReadPos == 0) firstReadPos = refPos;
-        lastReadPos = refPos;
+static void setProfileProbsFromSingleNuclProbs(uint8_t *profileProbs, uint8_t *probs, int64_t *charIndices,
+                                               bool gapCharactersForDeletions) {
+    /*
+     * Sets the profile probabilities of a position from the probabilities of A, C, G, T and gap.
+     */
+    for (int64_t j = 0; j < ALPHABET_SIZE - 1; j++) {
+        profileProbs[charIndices[j]] = probs[j];
+    }
+    // This assumes gap character is the last character in the alphabet given
+    profileProbs[ALPHABET_SIZE - 1] = gapCharactersForDeletions ? probs[ALPHABET_SIZE - 1] : ALPHABET_MIN_PROB;
+}
 
-        // Get probabilities and save
-        pA = (uint8_t) (ALPHABET_MAX_PROB * atof(pAStr));
-        pC = (uint8_t) (ALPHABET_MAX_PROB * atof(pCStr));
-        pG = (uint8_t) (ALPHABET_MAX_PROB * atof(pGStr));
-        pT = (uint8_t) (ALPHABET_MAX_PROB * atof(pTStr));
-        pGap = (uint8_t) (ALPHABET_MAX_PROB * atof(pGapStr));
+static char *parseSingleNuclProbReferenceAndPosition(char *c, char *signalAlignReadLocation, int64_t lineNumber,
+                                                     char **chromStr, int64_t *chromLength, int64_t *refPos) {
+    /*
+     * Parses the reference name and position fields of a line of a single nucleotide probability file, returning
+     * the start of the probability fields.
+     */
+    *chromStr = c;
+    while (*c != '\t' && *c != '\n' && *c != '\0') c++;
+    if (*c != '\t') {
+        st_errAbort("Could not parse line %" PRIi64 " of single nucleotide probability file %s\n",
+                    lineNumber, signalAlignReadLocation);
+    }
+    *chromLength = c - *chromStr;
+    c++;
+    *refPos = parseSingleNuclProbInt(&c, signalAlignReadLocation, lineNumber);
+    return c;
+}
 
-        // We need all integer probs to sum to MAX_PROB todo is there a way to do this better?
-        while ((pA + pC + pG + pT + pGap) > ALPHABET_MAX_PROB) {
-            if ((pA + pC + pG + pT + pGap) == 0) {
-                break;
-            }
-            switch (randomSeed++ % 5) {
-                case 0: if (pA != 0) pA--; break;
-                case 1: if (pC != 0) pC--; break;
-                case 2: if (pG != 0) pG--; break;
-                case 3: if (pT != 0) pT--; break;
-                case 4: if (pGap != 0) pGap--; break;
-                default: assert(FALSE);
-            }
+static stProfileSeq *parseSingleNuclProbFile(char *signalAlignReadLocation, char *readName, int64_t *charIndices,
+                                             bool gapCharactersForDeletions) {
+    /*
+     * Parses a single nucleotide probability file, a tsv with a header line "#CHROM\tPOS\tpA\tpC\tpG\tpT\tp_" and a
+     * line per reference position of the read, into a profile sequence. Reference positions missing from the file
+     * are treated as deletions, and repeated positions (insertions) are ignored.
+     *
+     * The probabilities of A, C, G, T and gap at each position are normalised to sum to ALPHABET_MAX_PROB and
+     * stored at the given indices of A, C, G and T in the profile, and at the gap character if
+     * gapCharactersForDeletions is true.
+     *
+     * The file is read in one go and parsed in place, first to find the extent of the profile sequence and then to
+     * fill it in. The rounding of probabilities is seeded from the read name rather than the shared random number
+     * generator, so files can be loaded by several threads at once.
+     */
+    char *contents = readFileContents(signalAlignReadLocation);
+    char *c = contents;
+    int64_t lineNumber = 1;
+
+    // Parse header
+    char *header = "#CHROM\tPOS\tpA\tpC\tpG\tpT\tp_";
+    int64_t headerLength = strlen(header);
+    while (true) {
+        if (*c == '\0') {
+            st_errAbort("SignalAlign output file %s has no header\n", signalAlignReadLocation);
         }
-        while ((pA + pC + pG + pT + pGap) < ALPHABET_MAX_PROB) {
-            if ((pA + pC + pG + pT + pGap) == 0) {
-                break;
-            }
-            switch (randomSeed++ % 5) {
-                case 0: if (pA != 0) pA++; break;
-                case 1: if (pC != 0) pC++; break;
-                case 2: if (pG != 0) pG++; break;
-                case 3: if (pT != 0) pT++; break;
-                case 4: if (pGap != 0) pGap++; break;
-                default: assert(FALSE);
+        char *line = c;
+        c = getNextLine(c);
+        lineNumber++;
+        if (line[0] == '#' && line[1] != '#') {
+            if (strncmp(line, header, headerLength) != 0 ||
+                (line[headerLength] != '\n' && line[headerLength] != '\r' && line[headerLength] != '\0')) {
+                st_errAbort("SignalAlign output file %s has unexpected header format: %.*s",
+                            signalAlignReadLocation, (int)(c - line), line);
             }
+            break;
         }
-
-        // Save the values in a list todo this is not particularly efficient
-        appendProbsToList(probabilityList, pA, pC, pG, pT, pGap);
     }
-    // Now we're done with the file
-    fclose(fp);
-
-    // Create empty profile sequence
-    uint64_t readLength = lastReadPos - firstReadPos + 1;
-    stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile(chromStr, readName, firstReadPos + 1, readLength);
-
-    // Copy probabilities over
-    uint64_t position = 0;
-    stListIterator *itor = stList_getIterator(probabilityList);
-    while (position < readLength) {
-
-        // Get the locations of the probabilities
-        aPtr = stList_getNext(itor);
-        cPtr = stList_getNext(itor);
-        gPtr = stList_getNext(itor);
-        tPtr = stList_getNext(itor);
-        gapPtr = stList_getNext(itor);
-
-        // Assign the probabilities
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'A')] =  *aPtr;
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'C')] =  *cPtr;
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'G')] =  *gPtr;
-        pSeq->profileProbs[position * ALPHABET_SIZE + stBaseMapper_getValueForChar(baseMapper, 'T')] =  *tPtr;
-
-        if (params->gapCharactersForDeletions) {
-            // This assumes gap character is the last character in the alphabet given
-            pSeq->profileProbs[position * ALPHABET_SIZE + (ALPHABET_SIZE - 1)] = *gapPtr;
-        } else {
-            pSeq->profileProbs[position * ALPHABET_SIZE + (ALPHABET_SIZE - 1)] = ALPHABET_MIN_PROB;
+    char *firstLine = c;
+    int64_t firstLineNumber = lineNumber;
+
+    // Find the reference name, from the last line, and the reference interval of the positions
+    char *chromStr = NULL;
+    int64_t chromLength = 0;
+    int64_t firstReadPos = -1, lastReadPos = -1, refPos;
+    for (; *c != '\0'; c = getNextLine(c), lineNumber++) {
+        // Skip blank lines
+        if (*c == '\n' || *c == '\r') continue;
+
+        parseSingleNuclProbReferenceAndPosition(c, signalAlignReadLocation, lineNumber, &chromStr, &chromLength,
+                                                &refPos);
+        if (firstReadPos == -1) firstReadPos = refPos;
+        if (refPos > lastReadPos) lastReadPos = refPos;
+    }
+    if (firstReadPos == -1) {
+        st_errAbort("SignalAlign output file %s has no probabilities\n", signalAlignReadLocation);
+    }
+    char *referenceName = stString_getSubString(chromStr, 0, chromLength);
+    stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile(referenceName, readName, firstReadPos + 1,
+                                                            lastReadPos - firstReadPos + 1);
+    free(referenceName);
+
+    // Get probabilities
+    int64_t readLength = 0;
+    int64_t randomSeed = stHash_stringKey(readName) % 3;
+    uint8_t deletionProbs[ALPHABET_SIZE] = { ALPHABET_MIN_PROB };
+    deletionProbs[ALPHABET_SIZE - 1] = ALPHABET_MAX_PROB;
+    for (c = firstLine, lineNumber = firstLineNumber; *c != '\0'; c = getNextLine(c), lineNumber++) {
+        // Skip blank lines
+        if (*c == '\n' || *c == '\r') continue;
+
+        c = parseSingleNuclProbReferenceAndPosition(c, signalAlignReadLocation, lineNumber, &chromStr, &chromLength,
+                                                    &refPos);
+
+        // Skip inserts
+        if (refPos < firstReadPos + readLength) continue;
+
+        // Missing positions are deletions todo this might actually be a bug or something in signalAlign
+        for (; firstReadPos + readLength < refPos; readLength++) {
+            setProfileProbsFromSingleNuclProbs(&pSeq->profileProbs[readLength * ALPHABET_SIZE], deletionProbs,
+                                               charIndices, gapCharactersForDeletions);
         }
 
-        position++;
-    }
-    // We should have nothing left over in the list
-    if (stList_getNext(itor) != NULL) {
-        st_errAbort("Probability list has %d extra elements, with read length %d for file %s",
-                    stList_length(probabilityList) - 5 * position, readLength, signalAlignReadLocation);
+        // Get probabilities, ensuring the integer probabilities sum to ALPHABET_MAX_PROB
+        uint8_t p[ALPHABET_SIZE];
+        for (int64_t i = 0; i < ALPHABET_SIZE; i++) {
+            p[i] = (uint8_t) (ALPHABET_MAX_PROB * parseSingleNuclProb(&c, signalAlignReadLocation, lineNumber));
+        }
+        normaliseSingleNuclProbs(p, &randomSeed);
+        setProfileProbsFromSingleNuclProbs(&pSeq->profileProbs[readLength++ * ALPHABET_SIZE], p, charIndices,
+                                           gapCharactersForDeletions);
     }
+    assert(readLength == pSeq->length);
+
     // Sanity check on the number of modifications to the probabilities
     // We only modify probability of bases with some probability, so to fix a rounding error, we should at worst have
     //  to make 4 modifications per location
@@ -590,19 +833,418 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
                     (1.0 * randomSeed / readLength), readName);
     }
 
-    stList_destruct(probabilityList);
-    free(line);
-    free(chromStr);
-    free(refPosStr);
-    free(pAStr);
-    free(pCStr);
-    free(pGStr);
-    free(pTStr);
+    free(contents);
+    return pSeq;
+}
 
+static stProfileSeq *getProfileSequenceFromSingleNuclProbs(char *referenceName, char *readName, int64_t refStart,
+                                                           int64_t length, uint8_t *probs, stBaseMapper *baseMapper,
+                                                           stRPHmmParameters *params) {
+    /*
+     * Creates a profile sequence from probabilities of A, C, G, T and gap at each position, as stored in a single
+     * nucleotide probability container.
+     */
+    int64_t charIndices[ALPHABET_SIZE - 1];
+    getSingleNuclProbCharIndices(baseMapper, charIndices);
+
+    stProfileSeq *pSeq = stProfileSeq_constructEmptyProfile(referenceName, readName, refStart, length);
+    for (int64_t i = 0; i < length; i++) {
+        setProfileProbsFromSingleNuclProbs(&pSeq->profileProbs[i * ALPHABET_SIZE], &probs[i * ALPHABET_SIZE],
+                                           charIndices, params->gapCharactersForDeletions);
+    }
     return pSeq;
 }
 
+stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLocation, char *readName,
+                                                       stBaseMapper *baseMapper, stRPHmmParameters *params) {
+    /*
+     * Creates a profile sequence from a single nucleotide probability file (see parseSingleNuclProbFile).
+     */
+    int64_t charIndices[ALPHABET_SIZE - 1];
+    getSingleNuclProbCharIndices(baseMapper, charIndices);
+    return parseSingleNuclProbFile(signalAlignReadLocation, readName, charIndices,
+                                   params->gapCharactersForDeletions);
+}
+
+/*
+ * Single nucleotide probability container
+ *
+ * Holds the single nucleotide probability files of a directory in one binary file, in the byte order of the host:
+ *     header:  magic number SINGLE_NUCL_PROB_CONTAINER_MAGIC (8 bytes), number of reads (int64)
+ *     index:   for each read, sorted by read id, the offsets of its read id and of its record (int64 each)
+ *     records: for each read, the start and length of its profile sequence (int64 each), its null terminated
+ *              reference name and then its normalised probabilities of A, C, G, T and gap at each position
+ *     read ids: null terminated
+ */
+
+#define SINGLE_NUCL_PROB_CONTAINER_MAGIC "MPSNPC1\n"
+
+struct _stSingleNuclProbContainer {
+    char *containerFile;
+    char *data;
+    int64_t size;
+    int64_t readNumber;
+};
+
+typedef struct _singleNuclProbContainerEntry {
+    char *readId;
+    int64_t readIdOffset;
+    int64_t recordOffset;
+} singleNuclProbContainerEntry;
+
+static int singleNuclProbContainerEntry_cmpFn(const void *a, const void *b) {
+    return strcmp(((singleNuclProbContainerEntry *)a)->readId, ((singleNuclProbContainerEntry *)b)->readId);
+}
+
+static void writeBytes(FILE *fp, const void *data, int64_t length, char *containerFile) {
+    if (fwrite(data, sizeof(char), length, fp) != length) {
+        st_errAbort("Could not write to single nucleotide probability container %s\n", containerFile);
+    }
+}
+
+static void writeInt64(FILE *fp, int64_t i, char *containerFile) {
+    writeBytes(fp, &i, sizeof(int64_t), containerFile);
+}
+
+static void seekContainer(FILE *fp, int64_t offset, char *containerFile) {
+    if (fseek(fp, offset, SEEK_SET) != 0) {
+        st_errAbort("Could not seek in single nucleotide probability container %s\n", containerFile);
+    }
+}
+
+int64_t writeSingleNuclProbContainer(char *singleNuclProbDirectory, char *containerFile) {
+    /*
+     * Packs the single nucleotide probability files (${readId}.tsv) in the given directory into a container file,
+     * returning the number of reads written.
+     */
+
+    // Get the read ids of the files
+    DIR *dir = opendir(singleNuclProbDirectory);
+    if (dir == NULL) {
+        st_errAbort("Could not open single nucleotide probability directory %s\n", singleNuclProbDirectory);
+    }
+    stList *readIds = stList_construct3(0, free);
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        int64_t nameLength = strlen(entry->d_name);
+        if (nameLength > 4 && strcmp(&entry->d_name[nameLength - 4], ".tsv") == 0) {
+            stList_append(readIds, stString_getSubString(entry->d_name, 0, nameLength - 4));
+        }
+    }
+    closedir(dir);
+    int64_t readNumber = stList_length(readIds);
+
+    FILE *fp = fopen(containerFile, "wb");
+    if (fp == NULL) {
+        st_errAbort("Could not open single nucleotide probability container %s for writing\n", containerFile);
+    }
+
+    // Write the header, leaving space for the index, which is written last
+    writeBytes(fp, SINGLE_NUCL_PROB_CONTAINER_MAGIC, 8, containerFile);
+    writeInt64(fp, readNumber, containerFile);
+    int64_t offset = 2 * sizeof(int64_t) + 2 * sizeof(int64_t) * readNumber;
+    seekContainer(fp, offset, containerFile);
+
+    // Write the records, with the probabilities of A, C, G, T and gap in that order
+    int64_t charIndices[ALPHABET_SIZE - 1] = { 0, 1, 2, 3 };
+    singleNuclProbContainerEntry *entries = st_malloc(sizeof(singleNuclProbContainerEntry) * (readNumber + 1));
+    for (int64_t i = 0; i < readNumber; i++) {
+        char *readId = stList_get(readIds, i);
+        char *singleNuclProbReadLocation = stString_print("%s/%s.tsv", singleNuclProbDirectory, readId);
+        stProfileSeq *pSeq = parseSingleNuclProbFile(singleNuclProbReadLocation, readId, charIndices, true);
+        entries[i].readId = readId;
+        entries[i].recordOffset = offset;
+        writeInt64(fp, pSeq->refStart, containerFile);
+        writeInt64(fp, pSeq->length, containerFile);
+        writeBytes(fp, pSeq->referenceName, strlen(pSeq->referenceName) + 1, containerFile);
+        writeBytes(fp, pSeq->profileProbs, pSeq->length * ALPHABET_SIZE, containerFile);
+        offset += 2 * sizeof(int64_t) + strlen(pSeq->referenceName) + 1 + pSeq->length * ALPHABET_SIZE;
+        stProfileSeq_destruct(pSeq);
+        free(singleNuclProbReadLocation);
+    }
+
+    // Write the read ids
+    for (int64_t i = 0; i < readNumber; i++) {
+        entries[i].readIdOffset = offset;
+        writeBytes(fp, entries[i].readId, strlen(entries[i].readId) + 1, containerFile);
+        offset += strlen(entries[i].readId) + 1;
+    }
+
+    // Write the index, sorted by read id
+    qsort(entries, readNumber, sizeof(singleNuclProbContainerEntry), singleNuclProbContainerEntry_cmpFn);
+    seekContainer(fp, 2 * sizeof(int64_t), containerFile);
+    for (int64_t i = 0; i < readNumber; i++) {
+        writeInt64(fp, entries[i].readIdOffset, containerFile);
+        writeInt64(fp, entries[i].recordOffset, containerFile);
+    }
+    if (fclose(fp) != 0) {
+        st_errAbort("Could not write single nucleotide probability container %s\n", containerFile);
+    }
+
+    free(entries);
+    stList_destruct(readIds);
+    return readNumber;
+}
+
+static int64_t readInt64(char *data, int64_t offset) {
+    int64_t i;
+    memcpy(&i, &data[offset], sizeof(int64_t));
+    return i;
+}
+
+stSingleNuclProbContainer *stSingleNuclProbContainer_open(char *containerFile) {
+    /*
+     * Memory maps a single nucleotide probability container, checking its index points within it.
+     */
+    int fd = open(containerFile, O_RDONLY);
+    if (fd == -1) {
+        st_errAbort("Could not open single nucleotide probability container %s\n", containerFile);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        st_errAbort("Could not open single nucleotide probability container %s\n", containerFile);
+    }
+
+    stSingleNuclProbContainer *container = st_malloc(sizeof(stSingleNuclProbContainer));
+    container->containerFile = stString_copy(containerFile);
+    container->size = fileStat.st_size;
+    if (container->size < 8 + sizeof(int64_t)) {
+        st_errAbort("%s is not a single nucleotide probability container\n", containerFile);
+    }
+    container->data = mmap(NULL, container->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (container->data == MAP_FAILED) {
+        st_errAbort("Could not memory map single nucleotide probability container %s\n", containerFile);
+    }
+    if (memcmp(container->data, SINGLE_NUCL_PROB_CONTAINER_MAGIC, 8) != 0) {
+        st_errAbort("%s is not a single nucleotide probability container\n", containerFile);
+    }
+    container->readNumber = readInt64(container->data, 8);
+    int64_t entrySize = 2 * sizeof(int64_t);
+    if (container->readNumber < 0 || container->readNumber > container->size / entrySize - 1) {
+        st_errAbort("Single nucleotide probability container %s is truncated\n", containerFile);
+    }
+
+    // Check each read id is null terminated within the container, and each record starts within it, after the
+    // index and with room for its start and length
+    int64_t indexEnd = entrySize * (container->readNumber + 1);
+    for (int64_t i = 0; i < container->readNumber; i++) {
+        int64_t readIdOffset = readInt64(container->data, entrySize * (i + 1));
+        int64_t recordOffset = readInt64(container->data, entrySize * (i + 1) + sizeof(int64_t));
+        if (readIdOffset < indexEnd || readIdOffset >= container->size ||
+            memchr(&container->data[readIdOffset], '\0', container->size - readIdOffset) == NULL ||
+            recordOffset < indexEnd || recordOffset >= container->size - entrySize) {
+            st_errAbort("Single nucleotide probability container %s has a corrupt index\n", containerFile);
+        }
+    }
+    return container;
+}
+
+void stSingleNuclProbContainer_close(stSingleNuclProbContainer *container) {
+    munmap(container->data, container->size);
+    free(container->containerFile);
+    free(container);
+}
+
+int64_t stSingleNuclProbContainer_getReadNumber(stSingleNuclProbContainer *container) {
+    return container->readNumber;
+}
+
+bool isSingleNuclProbContainer(char *fileName) {
+    /*
+     * Returns true if the file is a single nucleotide probability container, rather than a directory of single
+     * nucleotide probability files.
+     */
+    struct stat fileStat;
+    return stat(fileName, &fileStat) == 0 && S_ISREG(fileStat.st_mode);
+}
+
+stProfileSeq *stSingleNuclProbContainer_getProfileSeq(stSingleNuclProbContainer *container, char *readId,
+                                                      stBaseMapper *baseMapper, stRPHmmParameters *params) {
+    /*
+     * Gets a profile sequence for the given read from the container, by binary search of its index, or NULL if the
+     * read is not in the container. This only reads the container, so can be called by several threads at once.
+     */
+    int64_t min = 0, max = container->readNumber - 1;
+    while (min <= max) {
+        int64_t mid = (min + max) / 2;
+        int64_t indexOffset = 2 * sizeof(int64_t) + 2 * sizeof(int64_t) * mid;
+        int i = strcmp(readId, &container->data[readInt64(container->data, indexOffset)]);
+        if (i < 0) {
+            max = mid - 1;
+        } else if (i > 0) {
+            min = mid + 1;
+        } else {
+            int64_t recordOffset = readInt64(container->data, indexOffset + sizeof(int64_t));
+            int64_t refStart = readInt64(container->data, recordOffset);
+            int64_t length = readInt64(container->data, recordOffset + sizeof(int64_t));
+            int64_t referenceNameOffset = recordOffset + 2 * sizeof(int64_t);
+
+            // Check the reference name and probabilities of the record are within the container
+            char *referenceName = &container->data[referenceNameOffset];
+            char *referenceNameEnd = memchr(referenceName, '\0', container->size - referenceNameOffset);
+            int64_t probsOffset = referenceNameEnd == NULL ? container->size : referenceNameEnd + 1 - container->data;
+            if (length <= 0 || length > (container->size - probsOffset) / ALPHABET_SIZE) {
+                st_errAbort("Single nucleotide probability container %s has a corrupt record for read %s\n",
+                            container->containerFile, readId);
+            }
+            uint8_t *probs = (uint8_t *) &container->data[probsOffset];
+            return getProfileSequenceFromSingleNuclProbs(referenceName, readId, refStart, length, probs,
+                                                         baseMapper, params);
+        }
+    }
+    return NULL;
+}
+
+
+
+/*
+ * Region parsing
+ */
+
+stList *parseRegionsFromBed(char *bedFile) {
+    /*
+     * Returns the intervals of a bed file as a list of region strings in the chr:start-end form accepted by
+     * parseReadsInRegions.
+     */
+    FILE *fp = fopen(bedFile, "r");
+    if (fp == NULL) {
+        st_errAbort("ERROR: Cannot open bed file %s\n", bedFile);
+    }
+    stList *regions = stList_construct3(0, free);
+    char *line;
+    while ((line = stFile_getLineFromFile(fp)) != NULL) {
+        // Skip blank, comment and header lines
+        if (line[0] == '\0' || line[0] == '#' || strncmp(line, "track", 5) == 0 || strncmp(line, "browser", 7) == 0) {
+            free(line);
+            continue;
+        }
+        stList *tokens = stString_splitByString(line, "\t");
+        int64_t start, end;
+        if (stList_length(tokens) < 3 || sscanf(stList_get(tokens, 1), "%" SCNi64, &start) != 1 ||
+            sscanf(stList_get(tokens, 2), "%" SCNi64, &end) != 1 || start < 0 || end <= start) {
+            st_errAbort("ERROR: Malformed line in bed file %s: %s\n", bedFile, line);
+        }
+        // Bed intervals are zero-based and half-open, regions are one-based and closed
+        stList_append(regions, stString_print("%s:%" PRIi64 "-%" PRIi64, (char *)stList_get(tokens, 0), start + 1, end));
+        stList_destruct(tokens);
+        free(line);
+    }
+    fclose(fp);
+    return regions;
+}
 
+static int stBamRegion_cmpFn(const void *a, const void *b) {
+    const stBamRegion *r1 = a, *r2 = b;
+    if (r1->tid != r2->tid) {
+        return r1->tid < r2->tid ? -1 : 1;
+    }
+    return r1->start < r2->start ? -1 : (r1->start > r2->start ? 1 : 0);
+}
+
+stBamRegion *getBamRegions(stList *regionStrings, bam_hdr_t *bamHdr, int64_t *regionNumber) {
+    /*
+     * Parses the region strings against the bam header, returning the regions sorted and with overlapping
+     * regions merged, so that no part of a read is read for more than one region.
+     */
+    stBamRegion *regions = st_malloc(sizeof(stBamRegion) * stList_length(regionStrings));
+    for (int64_t i = 0; i < stList_length(regionStrings); i++) {
+        char *regionString = stList_get(regionStrings, i);
+        int beg, end;
+        const char *nameEnd = hts_parse_reg(regionString, &beg, &end);
+        if (nameEnd == NULL) {
+            st_errAbort("ERROR: Could not parse region %s\n", regionString);
+        }
+        char *name = stString_getSubString(regionString, 0, nameEnd - regionString);
+        regions[i].tid = bam_name2id(bamHdr, name);
+        if (regions[i].tid < 0) {
+            st_errAbort("ERROR: Region %s is on a contig not in the bam header\n", regionString);
+        }
+        free(name);
+        regions[i].start = beg;
+        regions[i].end = end < bamHdr->target_len[regions[i].tid] ? end : bamHdr->target_len[regions[i].tid];
+    }
+
+    // Sort and merge overlapping regions
+    qsort(regions, stList_length(regionStrings), sizeof(stBamRegion), stBamRegion_cmpFn);
+    *regionNumber = 0;
+    for (int64_t i = 0; i < stList_length(regionStrings); i++) {
+        stBamRegion *previous = *regionNumber > 0 ? &regions[*regionNumber - 1] : NULL;
+        if (previous != NULL && previous->tid == regions[i].tid && previous->end >= regions[i].start) {
+            previous->end = previous->end > regions[i].end ? previous->end : regions[i].end;
+        } else {
+            regions[(*regionNumber)++] = regions[i];
+        }
+    }
+    return regions;
+}
+
+int readNextAlignment(samFile *in, bam_hdr_t *bamHdr, bam1_t *aln, hts_idx_t *idx,
+                      stBamRegion *regions, int64_t regionNumber, int64_t *regionIndex, hts_itr_t **itr) {
+    /*
+     * Reads the next alignment into aln, returning a negative value once there are none left. If regions is NULL
+     * the alignments are read from the whole file, otherwise they are read from the index for each region in
+     * turn, with *regionIndex giving the current region. As the regions are disjoint, an alignment overlapping
+     * several regions is read once for each of them (see alignmentInPreviousBamRegion).
+     */
+    if (regions == NULL) {
+        return sam_read1(in, bamHdr, aln);
+    }
+    while (*regionIndex < regionNumber) {
+        stBamRegion *region = &regions[*regionIndex];
+        if (*itr == NULL) {
+            *itr = sam_itr_queryi(idx, region->tid, region->start, region->end);
+            if (*itr == NULL) {
+                st_errAbort("ERROR: Could not query region %s:%" PRIi64 "-%" PRIi64 " of the bam file\n",
+                            bamHdr->target_name[region->tid], region->start + 1, region->end);
+            }
+        }
+        int ret = sam_itr_next(in, *itr, aln);
+        if (ret >= 0) {
+            return 1;
+        }
+        if (ret < -1) {
+            st_errAbort("ERROR: Truncated bam file when reading region %s:%" PRIi64 "-%" PRIi64 "\n",
+                        bamHdr->target_name[region->tid], region->start + 1, region->end);
+        }
+        hts_itr_destroy(*itr);
+        *itr = NULL;
+        (*regionIndex)++;
+    }
+    return -1;
+}
+
+bool alignmentInPreviousBamRegion(bam1_t *aln, stBamRegion *regions, int64_t regionIndex) {
+    /*
+     * Returns true if the alignment, read for the given region by readNextAlignment, was also read for an earlier
+     * region. As the regions are sorted and disjoint, this is the case if it overlaps the previous region.
+     */
+    if (regionIndex == 0) {
+        return false;
+    }
+    stBamRegion *previous = &regions[regionIndex - 1];
+    return previous->tid == aln->core.tid && aln->core.pos < previous->end;
+}
+
+static stProfileSeq *clipProfileSeqToRegion(stProfileSeq *pSeq, stBamRegion *region) {
+    /*
+     * Returns the part of the profile sequence within the region, destroying the profile sequence if it is
+     * clipped, or NULL if there is no such part.
+     */
+    // Profile sequence coordinates are one-based
+    int64_t start = pSeq->refStart > region->start + 1 ? pSeq->refStart : region->start + 1;
+    int64_t end = pSeq->refStart + pSeq->length < region->end + 1 ? pSeq->refStart + pSeq->length : region->end + 1;
+    if (start >= end) {
+        stProfileSeq_destruct(pSeq);
+        return NULL;
+    }
+    if (start == pSeq->refStart && end == pSeq->refStart + pSeq->length) {
+        return pSeq;
+    }
+    stProfileSeq *subSeq = stProfileSeq_getSubsequence(pSeq, start, end - start);
+    stProfileSeq_destruct(pSeq);
+    return subSeq;
+}
 
 /* Parse reads within an input interval of a reference sequence of a bam file
  * and create a list of profile sequences by turning characters into profile probabilities.
@@ -611,199 +1253,363 @@ stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLoca
  * signal level alignments).
  * */
 int64_t parseReads(stList *profileSequences, char *bamFile, stBaseMapper *baseMapper, stRPHmmParameters *params) {
-    return parseReadsWithSingleNucleotideProbs(profileSequences, bamFile, baseMapper, params, NULL, false);
+    return parseReadsInRegions(profileSequences, bamFile, baseMapper, params, NULL, false, NULL);
 }
 
 int64_t parseReadsWithSingleNucleotideProbs(stList *profileSequences, char *bamFile, stBaseMapper *baseMapper,
                                             stRPHmmParameters *params, char *singleNuclProbDirectory,
                                             bool onlySingleNuclProb) {
-    if (singleNuclProbDirectory != NULL) {
-        st_logInfo("\tModifying probabilities from single nucleotide probability files in %s\n",
-                   singleNuclProbDirectory);
+    return parseReadsInRegions(profileSequences, bamFile, baseMapper, params, singleNuclProbDirectory,
+                               onlySingleNuclProb, NULL);
+}
+
+typedef struct _alignmentConversion {
+    /*
+     * The profile sequence converted from an alignment, if any, and the alignment's contribution to each of
+     * the counts of reads kept while parsing.
+     */
+    stProfileSeq *pSeq;
+    int64_t readCount;
+    int64_t singleNuclProbReadCount;
+    int64_t bamReadCount;
+    int64_t profileCount;
+    int64_t missingSingleNuclProbReads;
+    int64_t filteredReads;
+    int64_t filteredReads_flag;
+    int64_t filteredReads_mapq;
+} alignmentConversion;
+
+static void convertAlignment(alignmentConversion *conversion, bam1_t *aln, bam_hdr_t *bamHdr,
+                             stBaseMapper *baseMapper, stRPHmmParameters *params, char *singleNuclProbDirectory,
+                             stSingleNuclProbContainer *singleNuclProbContainer, bool onlySingleNuclProb,
+                             stBamRegion *region) {
+    /*
+     * Converts an alignment into a profile sequence, filtering it and reading its single nucleotide
+     * probabilities as described for parseReadsInRegions. Wildcard bases are resolved with a seed taken from the
+     * read name and position, so this only reads its arguments and alignments can be converted in parallel.
+     */
+    memset(conversion, 0, sizeof(alignmentConversion));
+    stProfileSeq *pSeq = NULL;
+
+    int64_t pos = aln->core.pos+1;                      // Left most position of alignment
+    char *chr = bamHdr->target_name[aln->core.tid] ;    // Contig name (chromosome)
+    int64_t len = aln->core.l_qseq;                     // Length of the read.
+    uint8_t *seq = bam_get_seq(aln);                    // DNA sequence
+    char *readName = bam_get_qname(aln);
+    uint32_t *cigar = bam_get_cigar(aln);
+
+    if (aln->core.l_qseq <= 0) {
+        conversion->filteredReads++;
+        return;
     }
 
-    samFile *in = hts_open(bamFile, "r");
-    if (in == NULL) {
-        st_errAbort("ERROR: Cannot open bam file %s\n", bamFile);
-        return -1;
+    // Filter out any reads with specified flags
+    if((aln->core.flag & params->filterAReadWithAnyOneOfTheseSamFlagsSet) > 0) {
+        conversion->filteredReads++;
+        conversion->filteredReads_flag++;
+        return;
     }
-    bam_hdr_t *bamHdr = sam_hdr_read(in);
-    bam1_t *aln = bam_init1();
 
-    int64_t readCount = 0;
-    int64_t singleNuclProbReadCount = 0;
-    int64_t bamReadCount = 0;
-    int64_t profileCount = 0;
-    int64_t missingSingleNuclProbReads = 0;
-    int64_t filteredReads = 0;
-    int64_t filteredReads_flag = 0;
-    int64_t filteredReads_mapq = 0;
+    // If there isn't a cigar string, don't bother including the read, since we don't
+    // know how it aligns
+    if (aln->core.n_cigar == 0) {
+        conversion->filteredReads++;
+        return;
+    }
 
-    while(sam_read1(in,bamHdr,aln) > 0) {
-        stProfileSeq *pSeq = NULL;
+    // If the mapq score is less than the given threshold, filter it out
+    if (aln->core.qual < params->mapqFilter) {
+        conversion->filteredReads++;
+        conversion->filteredReads_mapq++;
+        return;
+    }
 
-        int64_t pos = aln->core.pos+1;                      // Left most position of alignment
-        char *chr = bamHdr->target_name[aln->core.tid] ;    // Contig name (chromosome)
-        int64_t len = aln->core.l_qseq;                     // Length of the read.
-        uint8_t *seq = bam_get_seq(aln);                    // DNA sequence
-        char *readName = bam_get_qname(aln);
-        uint32_t *cigar = bam_get_cigar(aln);
+    // Tracks how many reads there were
+    conversion->readCount++;
 
-        if (aln->core.l_qseq <= 0) {
-            filteredReads++;
-            continue;
+    // Should we read from the signalAlign directory?
+    if (singleNuclProbDirectory != NULL) {
+
+        bool foundSingleNuclProbs = false;
+
+        // Get the read's probabilities from the container, or its signalAlign file (if exists)
+        if (singleNuclProbContainer != NULL) {
+            pSeq = stSingleNuclProbContainer_getProfileSeq(singleNuclProbContainer, readName, baseMapper, params);
+        } else {
+            char *singleNuclProbReadLocation = stString_print("%s/%s.tsv", singleNuclProbDirectory, readName);
+            if (access(singleNuclProbReadLocation, F_OK) != -1) {
+                pSeq = getProfileSequenceFromSingleNuclProbFile(singleNuclProbReadLocation, readName, baseMapper,
+                                                                params);
+            }
+            free(singleNuclProbReadLocation);
         }
+        if (pSeq == NULL) {
+            // Could not find the read's probabilities
+            conversion->missingSingleNuclProbReads++;
+        } else {
+            // Found the read's probabilities
+            pSeq->mappingQuality = aln->core.qual;
+            conversion->singleNuclProbReadCount++;
 
-        // Filter out any reads with specified flags
-        if((aln->core.flag & params->filterAReadWithAnyOneOfTheseSamFlagsSet) > 0) {
-            filteredReads++;
-            filteredReads_flag++;
-            continue;
+            // We have a profile, so save it, clipped to the region it was read for
+            if (region != NULL) {
+                pSeq = clipProfileSeqToRegion(pSeq, region);
+            }
+            if (pSeq != NULL) {
+                conversion->pSeq = pSeq;
+                conversion->profileCount++;
+            }
+            foundSingleNuclProbs = true;
         }
 
-        // If there isn't a cigar string, don't bother including the read, since we don't
-        // know how it aligns
-        if (aln->core.n_cigar == 0) {
-            filteredReads++;
-            continue;
+        // If we found a SA file or if we don't want missing reads
+        if (foundSingleNuclProbs || onlySingleNuclProb) {
+            return;
         }
+    }
 
-        // If the mapq score is less than the given threshold, filter it out
-        if (aln->core.qual < params->mapqFilter) {
-            filteredReads++;
-            filteredReads_mapq++;
-            continue;
+    int64_t start_read = 0;
+    int64_t end_read = 0;
+    int64_t start_ref = pos;
+    int64_t cig_idx = 0;
+
+    // Find the correct starting locations on the read and reference sequence,
+    // to deal with things like inserts / deletions / soft clipping
+    while (cig_idx < aln->core.n_cigar) {
+        int cigarOp = cigar[cig_idx] & BAM_CIGAR_MASK;
+        int cigarNum = cigar[cig_idx] >> BAM_CIGAR_SHIFT;
+
+        if (cigarOp == BAM_CMATCH || cigarOp == BAM_CEQUAL || cigarOp == BAM_CDIFF) {
+            break;
+        } else if (cigarOp == BAM_CDEL || cigarOp == BAM_CREF_SKIP) {
+            start_ref += cigarNum;
+            cig_idx++;
+        } else if (cigarOp == BAM_CINS || cigarOp == BAM_CSOFT_CLIP) {
+            start_read += cigarNum;
+            cig_idx++;
+        } else if (cigarOp == BAM_CHARD_CLIP || cigarOp == BAM_CPAD) {
+            cig_idx++;
+        } else {
+            st_errAbort("Unidentifiable cigar operation\n");
         }
+    }
 
-        // Tracks how many reads there were
-        readCount++;
+    // Check for soft clipping at the end
+    if (aln->core.n_cigar > 1) {
+        int lastCigarOp = cigar[aln->core.n_cigar-1] & BAM_CIGAR_MASK;
+        int lastCigarNum = cigar[aln->core.n_cigar-1] >> BAM_CIGAR_SHIFT;
+        if (lastCigarOp == BAM_CSOFT_CLIP) {
+            end_read += lastCigarNum;
+        }
+    }
 
-        // Should we read from the signalAlign directory?
-        if (singleNuclProbDirectory != NULL) {
+    // Count number of insertions & deletions in sequence
+    int64_t numInsertions = 0;
+    int64_t numDeletions = 0;
+    countIndels(cigar, aln->core.n_cigar, &numInsertions, &numDeletions);
+    int64_t trueLength = len - start_read - end_read + numDeletions - numInsertions;
 
-            // Get signalAlign file (if exists)
-            char *singleNuclProbReadLocation = stString_print("%s/%s.tsv", singleNuclProbDirectory, readName);
-            if (access(singleNuclProbReadLocation, F_OK) == -1) {
-                // Could not find the read file
-                missingSingleNuclProbReads++;
-            } else {
-                // Found the read file
-                pSeq = getProfileSequenceFromSingleNuclProbFile(singleNuclProbReadLocation, readName, baseMapper, params);
-                singleNuclProbReadCount++;
-
-                // We have a profile, so save it
-                stList_append(profileSequences, pSeq);
-                profileCount++;
-            }
-            free(singleNuclProbReadLocation);
+    if (trueLength <= 0) {
+        conversion->filteredReads++;
+        return;
+    }
 
-            // If we found a SA file or if we don't want missing reads
-            if (pSeq != NULL || onlySingleNuclProb) {
-                continue;
-            }
+    // Create empty profile sequence
+    pSeq = stProfileSeq_constructEmptyProfile(chr, readName, pos, trueLength);
+    pSeq->mappingQuality = aln->core.qual;
+
+    // Variables to keep track of position in sequence / cigar operations
+    cig_idx = 0;
+    int64_t currPosInOp = 0;
+    int64_t cigarOp = -1;
+    int64_t cigarNum = -1;
+    int64_t idxInSeq = start_read;
+    uint64_t readSeed = stHash_stringKey(readName);
+
+    // For each position turn character into profile probability
+    // As is, this makes the probability 1 for the base read in, and 0 otherwise
+    for (uint32_t i = 0; i < trueLength; i++) {
+
+        if (currPosInOp == 0) {
+            cigarOp = cigar[cig_idx] & BAM_CIGAR_MASK;
+            cigarNum = cigar[cig_idx] >> BAM_CIGAR_SHIFT;
         }
-
-        int64_t start_read = 0;
-        int64_t end_read = 0;
-        int64_t start_ref = pos;
-        int64_t cig_idx = 0;
-
-        // Find the correct starting locations on the read and reference sequence,
-        // to deal with things like inserts / deletions / soft clipping
-        while (cig_idx < aln->core.n_cigar) {
-            int cigarOp = cigar[cig_idx] & BAM_CIGAR_MASK;
-            int cigarNum = cigar[cig_idx] >> BAM_CIGAR_SHIFT;
-
-            if (cigarOp == BAM_CMATCH || cigarOp == BAM_CEQUAL || cigarOp == BAM_CDIFF) {
-                break;
-            } else if (cigarOp == BAM_CDEL || cigarOp == BAM_CREF_SKIP) {
-                start_ref += cigarNum;
-                cig_idx++;
-            } else if (cigarOp == BAM_CINS || cigarOp == BAM_CSOFT_CLIP) {
-                start_read += cigarNum;
-                cig_idx++;
-            } else if (cigarOp == BAM_CHARD_CLIP || cigarOp == BAM_CPAD) {
-                cig_idx++;
-            } else {
-                st_errAbort("Unidentifiable cigar operation\n");
+        if (cigarOp == BAM_CMATCH || cigarOp == BAM_CEQUAL || cigarOp == BAM_CDIFF) {
+            int64_t b = stBaseMapper_getValueForCharWithSeed(baseMapper, seq_nt16_str[bam_seqi(seq, idxInSeq)],
+                                                             readSeed + idxInSeq);
+            pSeq->profileProbs[i * ALPHABET_SIZE + b] = ALPHABET_MAX_PROB;
+            idxInSeq++;
+        } else if (cigarOp == BAM_CDEL || cigarOp == BAM_CREF_SKIP) {
+            // Only add a gap character when that param is on
+            if (params->gapCharactersForDeletions) {
+                // This assumes gap character is the last character in the alphabet given
+                pSeq->profileProbs[i * ALPHABET_SIZE + (ALPHABET_SIZE - 1)] = ALPHABET_MAX_PROB;
             }
+        } else if (cigarOp == BAM_CINS) {
+            // Currently, ignore insertions
+            idxInSeq++;
+            i--;
+        } else if (cigarOp == BAM_CSOFT_CLIP || cigarOp == BAM_CHARD_CLIP || cigarOp == BAM_CPAD) {
+            // Nothing really to do here. skip to next cigar operation
+            currPosInOp = cigarNum - 1;
+            i--;
+        } else {
+            st_logCritical("Unidentifiable cigar operation\n");
         }
 
-        // Check for soft clipping at the end
-        if (aln->core.n_cigar > 1) {
-            int lastCigarOp = cigar[aln->core.n_cigar-1] & BAM_CIGAR_MASK;
-            int lastCigarNum = cigar[aln->core.n_cigar-1] >> BAM_CIGAR_SHIFT;
-            if (lastCigarOp == BAM_CSOFT_CLIP) {
-                end_read += lastCigarNum;
-            }
+        currPosInOp++;
+        if (currPosInOp == cigarNum) {
+            cig_idx++;
+            currPosInOp = 0;
         }
+    }
+    conversion->bamReadCount++;
 
-        // Count number of insertions & deletions in sequence
-        int64_t numInsertions = 0;
-        int64_t numDeletions = 0;
-        countIndels(cigar, aln->core.n_cigar, &numInsertions, &numDeletions);
-        int64_t trueLength = len - start_read - end_read + numDeletions - numInsertions;
+    // Save profile seq
+    if (region != NULL) {
+        pSeq = clipProfileSeqToRegion(pSeq, region);
+    }
+    if (pSeq != NULL && pSeq->length > 0) {
+        conversion->profileCount++;
+        conversion->pSeq = pSeq;
+    }
+}
 
-        if (trueLength <= 0) {
-            filteredReads++;
-            continue;
+// The number of alignments read from a bam file while the previous batch is converted to profile sequences
+#define ALIGNMENT_BATCH_SIZE 4096
+
+static int64_t readAlignmentBatch(samFile *in, bam_hdr_t *bamHdr, bam1_t **alns, int64_t *alnRegionIndexes,
+                                  hts_idx_t *idx, stBamRegion *regions, int64_t regionNumber, int64_t *regionIndex,
+                                  hts_itr_t **itr) {
+    /*
+     * Reads up to ALIGNMENT_BATCH_SIZE alignments into alns (see readNextAlignment), recording the region each
+     * was read for. Returns the number of alignments read.
+     */
+    int64_t batchLength = 0;
+    while (batchLength < ALIGNMENT_BATCH_SIZE &&
+           readNextAlignment(in, bamHdr, alns[batchLength], idx, regions, regionNumber, regionIndex, itr) > 0) {
+        alnRegionIndexes[batchLength++] = *regionIndex;
+    }
+    return batchLength;
+}
+
+/* As parseReadsWithSingleNucleotideProbs, but if regionStrings is not NULL only the reads overlapping the
+ * given regions (chr:start-end, one-based and closed) are read, using the bam index, and each profile sequence
+ * is clipped to the region it was read for, so a read spanning several regions gives a profile sequence for each.
+ * */
+int64_t parseReadsInRegions(stList *profileSequences, char *bamFile, stBaseMapper *baseMapper,
+                            stRPHmmParameters *params, char *singleNuclProbDirectory, bool onlySingleNuclProb,
+                            stList *regionStrings) {
+    stSingleNuclProbContainer *singleNuclProbContainer = NULL;
+    if (singleNuclProbDirectory != NULL) {
+        st_logInfo("\tModifying probabilities from single nucleotide probability files in %s\n",
+                   singleNuclProbDirectory);
+        if (isSingleNuclProbContainer(singleNuclProbDirectory)) {
+            singleNuclProbContainer = stSingleNuclProbContainer_open(singleNuclProbDirectory);
         }
+    }
 
-        // Create empty profile sequence
-        pSeq = stProfileSeq_constructEmptyProfile(chr, readName, pos, trueLength);
+    samFile *in = hts_open(bamFile, "r");
+    if (in == NULL) {
+        st_errAbort("ERROR: Cannot open bam file %s\n", bamFile);
+        return -1;
+    }
+    htslibThreadPool_attach(in);
+    bam_hdr_t *bamHdr = sam_hdr_read(in);
 
-        // Variables to keep track of position in sequence / cigar operations
-        cig_idx = 0;
-        int64_t currPosInOp = 0;
-        int64_t cigarOp = -1;
-        int64_t cigarNum = -1;
-        int64_t idxInSeq = start_read;
+    // Load the index to read only the given regions
+    hts_idx_t *idx = NULL;
+    stBamRegion *regions = NULL;
+    int64_t regionNumber = 0, regionIndex = 0;
+    hts_itr_t *itr = NULL;
+    if (regionStrings != NULL) {
+        idx = sam_index_load(in, bamFile);
+        if (idx == NULL) {
+            st_errAbort("ERROR: Cannot load index for bam file %s\n", bamFile);
+        }
+        regions = getBamRegions(regionStrings, bamHdr, &regionNumber);
+        st_logInfo("\tReading reads from %" PRIi64 " regions of the bam file\n", regionNumber);
+    }
 
-        // For each position turn character into profile probability
-        // As is, this makes the probability 1 for the base read in, and 0 otherwise
-        for (uint32_t i = 0; i < trueLength; i++) {
+    int64_t initialProfileSequenceNumber = stList_length(profileSequences);
+    int64_t readCount = 0;
+    int64_t singleNuclProbReadCount = 0;
+    int64_t bamReadCount = 0;
+    int64_t profileCount = 0;
+    int64_t missingSingleNuclProbReads = 0;
+    int64_t filteredReads = 0;
+    int64_t filteredReads_flag = 0;
+    int64_t filteredReads_mapq = 0;
 
-            if (currPosInOp == 0) {
-                cigarOp = cigar[cig_idx] & BAM_CIGAR_MASK;
-                cigarNum = cigar[cig_idx] >> BAM_CIGAR_SHIFT;
-            }
-            if (cigarOp == BAM_CMATCH || cigarOp == BAM_CEQUAL || cigarOp == BAM_CDIFF) {
-                int64_t b = stBaseMapper_getValueForChar(baseMapper, seq_nt16_str[bam_seqi(seq, idxInSeq)]);
-                pSeq->profileProbs[i * ALPHABET_SIZE + b] = ALPHABET_MAX_PROB;
-                idxInSeq++;
-            } else if (cigarOp == BAM_CDEL || cigarOp == BAM_CREF_SKIP) {
-                // Only add a gap character when that param is on
-                if (params->gapCharactersForDeletions) {
-                    // This assumes gap character is the last character in the alphabet given
-                    pSeq->profileProbs[i * ALPHABET_SIZE + (ALPHABET_SIZE - 1)] = ALPHABET_MAX_PROB;
-                }
-            } else if (cigarOp == BAM_CINS) {
-                // Currently, ignore insertions
-                idxInSeq++;
-                i--;
-            } else if (cigarOp == BAM_CSOFT_CLIP || cigarOp == BAM_CHARD_CLIP || cigarOp == BAM_CPAD) {
-                // Nothing really to do here. skip to next cigar operation
-                currPosInOp = cigarNum - 1;
-                i--;
-            } else {
-                st_logCritical("Unidentifiable cigar operation\n");
+    // Read the alignments in batches. While one thread reads the next batch, the others convert the current
+    // batch to profile sequences, which are then added in input order
+    bam1_t **alns[2];
+    int64_t *alnRegionIndexes[2];
+    for (int64_t i = 0; i < 2; i++) {
+        alns[i] = st_malloc(sizeof(bam1_t *) * ALIGNMENT_BATCH_SIZE);
+        alnRegionIndexes[i] = st_malloc(sizeof(int64_t) * ALIGNMENT_BATCH_SIZE);
+        for (int64_t j = 0; j < ALIGNMENT_BATCH_SIZE; j++) {
+            alns[i][j] = bam_init1();
+        }
+    }
+    alignmentConversion *conversions = st_malloc(sizeof(alignmentConversion) * ALIGNMENT_BATCH_SIZE);
+    int64_t currentBatch = 0;
+    int64_t batchLength = readAlignmentBatch(in, bamHdr, alns[0], alnRegionIndexes[0], idx, regions, regionNumber,
+                                             &regionIndex, &itr);
+    while (batchLength > 0) {
+        int64_t nextBatchLength = 0;
+#if defined(_OPENMP)
+        #pragma omp parallel
+#endif
+        {
+#if defined(_OPENMP)
+            #pragma omp single nowait
+#endif
+            nextBatchLength = readAlignmentBatch(in, bamHdr, alns[1 - currentBatch], alnRegionIndexes[1 - currentBatch],
+                                                 idx, regions, regionNumber, &regionIndex, &itr);
+
+#if defined(_OPENMP)
+            #pragma omp for schedule(dynamic, 16)
+#endif
+            for (int64_t i = 0; i < batchLength; i++) {
+                convertAlignment(&conversions[i], alns[currentBatch][i], bamHdr, baseMapper, params,
+                                 singleNuclProbDirectory, singleNuclProbContainer, onlySingleNuclProb,
+                                 regions == NULL ? NULL : &regions[alnRegionIndexes[currentBatch][i]]);
             }
+        }
 
-            currPosInOp++;
-            if (currPosInOp == cigarNum) {
-                cig_idx++;
-                currPosInOp = 0;
+        // Add the profile sequences and counts in input order, counting each read once however many regions
+        // it spans
+        for (int64_t i = 0; i < batchLength; i++) {
+            alignmentConversion *conversion = &conversions[i];
+            if (conversion->pSeq != NULL) {
+                stList_append(profileSequences, conversion->pSeq);
+            }
+            profileCount += conversion->profileCount;
+            if (regions != NULL && alignmentInPreviousBamRegion(alns[currentBatch][i], regions,
+                                                                alnRegionIndexes[currentBatch][i])) {
+                continue;
             }
+            readCount += conversion->readCount;
+            singleNuclProbReadCount += conversion->singleNuclProbReadCount;
+            bamReadCount += conversion->bamReadCount;
+            missingSingleNuclProbReads += conversion->missingSingleNuclProbReads;
+            filteredReads += conversion->filteredReads;
+            filteredReads_flag += conversion->filteredReads_flag;
+            filteredReads_mapq += conversion->filteredReads_mapq;
         }
-        bamReadCount++;
 
-        // Save profile seq
-        if (pSeq->length > 0) {
-            profileCount++;
-            stList_append(profileSequences, pSeq);
+        currentBatch = 1 - currentBatch;
+        batchLength = nextBatchLength;
+    }
+    for (int64_t i = 0; i < 2; i++) {
+        for (int64_t j = 0; j < ALIGNMENT_BATCH_SIZE; j++) {
+            bam_destroy1(alns[i][j]);
         }
-
+        free(alns[i]);
+        free(alnRegionIndexes[i]);
     }
+    free(conversions);
 
     // Log signal align usage
     if (singleNuclProbDirectory != NULL) {
@@ -827,10 +1633,16 @@ int64_t parseReadsWithSingleNucleotideProbs(stList *profileSequences, char *bamF
     }
 
     // Sanity check (did we accidentally save profile sequences twice?)
-    assert(stList_length(profileSequences) <= readCount);
+    assert(stList_length(profileSequences) - initialProfileSequenceNumber == profileCount);
 
+    if (regionStrings != NULL) {
+        free(regions);
+        hts_idx_destroy(idx);
+    }
+    if (singleNuclProbContainer != NULL) {
+        stSingleNuclProbContainer_close(singleNuclProbContainer);
+    }
     bam_hdr_destroy(bamHdr);
-    bam_destroy1(aln);
     sam_close(in);
 
     return profileCount;
@@ -10,15 +10,30 @@
  * Functions for manipulating read partitions described in binary
  */
 
-inline uint64_t makeAcceptMask(uint64_t depth) {
+uint64_t partitionHashFn(const void *a) {
+    /*
+     * Hash function for partitions, used as the keys of cells and merge cells.
+     */
+#if READ_PARTITIONING_BITS == 64
+    return *(stRPPartition *)a;
+#else
+    return (uint64_t)*(stRPPartition *)a ^ (uint64_t)(*(stRPPartition *)a >> 64);
+#endif
+}
+
+int partitionEqualsFn(const void *key1, const void *key2) {
+    return *(stRPPartition *)key1 == *(stRPPartition *)key2;
+}
+
+inline stRPPartition makeAcceptMask(uint64_t depth) {
     /*
      * Returns a mask to the given sequence depth that includes all the sequences
      */
     assert(depth <= MAX_READ_PARTITIONING_DEPTH);
-    return depth < 64 ? ~(0xFFFFFFFFFFFFFFFF << depth) : 0xFFFFFFFFFFFFFFFF;
+    return depth < READ_PARTITIONING_BITS ? ~(~((stRPPartition)0) << depth) : ~((stRPPartition)0);
 }
 
-inline uint64_t mergePartitionsOrMasks(uint64_t partition1, uint64_t partition2,
+inline stRPPartition mergePartitionsOrMasks(stRPPartition partition1, stRPPartition partition2,
         uint64_t depthOfPartition1, uint64_t depthOfPartition2) {
     /*
      * Take two read partitions or masks and merge them together
@@ -27,21 +42,21 @@ inline uint64_t mergePartitionsOrMasks(uint64_t partition1, uint64_t partition2,
     return (partition2 << depthOfPartition1) | partition1;
 }
 
-inline uint64_t maskPartition(uint64_t partition, uint64_t mask) {
+inline stRPPartition maskPartition(stRPPartition partition, stRPPartition mask) {
     /*
      * Mask a read partition
      */
     return partition & mask;
 }
 
-inline uint64_t invertPartition(uint64_t partition, uint64_t depth) {
+inline stRPPartition invertPartition(stRPPartition partition, uint64_t depth) {
     /*
      * Invert a partition
      */
     return makeAcceptMask(depth) & ~partition;
 }
 
-inline bool seqInHap1(uint64_t partition, int64_t seqIndex) {
+inline bool seqInHap1(stRPPartition partition, int64_t seqIndex) {
     /*
      * Returns non-zero if the sequence indexed by seqIndex is in the first haplotype,
      * rather than the second, according to the given partition.
@@ -50,11 +65,11 @@ inline bool seqInHap1(uint64_t partition, int64_t seqIndex) {
     return (partition >> seqIndex) & 1;
 }
 
-char * intToBinaryString(uint64_t i) {
+char * intToBinaryString(stRPPartition i) {
     /*
-     * Converts the unsigned int to a binary string.
+     * Converts the partition to a binary string.
      */
-    int64_t bits = sizeof(uint64_t)*8;
+    int64_t bits = sizeof(stRPPartition)*8;
     char * str = st_malloc((bits + 1) * sizeof(char));
     str[bits] = '\0'; //terminate the string
 
@@ -62,15 +77,15 @@ char * intToBinaryString(uint64_t i) {
     // so that 14 will end up as 1110 and 15 will end up as
     // 1111 (plus some prefix bits)
     for(int64_t bit=0; bit < bits; i >>= 1) {
-        str[(sizeof(uint64_t)*8)-++bit] = i & 1 ? '1' : '0';
+        str[bits-++bit] = i & 1 ? '1' : '0';
     }
 
     return str;
 }
 
-uint64_t flipAReadsPartition(uint64_t partition, uint64_t readIndex) {
+stRPPartition flipAReadsPartition(stRPPartition partition, uint64_t readIndex) {
     /*
      * Switches which the partition of a given read whose index in the partition vector is readIndex.
      */
-    return partition ^ ((uint64_t)1 << readIndex);
+    return partition ^ ((stRPPartition)1 << readIndex);
 }
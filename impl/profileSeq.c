@@ -21,10 +21,26 @@ stProfileSeq *stProfileSeq_constructEmptyProfile(char *referenceName, char *read
     seq->readId = stString_copy(readId);
     seq->refStart = referenceStart;
     seq->length = length;
+    seq->mappingQuality = 0;
     seq->profileProbs = st_calloc(length*ALPHABET_SIZE, sizeof(uint8_t));
     return seq;
 }
 
+stProfileSeq *stProfileSeq_getSubsequence(stProfileSeq *seq, int64_t referenceStart, int64_t length) {
+    /*
+     * Creates a copy of the part of the profile sequence covering the given reference interval, which must
+     * be contained in the reference interval of the profile sequence.
+     */
+    assert(referenceStart >= seq->refStart);
+    assert(length > 0 && referenceStart + length <= seq->refStart + seq->length);
+
+    stProfileSeq *subSeq = stProfileSeq_constructEmptyProfile(seq->referenceName, seq->readId, referenceStart, length);
+    subSeq->mappingQuality = seq->mappingQuality;
+    memcpy(subSeq->profileProbs, &seq->profileProbs[(referenceStart - seq->refStart) * ALPHABET_SIZE],
+           sizeof(uint8_t) * length * ALPHABET_SIZE);
+    return subSeq;
+}
+
 void stProfileSeq_destruct(stProfileSeq *seq) {
     /*
      * Cleans up memory for profile sequence.
@@ -28,6 +28,7 @@ stReferencePriorProbs *stReferencePriorProbs_constructEmptyProfile(char *referen
     for(int64_t i=0; i<length; i++) {
         referencePriorProbs->referencePositionsIncluded[i] = true;
     }
+    stReferencePriorProbs_updateActivePositions(referencePriorProbs);
     return referencePriorProbs;
 }
 
@@ -40,9 +41,36 @@ void stReferencePriorProbs_destruct(stReferencePriorProbs *referencePriorProbs)
     free(referencePriorProbs->referenceSequence);
     free(referencePriorProbs->baseCounts);
     free(referencePriorProbs->referencePositionsIncluded);
+    free(referencePriorProbs->activePositions);
+    free(referencePriorProbs->activePositionCounts);
     free(referencePriorProbs);
 }
 
+void stReferencePriorProbs_updateActivePositions(stReferencePriorProbs *rProbs) {
+    /*
+     * Rebuilds the sorted array of positions included by rProbs->referencePositionsIncluded and the prefix
+     * counts of included positions, from which columns take their active positions without scanning the
+     * filter. Must be called whenever rProbs->referencePositionsIncluded is changed.
+     */
+    free(rProbs->activePositions);
+    free(rProbs->activePositionCounts);
+
+    rProbs->activePositionCounts = st_malloc((rProbs->length+1) * sizeof(int64_t));
+    rProbs->activePositionCounts[0] = 0;
+    for(int64_t i=0; i<rProbs->length; i++) {
+        rProbs->activePositionCounts[i+1] = rProbs->activePositionCounts[i] +
+                                            (rProbs->referencePositionsIncluded[i] ? 1 : 0);
+    }
+
+    rProbs->totalActivePositions = rProbs->activePositionCounts[rProbs->length];
+    rProbs->activePositions = st_malloc(rProbs->totalActivePositions * sizeof(int64_t));
+    for(int64_t i=0; i<rProbs->length; i++) {
+        if(rProbs->referencePositionsIncluded[i]) {
+            rProbs->activePositions[rProbs->activePositionCounts[i]] = i;
+        }
+    }
+}
+
 static stReferencePriorProbs *getNext(stList *profileSequences, stList *profileSequencesOnReference) {
     /*
      * Construct an empty stReferencePriorProbs for the next interval of a reference sequence.
@@ -284,6 +312,7 @@ int64_t stReferencePriorProbs_setReferencePositionFilter(stReferencePriorProbs *
             free(baseCountString);
         }
     }
+    stReferencePriorProbs_updateActivePositions(rProbs);
 
     return filteredPositions;
 }
@@ -742,6 +742,7 @@ void compareVCFsBasic(FILE *fh,
         st_logCritical("ERROR: cannot open reference vcf, %s\n", vcf_ref);
         return;
     }
+    htslibThreadPool_attach(inRef);
     bcf_hdr_t *hdrRef = bcf_hdr_read(inRef); //read header
     bcf1_t *refRecord = bcf_init1(); //initialize for reading
 
@@ -750,6 +751,7 @@ void compareVCFsBasic(FILE *fh,
         st_logCritical("ERROR: cannot open vcf to evaluate, %s\n", vcf_toEval);
         return;
     }
+    htslibThreadPool_attach(inEval);
 
     bcf_hdr_t *hdrEval = bcf_hdr_read(inEval); //read header
     bcf1_t *evalRecord = bcf_init1(); //initialize for reading
@@ -1026,6 +1028,7 @@ void compareVCFs(FILE *fh,
         st_logCritical("ERROR: cannot open reference vcf, %s\n", vcf_ref);
         return;
     }
+    htslibThreadPool_attach(inRef);
     bcf_hdr_t *hdrRef = bcf_hdr_read(inRef); //read header
     bcf1_t *refRecord = bcf_init1(); //initialize for reading
 
@@ -1034,6 +1037,7 @@ void compareVCFs(FILE *fh,
         st_logCritical("ERROR: cannot open vcf to evaluate, %s\n", vcf_toEval);
         return;
     }
+    htslibThreadPool_attach(inEval);
 
     bcf_hdr_t *hdrEval = bcf_hdr_read(inEval); //read header
     bcf1_t *evalRecord = bcf_init1(); //initialize for reading
@@ -1450,6 +1454,7 @@ void compareVCFs_debugWithBams(char *vcf_toEval,
         st_logCritical("ERROR: cannot open reference vcf, %s\n", vcf_ref);
         return;
     }
+    htslibThreadPool_attach(inRef);
     bcf_hdr_t *hdrRef = bcf_hdr_read(inRef); //read header
     bcf1_t *refRecord = bcf_init1(); //initialize for reading
 
@@ -1458,6 +1463,7 @@ void compareVCFs_debugWithBams(char *vcf_toEval,
         st_logCritical("ERROR: cannot open vcf to evaluate, %s\n", vcf_toEval);
         return;
     }
+    htslibThreadPool_attach(inEval);
 
     bcf_hdr_t *hdrEval = bcf_hdr_read(inEval); //read header
     bcf1_t *evalRecord = bcf_init1(); //initialize for reading
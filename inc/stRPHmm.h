@@ -35,6 +35,8 @@ typedef struct _stReferencePriorProbs stReferencePriorProbs;
 typedef struct _stBaseMapper stBaseMapper;
 typedef struct _stGenotypeResults stGenotypeResults;
 typedef struct _stReferencePositionFilter stReferencePositionFilter;
+typedef struct _stPhasingChunk stPhasingChunk;
+typedef struct _stBamRegion stBamRegion;
 
 /*
  * Overall coordination functions
@@ -45,10 +47,30 @@ stList *filterReadsByCoverageDepth(stList *profileSeqs, stRPHmmParameters *param
 
 stList *getRPHmms(stList *profileSeqs, stHash *referenceNamesToReferencePriors, stRPHmmParameters *params);
 
+stList *splitProfileSeqsAtWeaklyLinkedSites(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params, stList *clippedProfileSeqs);
+
+stList *getRPHmmsSplitAtWeaklyLinkedSites(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params, stList *clippedProfileSeqs);
+
+stList *getCoverageDepthBoundedSubsamples(stList *profileSeqs, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params, int64_t maxSubsampleNumber, stList *remainingProfileSeqs);
+
+stList *getEnsembleGenomeFragments(stList *subsamples, stHash *referenceNamesToReferencePriors,
+        stRPHmmParameters *params);
+
 stList *getTilingPaths(stSortedSet *hmms);
 
+stList *getTilingPathsOfProfileSeqs(stList *profileSeqs);
+
+stList *mergeTilingPathsByEstimatedCost(stList *tilingPaths);
+
 stSet *getOverlappingComponents(stList *tilingPath1, stList *tilingPath2);
 
+stList *getProfileSeqChunks(stList *profileSeqs, int64_t chunkSize, int64_t chunkOverlap);
+
+int64_t getPhasingConcordance(stSet *reads1, stSet *reads2, stSet *otherReads1, stSet *otherReads2);
+
 /*
  * Math
  */
@@ -84,23 +106,53 @@ double *getSubstitutionProbSlow(double *matrix, int64_t from, int64_t to);
  * Binary partition stuff
  */
 
+// Read partitions, and the masks used to merge them, are bit vectors with one bit per read, so the width of the
+// partition type is the maximum read depth the model can support. Compile with -DREAD_PARTITIONING_BITS=128 to
+// support deeper columns using the compiler's 128 bit integers, at some cost in speed.
+#ifndef READ_PARTITIONING_BITS
+#define READ_PARTITIONING_BITS 64
+#endif
+
+#if READ_PARTITIONING_BITS == 64
+typedef uint64_t stRPPartition;
+#elif READ_PARTITIONING_BITS == 128
+typedef unsigned __int128 stRPPartition;
+#else
+#error "READ_PARTITIONING_BITS must be 64 or 128"
+#endif
+
 // The maximum read depth the model can support
-#define MAX_READ_PARTITIONING_DEPTH 64
+#define MAX_READ_PARTITIONING_DEPTH READ_PARTITIONING_BITS
 
-char * intToBinaryString(uint64_t i);
+static inline int popcountPartition(stRPPartition x) {
+    /*
+     * Returns Hamming weight of a partition.
+     */
+#if READ_PARTITIONING_BITS == 64
+    return __builtin_popcountll(x);
+#else
+    return __builtin_popcountll((uint64_t)x) + __builtin_popcountll((uint64_t)(x >> 64));
+#endif
+}
+
+uint64_t partitionHashFn(const void *a);
+
+int partitionEqualsFn(const void *key1, const void *key2);
+
+char * intToBinaryString(stRPPartition i);
 
-uint64_t makeAcceptMask(uint64_t depth);
+stRPPartition makeAcceptMask(uint64_t depth);
 
-uint64_t mergePartitionsOrMasks(uint64_t partition1, uint64_t partition2,
+stRPPartition mergePartitionsOrMasks(stRPPartition partition1, stRPPartition partition2,
         uint64_t depthOfPartition1, uint64_t depthOfPartition2);
 
-uint64_t maskPartition(uint64_t partition, uint64_t mask);
+stRPPartition maskPartition(stRPPartition partition, stRPPartition mask);
 
-bool seqInHap1(uint64_t partition, int64_t seqIndex);
+bool seqInHap1(stRPPartition partition, int64_t seqIndex);
 
-uint64_t invertPartition(uint64_t partition, uint64_t depth);
+stRPPartition invertPartition(stRPPartition partition, uint64_t depth);
 
-uint64_t flipAReadsPartition(uint64_t partition, uint64_t readIndex);
+stRPPartition flipAReadsPartition(stRPPartition partition, uint64_t readIndex);
 
 /*
  * _stProfileSeq
@@ -113,6 +165,8 @@ struct _stProfileSeq {
     char *readId;
     int64_t refStart;
     int64_t length;
+    // The MAPQ score of the alignment of the read, used to prefer reads when downsampling, 0 if unknown
+    uint8_t mappingQuality;
     // The probability of alphabet characters, as specified by uint8_t
     // Each is expressed as an 8 bit unsigned int, with 0x00 representing 0 prob and
     // 0xFF representing 1.0 and each step between representing a linear step in probability of
@@ -123,6 +177,8 @@ struct _stProfileSeq {
 stProfileSeq *stProfileSeq_constructEmptyProfile(char *referenceName, char *readId,
                                                  int64_t referenceStart, int64_t length);
 
+stProfileSeq *stProfileSeq_getSubsequence(stProfileSeq *seq, int64_t referenceStart, int64_t length);
+
 void stProfileSeq_destruct(stProfileSeq *seq);
 
 void stProfileSeq_print(stProfileSeq *seq, FILE *fileHandle, bool includeProbs);
@@ -153,12 +209,18 @@ struct _stReferencePriorProbs {
     double *baseCounts;
     // Filter array of positions in the reference, used to ignore some columns in the alignment
     bool *referencePositionsIncluded;
+    // Index of the positions included by the filter, see stReferencePriorProbs_updateActivePositions
+    int64_t *activePositions; // Sorted offsets from refStart of the included positions
+    int64_t totalActivePositions; // The length of activePositions
+    int64_t *activePositionCounts; // activePositionCounts[i] is the number of included positions before offset i
 };
 
 stReferencePriorProbs *stReferencePriorProbs_constructEmptyProfile(char *referenceName, int64_t referenceStart, int64_t length);
 
 void stReferencePriorProbs_destruct(stReferencePriorProbs *seq);
 
+void stReferencePriorProbs_updateActivePositions(stReferencePriorProbs *rProbs);
+
 stHash *createEmptyReferencePriorProbabilities(stList *profileSequences);
 
 stHash *createReferencePriorProbabilities(char *referenceFastaFile, stList *profileSequences,
@@ -171,15 +233,21 @@ double *stReferencePriorProbs_estimateReadErrorProbs(stHash *referenceNamesToRef
 /*
  * Emission probabilities methods
  */
-double emissionLogProbability(stRPColumn *column, stRPCell *cell, uint64_t *bitCountVectors,
+double emissionLogProbability(stRPColumn *column, stRPCell *cell, stRPPartition *bitCountVectors,
                                 stReferencePriorProbs *referencePriorProbs,
                                 stRPHmmParameters *params);
 
 double emissionLogProbabilitySlow(stRPColumn *column,
-        stRPCell *cell, uint64_t *bitCountVectors, stReferencePriorProbs *referencePriorProbs,
+        stRPCell *cell, stRPPartition *bitCountVectors, stReferencePriorProbs *referencePriorProbs,
         stRPHmmParameters *params, bool maxNotSum);
 
-void fillInPredictedGenome(stGenomeFragment *gF, uint64_t partition,
+void fillInPredictedGenome(stGenomeFragment *gF, stRPPartition partition,
+        stRPColumn *column, stReferencePriorProbs *referencePriorProbs, stRPHmmParameters *params);
+
+void fillInPredictedAlleleCounts(stGenomeFragment *gF, stRPPartition partition, stRPColumn *column,
+        bool *updatedPositions);
+
+void addPredictedHeterozygousSites(stList *hetSites, stRPPartition partition,
         stRPColumn *column, stReferencePriorProbs *referencePriorProbs, stRPHmmParameters *params);
 
 /*
@@ -187,10 +255,11 @@ void fillInPredictedGenome(stGenomeFragment *gF, uint64_t partition,
 */
 int popcount64(uint64_t x);
 
-uint64_t getExpectedInstanceNumber(uint64_t *bitCountVectors, uint64_t depth, uint64_t partition,
+uint64_t getExpectedInstanceNumber(stRPPartition *bitCountVectors, uint64_t depth, stRPPartition partition,
         int64_t position, int64_t characterIndex);
 
-uint64_t *calculateCountBitVectors(uint8_t **seqs, int64_t depth, int64_t *activePositions, int64_t totalActivePositions);
+stRPPartition *calculateCountBitVectors(uint8_t **seqs, int64_t depth, int64_t *activePositions, int64_t totalActivePositions,
+        int64_t positionOffset);
 
 /*
  * _stRPHmmParameters
@@ -211,12 +280,50 @@ struct _stRPHmmParameters {
     int64_t minPartitionsInAColumn;
     int64_t maxPartitionsInAColumn;
     double minPosteriorProbabilityForPartition;
+    // If greater than zero, replaces minPosteriorProbabilityForPartition with an adaptive threshold: the most
+    // probable partitions are kept until they hold this fraction of the posterior probability of the column,
+    // keeping between minPartitionsInAColumn and maxPartitionsInAColumn partitions
+    double targetPosteriorMassForPartitions;
 
     // MaxCoverageDepth is the maximum depth of profileSeqs to allow at any base.
     // If the coverage depth is higher than this then some profile seqs are randomly discarded.
     int64_t maxCoverageDepth;
     int64_t minReadCoverageToSupportPhasingBetweenHeterozygousSites;
 
+    // Whether to bound the memory used when merging hmms by keeping the forward and backward probabilities
+    // only every columnsBetweenCheckpoints columns and recomputing the columns in between as needed.
+    // If columnsBetweenCheckpoints is zero the square root of the number of columns is used.
+    bool checkpointForwardBackward;
+    int64_t columnsBetweenCheckpoints;
+
+    // If greater than one, the number of segments the forward-backward algorithm divides an hmm into to compute
+    // them in parallel. Segments are only cut at merge columns with at most maxMergeCellsAtSegmentBoundary merge cells.
+    int64_t forwardBackwardSegmentNumber;
+    int64_t maxMergeCellsAtSegmentBoundary;
+
+    // Whether to divide the reads into independent groups, before creating the hmms, at points between consecutive
+    // unfiltered reference positions spanned by fewer than minReadCoverageToSupportPhasingBetweenHeterozygousSites reads
+    bool preSplitReadsAtWeaklyLinkedSites;
+
+    // Whether the tiling paths of hmms are merged in the order of the estimated cost of merging them, cheapest first,
+    // rather than by recursively merging halves of the list of tiling paths
+    bool orderMergesByEstimatedCost;
+
+    // Whether the forward-backward algorithm calculates the emission probabilities first, so that the forward and
+    // backward passes can be run concurrently
+    bool concurrentForwardBackward;
+
+    // Whether the genome fragment genotypes positions excluded by the reference position filter with a cheap
+    // pileup rule given the partition, computing the full genotype posteriors only at the unfiltered positions.
+    // This only speeds up genotyping; the HMM still considers every position
+    bool genotypeFilteredPositionsFromPileup;
+
+    // If greater than one, the reads discarded to bound the coverage depth are divided into up to
+    // ensembleSubsampleNumber-1 further depth-bounded sub-samples, which are phased independently and in parallel.
+    // Each genome fragment is then reconciled with the consensus of the sub-samples, and the discarded reads are
+    // assigned to the haplotype that best explains them
+    int64_t ensembleSubsampleNumber;
+
     // Training
 
     // Number of iterations of training
@@ -257,6 +364,10 @@ struct _stRPHmmParameters {
     // Filter out any reads with a MAPQ score less than or equal to this.
     int64_t mapqFilter;
 
+    // Whether reads with higher MAPQ scores are kept in preference to others when discarding reads to bound the
+    // coverage depth (see filterReadsByCoverageDepth)
+    bool preferHighMapqWhenDownsampling;
+
     // Number of rounds of iterative refinement to attempt to improve the partition.
     int64_t roundsOfIterativeRefinement;
 
@@ -303,6 +414,9 @@ struct _stRPHmm {
     stReferencePriorProbs *referencePriorProbs;
     // Filter used to mask column positions from consideration
     stReferencePositionFilter *referencePositionFilter;
+    // Traceback path through the hmm retained from when it was split from a larger hmm, or NULL.
+    // See stRPHMM_splitWherePhasingIsUncertain and stRPHmm_forwardBackwardTraceBack
+    stList *path;
 };
 
 stRPHmm *stRPHmm_construct(stProfileSeq *profileSeq, stReferencePriorProbs *referencePriorProbs, stRPHmmParameters *params);
@@ -315,18 +429,26 @@ bool stRPHmm_overlapOnReference(stRPHmm *hmm1, stRPHmm *hmm2);
 
 stRPHmm *stRPHmm_createCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2);
 
+stRPHmm *stRPHmm_createPrunedCrossProductOfTwoAlignedHmm(stRPHmm *hmm1, stRPHmm *hmm2);
+
 void stRPHmm_alignColumns(stRPHmm *hmm1, stRPHmm *hmm2);
 
 stRPHmm *stRPHmm_fuse(stRPHmm *leftHmm, stRPHmm *rightHmm);
 
 void stRPHmm_forwardBackward(stRPHmm *hmm);
 
-void stRPHmm_prune(stRPHmm *hmm);
+void stRPHmm_forwardBackwardConcurrently(stRPHmm *hmm);
+
+void stRPHmm_forwardBackwardBySegments(stRPHmm *hmm, int64_t segmentNumber, int64_t maxMergeCellsAtSegmentBoundary);
+
+double stRPHmm_prune(stRPHmm *hmm);
 
 void stRPHmm_print(stRPHmm *hmm, FILE *fileHandle, bool includeColumns, bool includeCells);
 
 stList *stRPHmm_forwardTraceBack(stRPHmm *hmm);
 
+stList *stRPHmm_forwardBackwardTraceBack(stRPHmm *hmm);
+
 stSet *stRPHmm_partitionSequencesByStatePath(stRPHmm *hmm, stList *path, bool partition1);
 
 int stRPHmm_cmpFn(const void *a, const void *b);
@@ -335,6 +457,8 @@ stRPHmm *stRPHmm_split(stRPHmm *hmm, int64_t splitPoint);
 
 void stRPHmm_resetColumnNumberAndDepth(stRPHmm *hmm);
 
+stList *stRPHmm_getHeterozygousSites(stRPHmm *hmm, stList *path);
+
 stList *stRPHMM_splitWherePhasingIsUncertain(stRPHmm *hmm);
 
 void printBaseComposition2(double *baseCounts);
@@ -359,8 +483,10 @@ struct _stRPColumn {
     stRPMergeColumn *nColumn, *pColumn;
     double totalLogProb;
     // Record of which positions in the column are not filtered out
-    int64_t *activePositions; // List of positions that are not filtered out, relative to the start of the column in reference coordinates
+    int64_t *activePositions; // Slice of the rProbs->activePositions array covering the column, not owned by the column
     int64_t totalActivePositions; // The length of activePositions
+    int64_t activePositionsOffset; // Offset of the column start from rProbs->refStart, subtract from activePositions
+                                   // to get positions relative to the start of the column
 };
 
 stRPColumn *stRPColumn_construct(int64_t refStart, int64_t length, int64_t depth,
@@ -381,12 +507,12 @@ stSet *stRPColumn_getColumnSequencesAsSet(stRPColumn *column);
  * State of read partitioning hmm
  */
 struct _stRPCell {
-    uint64_t partition;
+    stRPPartition partition;
     double forwardLogProb, backwardLogProb;
     stRPCell *nCell;
 };
 
-stRPCell *stRPCell_construct(int64_t partition);
+stRPCell *stRPCell_construct(stRPPartition partition);
 
 void stRPCell_destruct(stRPCell *cell);
 
@@ -399,14 +525,14 @@ double stRPCell_posteriorProb(stRPCell *cell, stRPColumn *column);
  * Merge column of read partitioning hmm
  */
 struct _stRPMergeColumn {
-    uint64_t maskFrom;
-    uint64_t maskTo;
+    stRPPartition maskFrom;
+    stRPPartition maskTo;
     stHash *mergeCellsFrom;
     stHash *mergeCellsTo;
     stRPColumn *nColumn, *pColumn;
 };
 
-stRPMergeColumn *stRPMergeColumn_construct(uint64_t maskFrom, uint64_t maskTo);
+stRPMergeColumn *stRPMergeColumn_construct(stRPPartition maskFrom, stRPPartition maskTo);
 
 void stRPMergeColumn_destruct(stRPMergeColumn *mColumn);
 
@@ -423,13 +549,14 @@ int64_t stRPMergeColumn_numberOfPartitions(stRPMergeColumn *mColumn);
  * Merge cell of read partitioning hmm
  */
 struct _stRPMergeCell {
-    uint64_t fromPartition;
-    uint64_t toPartition;
+    stRPPartition fromPartition;
+    stRPPartition toPartition;
     double forwardLogProb, backwardLogProb;
+    bool chosen; // Used to mark the merge cells to keep when pruning
 };
 
-stRPMergeCell *stRPMergeCell_construct(uint64_t fromPartition,
-        uint64_t toPartition, stRPMergeColumn *mColumn);
+stRPMergeCell *stRPMergeCell_construct(stRPPartition fromPartition,
+        stRPPartition toPartition, stRPMergeColumn *mColumn);
 
 void stRPMergeCell_destruct(stRPMergeCell *mCell);
 
@@ -484,11 +611,47 @@ struct _stGenomeFragment {
 
 stGenomeFragment *stGenomeFragment_construct(stRPHmm *hmm, stList *path);
 
+stGenomeFragment *stGenomeFragment_constructEmpty(char *referenceName, int64_t refStart, int64_t length);
+
+void stGenomeFragment_copyInterval(stGenomeFragment *gF, stGenomeFragment *sourceGF, int64_t refStart,
+                                   int64_t refEnd, bool invertHaplotypes);
+
 void stGenomeFragment_destruct(stGenomeFragment *genomeFragment);
 
 void stGenomeFragment_refineGenomeFragment(stGenomeFragment *gF, stSet *reads1, stSet *reads2,
         stRPHmm *hmm, stList *path, int64_t maxIterations);
 
+void stGenomeFragment_reconcileWithEnsemble(stGenomeFragment *gF, stRPHmm *hmm, stList *path,
+        stList *ensembleGenomeFragments);
+
+/*
+ * Part of a contig whose reads are phased independently of the rest, the genome fragments of adjacent chunks
+ * being stitched into phase blocks
+ */
+
+struct _stPhasingChunk {
+    char *referenceName;
+    // The reference interval [chunkStart, chunkEnd) owned by the chunk, unbounded at the ends of the contig
+    int64_t chunkStart;
+    int64_t chunkEnd;
+    // The reads to phase, which may extend beyond the interval
+    stList *profileSeqs;
+    // The range of the chunk's hmms in the final list of hmms
+    int64_t firstHmm;
+    int64_t hmmNumber;
+};
+
+stPhasingChunk *stPhasingChunk_construct(char *referenceName, int64_t chunkStart, int64_t chunkEnd,
+                                         stList *profileSeqs);
+
+void stPhasingChunk_destruct(stPhasingChunk *chunk);
+
+int64_t stitchChunkPhaseBlocks(stList *chunks, stGenomeFragment **gFs, stSet **reads1s, stSet **reads2s,
+                               int64_t *blockStarts, int64_t *blockEnds, bool *stitched, bool *inverted);
+
+double getLogProbOfReadGivenHaplotype(uint64_t *haplotypeString, int64_t start, int64_t length,
+        stProfileSeq *profileSeq, stRPHmmParameters *params);
+
 /*
  * _stBaseMapper
  * Struct for alphabet and mapping bases to numbers
@@ -512,17 +675,68 @@ char stBaseMapper_getCharForValue(stBaseMapper *bm, uint64_t value);
 
 uint8_t stBaseMapper_getValueForChar(stBaseMapper *bm, char base);
 
+uint8_t stBaseMapper_getValueForCharWithSeed(stBaseMapper *bm, char base, uint64_t seed);
+
 /*
  * Parsing methods
  */
 
 stRPHmmParameters *parseParameters(char *paramsFile, stBaseMapper *baseMapper);
 
+void htslibThreadPool_construct(int64_t threadNumber);
+
+void htslibThreadPool_destruct();
+
+void htslibThreadPool_attach(htsFile *fp);
+
 int64_t parseReads(stList *profileSequences, char *bamFile, stBaseMapper *baseMapper, stRPHmmParameters *params);
 
 int64_t parseReadsWithSingleNucleotideProbs(stList *profileSequences, char *bamFile, stBaseMapper *baseMapper,
                                             stRPHmmParameters *params, char *signalAlignDirectory, bool onlySignalAlign);
 
+int64_t parseReadsInRegions(stList *profileSequences, char *bamFile, stBaseMapper *baseMapper,
+                            stRPHmmParameters *params, char *signalAlignDirectory, bool onlySignalAlign,
+                            stList *regionStrings);
+
+stList *parseRegionsFromBed(char *bedFile);
+
+// A region of a bam file's reference sequences
+struct _stBamRegion {
+    int tid;
+    int64_t start; // Zero-based, half-open
+    int64_t end;
+};
+
+stBamRegion *getBamRegions(stList *regionStrings, bam_hdr_t *bamHdr, int64_t *regionNumber);
+
+int readNextAlignment(samFile *in, bam_hdr_t *bamHdr, bam1_t *aln, hts_idx_t *idx,
+                      stBamRegion *regions, int64_t regionNumber, int64_t *regionIndex, hts_itr_t **itr);
+
+bool alignmentInPreviousBamRegion(bam1_t *aln, stBamRegion *regions, int64_t regionIndex);
+
+stProfileSeq* getProfileSequenceFromSingleNuclProbFile(char *signalAlignReadLocation, char *readName,
+                                                       stBaseMapper *baseMapper, stRPHmmParameters *params);
+
+/*
+ * Single nucleotide probability container, holding the single nucleotide probability files of a directory
+ * in one indexed, memory mapped file
+ */
+
+typedef struct _stSingleNuclProbContainer stSingleNuclProbContainer;
+
+int64_t writeSingleNuclProbContainer(char *singleNuclProbDirectory, char *containerFile);
+
+bool isSingleNuclProbContainer(char *fileName);
+
+stSingleNuclProbContainer *stSingleNuclProbContainer_open(char *containerFile);
+
+void stSingleNuclProbContainer_close(stSingleNuclProbContainer *container);
+
+int64_t stSingleNuclProbContainer_getReadNumber(stSingleNuclProbContainer *container);
+
+stProfileSeq *stSingleNuclProbContainer_getProfileSeq(stSingleNuclProbContainer *container, char *readId,
+                                                      stBaseMapper *baseMapper, stRPHmmParameters *params);
+
 void countIndels(uint32_t *cigar, uint32_t ncigar, int64_t *numInsertions, int64_t *numDeletions);
 
 // Verbosity for what's printed.  To add more verbose options, you need to update:
@@ -541,6 +755,8 @@ void writeVcfFragment(vcfFile *out, bcf_hdr_t *bcf_hdr, stGenomeFragment *gF, ch
 
 bcf_hdr_t* writeVcfHeader(vcfFile *out, stList *genomeFragments, char *referenceName);
 
+stList *orderReferenceNamesByFastaIndex(stList *referenceNames, char *referenceFastaFile);
+
 void writeParamFile(char *outputFilename, stRPHmmParameters *params);
 
 /*
@@ -640,14 +856,20 @@ void stReadHaplotypePartitionTable_add(stReadHaplotypePartitionTable *hpt, char
 void stReadHaplotypePartitionTable_destruct(stReadHaplotypePartitionTable *hpt);
 
 void populateReadHaplotypePartitionTable(stReadHaplotypePartitionTable *hpt, stGenomeFragment *gF, stRPHmm *hmm,
-                                         stList *path);
+                                         stList *path, bool invertHaplotypes);
+
+stHash *getReferenceNamesToSortedProfileSeqs(stList *profileSeqs, int64_t *maxLength);
+
+void populateReadHaplotypePartitionTableByScoring(stReadHaplotypePartitionTable *hpt, stGenomeFragment *gF,
+                                                  stHash *referenceNamesToSortedProfileSeqs, int64_t maxLength,
+                                                  stRPHmmParameters *params);
 
 // Output file writing methods
 void writeHaplotypedSam(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionTable *readHaplotypePartitions,
-                        char *marginPhaseTag);
+                        char *marginPhaseTag, stList *regionStrings);
 
 void writeSplitSams(char *bamInFile, char *bamOutBase, stReadHaplotypePartitionTable *readHaplotypePartitions,
-                    char *marginPhaseTag);
+                    char *marginPhaseTag, stList *regionStrings);
 
 void addProfileSeqIdsToSet(stSet *pSeqs, stSet *readIds);
 
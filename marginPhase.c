@@ -270,14 +270,25 @@ stList *prefilterReads(stList *profileSequences, int64_t *misses,
     return filteredProfileSequences;
 }
 
-stList *createHMMs(stList *profileSequences, stHash *referenceNamesToReferencePriors, stRPHmmParameters *params) {
+stList *createHMMs(stList *profileSequences, stHash *referenceNamesToReferencePriors, stRPHmmParameters *params,
+                   stList *clippedProfileSequences) {
     /*
      * Create the set of hmms that the forward-backward algorithm will eventually be run on.
+     * If reads are divided when creating the hmms the parts are added to clippedProfileSequences.
      */
 
     // Create the initial list of HMMs
     st_logInfo("> Creating read partitioning HMMs\n");
-    stList *hmms = getRPHmms(profileSequences, referenceNamesToReferencePriors, params);
+    stList *hmms;
+    if(params->preSplitReadsAtWeaklyLinkedSites) {
+        hmms = getRPHmmsSplitAtWeaklyLinkedSites(profileSequences, referenceNamesToReferencePriors, params,
+                                                 clippedProfileSequences);
+        st_logInfo("\tCreated %" PRIi64 " parts of reads divided between independent groups of reads\n",
+                   stList_length(clippedProfileSequences));
+    }
+    else {
+        hmms = getRPHmms(profileSequences, referenceNamesToReferencePriors, params);
+    }
     //////////////////// Should I add the Kernel Here? ///////////////////////////////
     st_logInfo("\tGot %" PRIi64 " hmms before splitting\n", stList_length(hmms));
 
@@ -309,6 +320,117 @@ stList *createHMMs(stList *profileSequences, stHash *referenceNamesToReferencePr
     return hmms;
 }
 
+stList *getPhasingChunks(stList *profileSequences, char *referenceFastaFile, int64_t chunkSize,
+                         int64_t chunkOverlap) {
+    /*
+     * Partitions the profile sequences by contig and, if chunkSize is greater than zero, each contig into
+     * chunks of chunkSize bases whose reads overlap by chunkOverlap bases on either side (see
+     * getProfileSeqChunks). The chunks are ordered by contig, following the order of the contigs in the fasta
+     * index of referenceFastaFile, and then by position.
+     */
+
+    // Group the profile sequences by contig
+    stHash *referenceNamesToProfileSeqs = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL,
+                                                            (void (*)(void *))stList_destruct);
+    stList *referenceNames = stList_construct();
+    for(int64_t i=0; i<stList_length(profileSequences); i++) {
+        stProfileSeq *pSeq = stList_get(profileSequences, i);
+        stList *contigProfileSeqs = stHash_search(referenceNamesToProfileSeqs, pSeq->referenceName);
+        if(contigProfileSeqs == NULL) {
+            contigProfileSeqs = stList_construct();
+            stHash_insert(referenceNamesToProfileSeqs, pSeq->referenceName, contigProfileSeqs);
+            stList_append(referenceNames, pSeq->referenceName);
+        }
+        stList_append(contigProfileSeqs, pSeq);
+    }
+    stList *orderedReferenceNames = orderReferenceNamesByFastaIndex(referenceNames, referenceFastaFile);
+
+    // Make the chunks of each contig
+    stList *chunks = stList_construct3(0, (void (*)(void *))stPhasingChunk_destruct);
+    for(int64_t i=0; i<stList_length(orderedReferenceNames); i++) {
+        char *referenceName = stList_get(orderedReferenceNames, i);
+        stList *contigProfileSeqs = stHash_search(referenceNamesToProfileSeqs, referenceName);
+        stList *contigChunks;
+        if(chunkSize > 0) {
+            contigChunks = getProfileSeqChunks(contigProfileSeqs, chunkSize, chunkOverlap);
+        }
+        else {
+            contigChunks = stList_construct3(0, (void (*)(void *))stList_destruct);
+            stList_append(contigChunks, stList_copy(contigProfileSeqs, NULL));
+        }
+
+        int64_t firstChunk = stList_length(chunks);
+        for(int64_t j=0; j<stList_length(contigChunks); j++) {
+            stList *chunkProfileSeqs = stList_get(contigChunks, j);
+            if(stList_length(chunkProfileSeqs) == 0) {
+                continue;
+            }
+            stList_append(chunks, stPhasingChunk_construct(referenceName, j * chunkSize, (j + 1) * chunkSize,
+                                                           chunkProfileSeqs));
+            stList_set(contigChunks, j, NULL);
+        }
+        ((stPhasingChunk *)stList_get(chunks, firstChunk))->chunkStart = INT64_MIN;
+        ((stPhasingChunk *)stList_peek(chunks))->chunkEnd = INT64_MAX;
+
+        stList_setDestructor(contigChunks, NULL);
+        for(int64_t j=0; j<stList_length(contigChunks); j++) {
+            if(stList_get(contigChunks, j) != NULL) {
+                stList_destruct(stList_get(contigChunks, j));
+            }
+        }
+        stList_destruct(contigChunks);
+    }
+
+    // Cleanup
+    stList_destruct(orderedReferenceNames);
+    stList_destruct(referenceNames);
+    stHash_destruct(referenceNamesToProfileSeqs);
+
+    return chunks;
+}
+
+stList *createHMMsByChunk(stList *chunks, stHash *referenceNamesToReferencePriors, stRPHmmParameters *params,
+                          stList *clippedProfileSequences) {
+    /*
+     * As createHMMs, but creates the hmms for each chunk (see getPhasingChunks) in parallel. The hmms are
+     * returned in chunk order, and the range of each chunk's hmms in the returned list is recorded in the chunk.
+     */
+
+    // Create the hmms for each chunk
+    int64_t chunkNumber = stList_length(chunks);
+    stList **chunkHmms = st_malloc(sizeof(stList *) * chunkNumber);
+    stList **chunkClippedProfileSeqs = st_malloc(sizeof(stList *) * chunkNumber);
+#if defined(_OPENMP)
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for(int64_t i=0; i<chunkNumber; i++) {
+        stPhasingChunk *chunk = stList_get(chunks, i);
+        chunkClippedProfileSeqs[i] = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+        chunkHmms[i] = createHMMs(chunk->profileSeqs, referenceNamesToReferencePriors, params,
+                                  chunkClippedProfileSeqs[i]);
+    }
+
+    // Concatenate the hmms and clipped profile sequences in chunk order
+    stList *hmms = stList_construct3(0, (void (*)(void *))stRPHmm_destruct2);
+    for(int64_t i=0; i<chunkNumber; i++) {
+        stPhasingChunk *chunk = stList_get(chunks, i);
+        chunk->firstHmm = stList_length(hmms);
+        chunk->hmmNumber = stList_length(chunkHmms[i]);
+        stList_appendAll(hmms, chunkHmms[i]);
+        stList_setDestructor(chunkHmms[i], NULL);
+        stList_destruct(chunkHmms[i]);
+        stList_appendAll(clippedProfileSequences, chunkClippedProfileSeqs[i]);
+        stList_setDestructor(chunkClippedProfileSeqs[i], NULL);
+        stList_destruct(chunkClippedProfileSeqs[i]);
+    }
+
+    // Cleanup
+    free(chunkHmms);
+    free(chunkClippedProfileSeqs);
+
+    return hmms;
+}
+
 void logHmm(stRPHmm *hmm, stSet *reads1, stSet *reads2, stGenomeFragment *gF) {
     /*
      * Print debug-level logging information about an HMM and associated genome fragment.
@@ -374,9 +496,9 @@ void usage() {
     fprintf(stderr, "    2) a SAM file where each read is annotated with haplotype information\n");
 
     fprintf(stderr, "\nRequired arguments:\n");
-    fprintf(stderr, "    BAM is the alignment of reads.  All reads must be aligned to the same contig \n");
-    fprintf(stderr, "        and be in bam format.\n");
-    fprintf(stderr, "    REFERENCE_FASTA is the reference sequence for the BAM's contig in fasta format.\n");
+    fprintf(stderr, "    BAM is the alignment of reads in bam format.  Reads may be aligned to any number \n");
+    fprintf(stderr, "        of contigs, which are phased in parallel.\n");
+    fprintf(stderr, "    REFERENCE_FASTA is the reference sequence for the BAM's contigs in fasta format.\n");
     fprintf(stderr, "    PARAMS is the file with marginPhase parameters.\n");
 
     fprintf(stderr, "\nDefault options:\n");
@@ -386,9 +508,24 @@ void usage() {
     fprintf(stderr, "    -a --logLevel          : Set the log level [default = info]\n");
     fprintf(stderr, "    -t --tag               : Annotate all output reads with this value for the \n");
     fprintf(stderr, "                               '"MARGIN_PHASE_TAG"' tag\n");
+    fprintf(stderr, "    -T --threads           : Number of threads shared by all BAM and VCF compression and \n");
+    fprintf(stderr, "                               decompression [default = 1]\n");
+
+    fprintf(stderr, "\nRegion options:\n");
+    fprintf(stderr, "    -R --region            : Only phase the reads in this region (chr:start-end), read using\n");
+    fprintf(stderr, "                               the BAM index, clipping reads to it. May be repeated\n");
+    fprintf(stderr, "    -B --regionBed         : Only phase the reads in the regions of this BED file\n");
+
+    fprintf(stderr, "\nChunking options:\n");
+    fprintf(stderr, "    -c --chunkSize         : Phase each contig in chunks of this many bases on worker threads,\n");
+    fprintf(stderr, "                               stitching adjacent phase blocks using the reads they share\n");
+    fprintf(stderr, "                               [default = 0, contigs are not chunked]\n");
+    fprintf(stderr, "    -C --chunkOverlap      : Extend each chunk by this many bases either side when selecting\n");
+    fprintf(stderr, "                               the reads to phase it with [default = 5000]\n");
 
     fprintf(stderr, "\nNucleotide probabilities options:\n");
-    fprintf(stderr, "    -s --singleNuclProbDir : Directory of single nucleotide probabilities files\n");
+    fprintf(stderr, "    -s --singleNuclProbDir : Directory of single nucleotide probabilities files, or a single\n");
+    fprintf(stderr, "                               container file of them made by packSingleNuclProbs\n");
     fprintf(stderr, "    -S --onlySNP           : Use only single nucleotide probabilities information,\n");
     fprintf(stderr, "                               so reads that aren't in SNP dir are discarded\n");
 
@@ -415,6 +552,10 @@ int main(int argc, char *argv[]) {
     char *outputBase = "output";
     int64_t verboseBitstring = -1;
     bool onlySNP = false;
+    int64_t chunkSize = 0;
+    int64_t htslibThreads = 1;
+    stList *regions = stList_construct3(0, free);
+    int64_t chunkOverlap = 5000;
 
     // TODO: When done testing, optionally set random seed using st_randomSeed();
 
@@ -438,10 +579,15 @@ int main(int argc, char *argv[]) {
                 { "singleNuclProbDir", required_argument, 0, 's'},
                 { "onlySNP", no_argument, 0, 'S'},
                 { "verbose", required_argument, 0, 'v'},
+                { "threads", required_argument, 0, 'T'},
+                { "region", required_argument, 0, 'R'},
+                { "regionBed", required_argument, 0, 'B'},
+                { "chunkSize", required_argument, 0, 'c'},
+                { "chunkOverlap", required_argument, 0, 'C'},
                 { 0, 0, 0, 0 } };
 
         int option_index = 0;
-        int key = getopt_long(argc-2, &argv[2], "a:o:v:r:s:hS", long_options, &option_index);
+        int key = getopt_long(argc-2, &argv[2], "a:o:v:r:s:T:R:B:c:C:hS", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -476,6 +622,34 @@ int main(int argc, char *argv[]) {
         case 'v':
             verboseBitstring = atoi(optarg);
             break;
+        case 'T':
+            htslibThreads = atol(optarg);
+            if (htslibThreads < 1) {
+                st_errAbort("Number of threads must be positive: %s\n", optarg);
+            }
+            break;
+        case 'R':
+            stList_append(regions, stString_copy(optarg));
+            break;
+        case 'B': {
+            stList *bedRegions = parseRegionsFromBed(optarg);
+            stList_appendAll(regions, bedRegions);
+            stList_setDestructor(bedRegions, NULL);
+            stList_destruct(bedRegions);
+            break;
+        }
+        case 'c':
+            chunkSize = atol(optarg);
+            if (chunkSize < 0) {
+                st_errAbort("Chunk size must be non-negative: %s\n", optarg);
+            }
+            break;
+        case 'C':
+            chunkOverlap = atol(optarg);
+            if (chunkOverlap < 0) {
+                st_errAbort("Chunk overlap must be non-negative: %s\n", optarg);
+            }
+            break;
         default:
             usage();
             return 0;
@@ -485,6 +659,7 @@ int main(int argc, char *argv[]) {
     // Initialization from arguments
     st_setLogLevelFromString(logLevelString);
     free(logLevelString);
+    htslibThreadPool_construct(htslibThreads);
 
     // Output file names
     char *vcfOutFile = stString_print("%s.vcf", outputBase);
@@ -506,12 +681,9 @@ int main(int argc, char *argv[]) {
     st_logInfo("> Parsing input reads from file: %s\n", bamInFile);
     stList *profileSequences = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
     int64_t readCount = 0;
-    if (singleNucleotideProbabilityDirectory == NULL) {
-        readCount = parseReads(profileSequences, bamInFile, baseMapper, params);
-    } else {
-        readCount = parseReadsWithSingleNucleotideProbs(profileSequences, bamInFile, baseMapper, params,
-                                                        singleNucleotideProbabilityDirectory, onlySNP);
-    }
+    readCount = parseReadsInRegions(profileSequences, bamInFile, baseMapper, params,
+                                    singleNucleotideProbabilityDirectory, onlySNP,
+                                    stList_length(regions) > 0 ? regions : NULL);
     st_logInfo("\tCreated %d profile sequences\n", readCount);
 
     // Print some stats about the input sequences
@@ -567,7 +739,11 @@ int main(int argc, char *argv[]) {
                        " to achieve maximum coverage depth of %" PRIi64 "\n",
                stList_length(discardedProfileSeqs), stList_length(profileSequences),
                params->maxCoverageDepth);
-    stList_destruct(discardedProfileSeqs);
+    if(params->ensembleSubsampleNumber <= 1) {
+        // The discarded reads are only kept to be phased as an ensemble
+        stList_destruct(discardedProfileSeqs);
+        discardedProfileSeqs = NULL;
+    }
     stList_setDestructor(profileSequences, NULL);
     stList_destruct(profileSequences);
     profileSequences = filteredProfileSeqs;
@@ -604,8 +780,28 @@ int main(int argc, char *argv[]) {
         writeParamFile(paramsOutFile, params);
     }
 
+    // Phase sub-samples of the discarded reads in parallel, to reconcile with the primary genome fragments
+    stList *ensembleGenomeFragments = NULL;
+    if(discardedProfileSeqs != NULL && stList_length(discardedProfileSeqs) > 0) {
+        st_logInfo("> Phasing an ensemble of up to %" PRIi64 " sub-samples of the discarded reads\n",
+                   params->ensembleSubsampleNumber - 1);
+        stList *remainingProfileSeqs = stList_construct();
+        stList *subsamples = getCoverageDepthBoundedSubsamples(discardedProfileSeqs, referenceNamesToReferencePriors,
+                                                               params, params->ensembleSubsampleNumber - 1,
+                                                               remainingProfileSeqs);
+        ensembleGenomeFragments = getEnsembleGenomeFragments(subsamples, referenceNamesToReferencePriors, params);
+        st_logInfo("\tGot %" PRIi64 " genome fragments from %" PRIi64 " sub-samples, leaving %" PRIi64
+                   " reads to be assigned to haplotypes only\n", stList_length(ensembleGenomeFragments),
+                   stList_length(subsamples), stList_length(remainingProfileSeqs));
+        stList_destruct(subsamples);
+        stList_destruct(remainingProfileSeqs);
+    }
+
     // Get the final list of hmms
-    stList *hmms = createHMMs(profileSequences, referenceNamesToReferencePriors, params);
+    stList *clippedProfileSequences = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+    stList *chunks = getPhasingChunks(profileSequences, referenceFastaFile, chunkSize, chunkOverlap);
+    st_logInfo("> Phasing reads in %" PRIi64 " chunks\n", stList_length(chunks));
+    stList *hmms = createHMMsByChunk(chunks, referenceNamesToReferencePriors, params, clippedProfileSequences);
 
     //////////////////////////////New Code////////////////////////////////
     // getExpectedInstanceNumber Kernel
@@ -618,18 +814,18 @@ int main(int argc, char *argv[]) {
     stRPColumn *column = hmm->firstColumn;
     while (column->nColumn != NULL){
         uint64_t depth = column->depth;
-	uint64_t *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth, column->activePositions, column->totalActivePositions);
+	stRPPartition *bitCountVectors = calculateCountBitVectors(column->seqs, column->depth, column->activePositions, column->totalActivePositions, column->activePositionsOffset);
 	// For all cells in the column
 	stRPCell *cell = column->head;
 	while(cell != NULL) {	
-		uint64_t partition = cell->partition;
+		stRPPartition partition = cell->partition;
 		for(uint64_t position=0; position<column->length; position++) { 
 			for (int64_t characterIndex = 0; characterIndex < 255; characterIndex++){
-				uint64_t *j = retrieveBitCountVector(bitCountVectors, position, characterIndex, 0);
-				uint64_t expectedCount = popcount64(j[0] & partition);
+				stRPPartition *j = retrieveBitCountVector(bitCountVectors, position, characterIndex, 0);
+				uint64_t expectedCount = popcountPartition(j[0] & partition);
 
 				for(int64_t i=1; i<ALPHABET_CHARACTER_BITS; i++) {
-					expectedCount += (popcount64(j[i] & partition) << i);
+					expectedCount += (popcountPartition(j[i] & partition) << i);
 				}
 				assert(expectedCount >= 0.0);
 				assert((double)expectedCount / ALPHABET_MAX_PROB <= depth);
@@ -660,61 +856,202 @@ int main(int argc, char *argv[]) {
 
     // Start VCF generation
     vcfFile *vcfOutFP = vcf_open(vcfOutFile, "w");
+    htslibThreadPool_attach(vcfOutFP);
     bcf_hdr_t *hdr = writeVcfHeader(vcfOutFP, hmms, referenceFastaFile);
     vcfFile *vcfOutFP_all;
     bcf_hdr_t *hdr2;
     if (params->writeGVCF) {
         // Write gVCF if specified to
         vcfOutFP_all = vcf_open(vcfOutFile_all, "w");
+        htslibThreadPool_attach(vcfOutFP_all);
         hdr2 = writeVcfHeader(vcfOutFP_all, hmms, referenceFastaFile);
     }
 
-    // For each read partitioning HMM
-    for(int64_t i=0; i<stList_length(hmms); i++) {
-        stRPHmm *hmm = stList_get(hmms, i);
+    // Group the chunks by contig, noting the last hmm of each contig, after which the contig can be output
+    int64_t hmmNumber = stList_length(hmms);
+    stList *contigs = stList_construct3(0, (void (*)(void *))stList_destruct);
+    stList **contigsEndingAtHmm = st_calloc(hmmNumber, sizeof(stList *));
+    for(int64_t i=0; i<stList_length(chunks); i++) {
+        stPhasingChunk *chunk = stList_get(chunks, i);
+        stList *contigChunks = stList_length(contigs) > 0 ? stList_peek(contigs) : NULL;
+        if(contigChunks == NULL ||
+           strcmp(((stPhasingChunk *)stList_peek(contigChunks))->referenceName, chunk->referenceName) != 0) {
+            contigChunks = stList_construct();
+            stList_append(contigs, contigChunks);
+        }
+        stList_append(contigChunks, chunk);
+    }
+    for(int64_t i=0; i<stList_length(contigs); i++) {
+        stList *contigChunks = stList_get(contigs, i);
+        int64_t lastHmm = -1;
+        for(int64_t j=0; j<stList_length(contigChunks); j++) {
+            stPhasingChunk *chunk = stList_get(contigChunks, j);
+            if(chunk->hmmNumber > 0) {
+                lastHmm = chunk->firstHmm + chunk->hmmNumber - 1;
+            }
+        }
+        if(lastHmm >= 0) {
+            contigsEndingAtHmm[lastHmm] = contigChunks;
+        }
+    }
 
-        // Run the forward-backward algorithm
-        stRPHmm_forwardBackward(hmm);
+    // Bucket the discarded reads by contig and position once, to assign them to the phase blocks
+    stHash *referenceNamesToDiscardedProfileSeqs = NULL;
+    int64_t maxDiscardedLength = 0;
+    if(ensembleGenomeFragments != NULL) {
+        referenceNamesToDiscardedProfileSeqs = getReferenceNamesToSortedProfileSeqs(discardedProfileSeqs,
+                                                                                    &maxDiscardedLength);
+    }
 
-        // Now compute a high probability path through the hmm
-        stList *path = stRPHmm_forwardTraceBack(hmm);
+    // Phase each read partitioning HMM in parallel. Once every hmm of a contig is phased, in order, its genome
+    // fragments are combined into phase blocks and output, and the results for its hmms are freed
+    stList **paths = st_malloc(sizeof(stList *) * hmmNumber);
+    stGenomeFragment **gFs = st_malloc(sizeof(stGenomeFragment *) * hmmNumber);
+    stSet **reads1s = st_malloc(sizeof(stSet *) * hmmNumber);
+    stSet **reads2s = st_malloc(sizeof(stSet *) * hmmNumber);
+    int64_t *blockStarts = st_malloc(sizeof(int64_t) * hmmNumber);
+    int64_t *blockEnds = st_malloc(sizeof(int64_t) * hmmNumber);
+    bool *stitched = st_malloc(sizeof(bool) * hmmNumber);
+    bool *inverted = st_malloc(sizeof(bool) * hmmNumber);
+    int64_t blockNumber = 0, stitchedBoundaries = 0, firstUnwrittenHmm = 0;
+#if defined(_OPENMP)
+    #pragma omp parallel for schedule(dynamic) ordered
+#endif
+    for(int64_t h=0; h<hmmNumber; h++) {
+        stRPHmm *hmm = stList_get(hmms, h);
+
+        // Run the forward-backward algorithm and compute a high probability path through the hmm,
+        // reusing the path computed when the hmm was split if possible
+        paths[h] = stRPHmm_forwardBackwardTraceBack(hmm);
 
         // Compute the genome fragment
-        stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
-        totalGFlength += gF->length;
+        gFs[h] = stGenomeFragment_construct(hmm, paths[h]);
 
         // Get the reads which mapped to each path
-        stSet *reads1 = stRPHmm_partitionSequencesByStatePath(hmm, path, true);
-        stSet *reads2 = stRPHmm_partitionSequencesByStatePath(hmm, path, false);
+        reads1s[h] = stRPHmm_partitionSequencesByStatePath(hmm, paths[h], true);
+        reads2s[h] = stRPHmm_partitionSequencesByStatePath(hmm, paths[h], false);
 
         // Only one haplotype found (likely a small set of reads)
-        if (stSet_size(reads1) < 1 || stSet_size(reads2) < 1) {
-            populateReadHaplotypePartitionTable(readHaplotypePartitions, gF, hmm, path);
-            continue;
-        }
+        if (stSet_size(reads1s[h]) > 0 && stSet_size(reads2s[h]) > 0) {
+            // Refine the genome fragment by repartitoning the reads iteratively
+            if(params->roundsOfIterativeRefinement > 0) {
+                stGenomeFragment_refineGenomeFragment(gFs[h], reads1s[h], reads2s[h], hmm, paths[h],
+                                                      params->roundsOfIterativeRefinement);
+            }
 
-        // Refine the genome fragment by repartitoning the reads iteratively
-        if(params->roundsOfIterativeRefinement > 0) {
-            stGenomeFragment_refineGenomeFragment(gF, reads1, reads2, hmm, path, params->roundsOfIterativeRefinement);
+            // Reconcile the genome fragment with the consensus of the ensemble
+            if(ensembleGenomeFragments != NULL) {
+                stGenomeFragment_reconcileWithEnsemble(gFs[h], hmm, paths[h], ensembleGenomeFragments);
+            }
         }
 
-        // save bipartition
-        populateReadHaplotypePartitionTable(readHaplotypePartitions, gF, hmm, path);
-
-        // Log information about the hmm
-        logHmm(hmm, reads1, reads2, gF);
+#if defined(_OPENMP)
+        #pragma omp ordered
+#endif
+        if(contigsEndingAtHmm[h] != NULL) {
+            // Combine the genome fragments of adjacent chunks of the contig into phase blocks
+            stitchedBoundaries += stitchChunkPhaseBlocks(contigsEndingAtHmm[h], gFs, reads1s, reads2s,
+                                                         blockStarts, blockEnds, stitched, inverted);
+
+            // For each phase block of the contig, in position order
+            for(int64_t i=firstUnwrittenHmm; i<=h;) {
+                // Skip genome fragments that lie within the part of a neighbouring chunk
+                if(blockStarts[i] >= blockEnds[i]) {
+                    i++;
+                    continue;
+                }
+
+                // Get the genome fragments of the phase block
+                int64_t j = i+1;
+                bool twoHaplotypes = stSet_size(reads1s[i]) > 0 && stSet_size(reads2s[i]) > 0;
+                int64_t blockEnd = blockEnds[i];
+                while(j <= h && (blockStarts[j] >= blockEnds[j] || stitched[j])) {
+                    if(blockStarts[j] < blockEnds[j]) {
+                        twoHaplotypes = twoHaplotypes || (stSet_size(reads1s[j]) > 0 && stSet_size(reads2s[j]) > 0);
+                        blockEnd = blockEnds[j];
+                    }
+                    j++;
+                }
+
+                // Use the genome fragment directly unless it is clipped or stitched
+                stGenomeFragment *gF = gFs[i];
+                if(j > i+1 || blockStarts[i] != gF->refStart || blockEnds[i] != gF->refStart + gF->length) {
+                    gF = stGenomeFragment_constructEmpty(gFs[i]->referenceName, blockStarts[i],
+                                                         blockEnd - blockStarts[i]);
+                    for(int64_t k=i; k<j; k++) {
+                        if(blockStarts[k] < blockEnds[k]) {
+                            stGenomeFragment_copyInterval(gF, gFs[k], blockStarts[k], blockEnds[k], inverted[k]);
+                        }
+                    }
+                }
+                totalGFlength += gF->length;
+                blockNumber++;
+
+                // save bipartition
+                for(int64_t k=i; k<j; k++) {
+                    if(blockStarts[k] < blockEnds[k]) {
+                        populateReadHaplotypePartitionTable(readHaplotypePartitions, gF, stList_get(hmms, k),
+                                                            paths[k], inverted[k]);
+                    }
+                }
+
+                // Only one haplotype found, so there is nothing further to output
+                if (twoHaplotypes) {
+                    // Assign the discarded reads
+                    if(ensembleGenomeFragments != NULL) {
+                        populateReadHaplotypePartitionTableByScoring(readHaplotypePartitions, gF,
+                                                                     referenceNamesToDiscardedProfileSeqs,
+                                                                     maxDiscardedLength, params);
+                    }
+
+                    // Log information about the hmms
+                    for(int64_t k=i; k<j; k++) {
+                        if(blockStarts[k] < blockEnds[k]) {
+                            logHmm(stList_get(hmms, k), reads1s[k], reads2s[k], gFs[k]);
+                        }
+                    }
+
+                    // Write two vcfs, one using the reference fasta file and one not
+                    writeVcfFragment(vcfOutFP, hdr, gF, referenceFastaFile, baseMapper, false);
+                    if (params->writeGVCF) {
+                        writeVcfFragment(vcfOutFP_all, hdr2, gF, referenceFastaFile, baseMapper, true);
+                    }
+                }
+
+                // Cleanup
+                if(gF != gFs[i]) {
+                    stGenomeFragment_destruct(gF);
+                }
+                i = j;
+            }
 
-        // Write two vcfs, one using the reference fasta file and one not
-        writeVcfFragment(vcfOutFP, hdr, gF, referenceFastaFile, baseMapper, false);
-        if (params->writeGVCF) {
-            writeVcfFragment(vcfOutFP_all, hdr2, gF, referenceFastaFile, baseMapper, true);
+            // Free the results for the contig's hmms
+            for(int64_t i=firstUnwrittenHmm; i<=h; i++) {
+                stGenomeFragment_destruct(gFs[i]);
+                stSet_destruct(reads1s[i]);
+                stSet_destruct(reads2s[i]);
+                stList_destruct(paths[i]);
+            }
+            firstUnwrittenHmm = h+1;
         }
+    }
+    if(stList_length(chunks) > 1) {
+        st_logInfo("\tStitched %" PRIi64 " phase blocks across chunk boundaries\n", stitchedBoundaries);
+    }
 
-        // Cleanup
-        stGenomeFragment_destruct(gF);
-        stSet_destruct(reads1);
-        stSet_destruct(reads2);
-        stList_destruct(path);
+    // Cleanup
+    free(blockStarts);
+    free(blockEnds);
+    free(stitched);
+    free(inverted);
+    free(paths);
+    free(gFs);
+    free(reads1s);
+    free(reads2s);
+    free(contigsEndingAtHmm);
+    stList_destruct(contigs);
+    if(referenceNamesToDiscardedProfileSeqs != NULL) {
+        stHash_destruct(referenceNamesToDiscardedProfileSeqs);
     }
 
     // Cleanup vcf
@@ -728,8 +1065,8 @@ int main(int argc, char *argv[]) {
     // Write out VCF
     st_logInfo("\n\tFinished writing out VCF into file: %s\n", vcfOutFile);
 
-    st_logInfo("\n> There were a total of %d genome fragments. Average length = %f\n", stList_length(hmms),
-               (float) totalGFlength / stList_length(hmms));
+    st_logInfo("\n> There were a total of %" PRIi64 " genome fragments. Average length = %f\n", blockNumber,
+               (float) totalGFlength / blockNumber);
 
     // do comparison if referenceVCF is specified
     if (referenceVCF != NULL) {
@@ -749,17 +1086,29 @@ int main(int argc, char *argv[]) {
     if (params->writeSplitSams) {
         st_logInfo("\tWriting out SAM files for each partition\n", outputBase,
                    outputBase);
-        writeSplitSams(bamInFile, outputBase, readHaplotypePartitions, marginPhaseTag);
+        writeSplitSams(bamInFile, outputBase, readHaplotypePartitions, marginPhaseTag,
+                       stList_length(regions) > 0 ? regions : NULL);
     }
     if (params->writeUnifiedSam) {
         st_logInfo("\tWriting out single SAM file with read partitioning\n", outputBase,
                    outputBase);
-        writeHaplotypedSam(bamInFile, outputBase, readHaplotypePartitions, marginPhaseTag);
+        writeHaplotypedSam(bamInFile, outputBase, readHaplotypePartitions, marginPhaseTag,
+                           stList_length(regions) > 0 ? regions : NULL);
     }
 
     stList_destruct(profileSequences);
+    stList_destruct(clippedProfileSequences);
+    if(discardedProfileSeqs != NULL) {
+        stList_destruct(discardedProfileSeqs);
+    }
+    if(ensembleGenomeFragments != NULL) {
+        stList_destruct(ensembleGenomeFragments);
+    }
     stReadHaplotypePartitionTable_destruct(readHaplotypePartitions);
     stList_destruct(hmms);
+    stList_destruct(chunks);
+    stList_destruct(regions);
+    htslibThreadPool_destruct();
 
     stBaseMapper_destruct(baseMapper);
     stRPHmmParameters_destruct(params);
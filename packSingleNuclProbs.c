@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include "stRPHmm.h"
+
+void usage() {
+    fprintf(stderr, "packSingleNuclProbs [options] -d SINGLE_NUCL_PROB_DIR -o CONTAINER_FILE\n");
+    fprintf(stderr,
+            "Packs the single nucleotide probability files (${readId}.tsv) of SINGLE_NUCL_PROB_DIR into\n"
+                    "CONTAINER_FILE, a single indexed file that can be given to marginPhase in place of the\n"
+                    "directory with --singleNuclProbDir\n"
+    );
+    fprintf(stderr, "-h --help : Print this help screen\n");
+    fprintf(stderr, "-a --logLevel : Set the log level\n");
+    fprintf(stderr, "-d --singleNuclProbDir : Directory of single nucleotide probabilities files\n");
+    fprintf(stderr, "-o --output : Container file to write\n");
+}
+
+int main(int argc, char *argv[]) {
+    /*
+     * Converts a directory of single nucleotide probability files into a container file.
+     */
+    // Parameters / arguments
+    char *logLevelString = stString_copy("info");
+    char *singleNuclProbDir = NULL;
+    char *containerFile = NULL;
+
+    // Parse the options
+    while (1) {
+        static struct option long_options[] = {
+                { "logLevel", required_argument, 0, 'a' },
+                { "help", no_argument, 0, 'h' },
+                { "singleNuclProbDir", required_argument, 0, 'd'},
+                { "output", required_argument, 0, 'o'},
+                { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+
+        int key = getopt_long(argc, argv, "a:d:o:h", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+            case 'a':
+                free(logLevelString);
+                logLevelString = stString_copy(optarg);
+                break;
+            case 'h':
+                usage();
+                return 0;
+            case 'd':
+                free(singleNuclProbDir);
+                singleNuclProbDir = stString_copy(optarg);
+                break;
+            case 'o':
+                free(containerFile);
+                containerFile = stString_copy(optarg);
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+    st_setLogLevelFromString(logLevelString);
+    free(logLevelString);
+
+    if (singleNuclProbDir == NULL || containerFile == NULL) {
+        usage();
+        return 1;
+    }
+
+    st_logInfo("> Packing single nucleotide probability files in %s into %s\n", singleNuclProbDir, containerFile);
+    int64_t readNumber = writeSingleNuclProbContainer(singleNuclProbDir, containerFile);
+    st_logInfo("\tPacked %" PRIi64 " reads\n", readNumber);
+
+    free(singleNuclProbDir);
+    free(containerFile);
+
+    return 0;
+}
@@ -6,6 +6,8 @@
 
 
 #include <htslib/vcf.h>
+#include <htslib/sam.h>
+#include <htslib/faidx.h>
 #include "CuTest.h"
 #include "sonLib.h"
 
@@ -118,6 +120,241 @@ void test_100kbGenotyping_nanopore(CuTest *testCase) {
     CuAssertTrue(testCase, i == 0);
 }
 
+/*
+ * Checks that the records of a vcf file are ordered by contig, as the contigs of its header, which must be those
+ * given, and then by position. Sets recordNumbers to the number of records of each contig.
+ */
+static void checkVcfRecordOrder(CuTest *testCase, char *vcfFileName, char **contigs, int64_t contigNumber,
+                                int64_t *recordNumbers) {
+    vcfFile *in = vcf_open(vcfFileName, "r");
+    CuAssertTrue(testCase, in != NULL);
+    bcf_hdr_t *hdr = bcf_hdr_read(in);
+
+    // The header contigs
+    int headerContigNumber;
+    const char **headerContigs = bcf_hdr_seqnames(hdr, &headerContigNumber);
+    CuAssertIntEquals(testCase, contigNumber, headerContigNumber);
+    for (int64_t i = 0; i < contigNumber; i++) {
+        CuAssertStrEquals(testCase, contigs[i], headerContigs[i]);
+        recordNumbers[i] = 0;
+    }
+    free(headerContigs);
+
+    // The records
+    bcf1_t *rec = bcf_init();
+    int64_t previousContig = -1, previousPos = -1;
+    while (bcf_read(in, hdr, rec) == 0) {
+        CuAssertTrue(testCase, rec->rid >= 0 && rec->rid < contigNumber);
+        CuAssertTrue(testCase, rec->rid > previousContig || (rec->rid == previousContig && rec->pos >= previousPos));
+        previousContig = rec->rid;
+        previousPos = rec->pos;
+        recordNumbers[rec->rid]++;
+    }
+
+    bcf_destroy(rec);
+    bcf_hdr_destroy(hdr);
+    vcf_close(in);
+}
+
+/*
+ * Gets the genotypes of the records of a vcf file, as a map from the position of each record to its alleles,
+ * unordered, so that genotypes given in different phases are equal.
+ */
+static stHash *getVcfGenotypes(CuTest *testCase, char *vcfFileName) {
+    vcfFile *in = vcf_open(vcfFileName, "r");
+    CuAssertTrue(testCase, in != NULL);
+    bcf_hdr_t *hdr = bcf_hdr_read(in);
+
+    stHash *genotypes = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, free, free);
+    bcf1_t *rec = bcf_init();
+    int32_t *gt = NULL;
+    int gtNumber = 0;
+    while (bcf_read(in, hdr, rec) == 0) {
+        bcf_unpack(rec, BCF_UN_ALL);
+        CuAssertIntEquals(testCase, 2, bcf_get_genotypes(hdr, rec, &gt, &gtNumber));
+        char *allele1 = rec->d.allele[bcf_gt_allele(gt[0])];
+        char *allele2 = rec->d.allele[bcf_gt_allele(gt[1])];
+        if (strcmp(allele1, allele2) > 0) {
+            char *allele = allele1;
+            allele1 = allele2;
+            allele2 = allele;
+        }
+        stHash_insert(genotypes, stString_print("%s:%" PRIi64, bcf_hdr_id2name(hdr, rec->rid), (int64_t) rec->pos),
+                      stString_print("%s/%s", allele1, allele2));
+    }
+
+    free(gt);
+    bcf_destroy(rec);
+    bcf_hdr_destroy(hdr);
+    vcf_close(in);
+    return genotypes;
+}
+
+/*
+ * Test that the output for reads aligned to several contigs follows the order of the contigs in the reference
+ * fasta index. The reads of the 5kb region are aligned to two copies of the part of the reference they cover,
+ * which are given in opposite orders in the bam header and the fasta file.
+ */
+void test_multipleContigGenotyping(CuTest *testCase) {
+
+    char *paramsFile = "../params/params.pacbio.json";
+    char *referenceFile = "../tests/hg19.chr3.9mb.fa";
+    char *bamFile = "../tests/NA12878.pb.chr3.5kb.bam";
+    char *outputBase = "test_multipleContigs";
+    char *contigBamFile = "test_multipleContigs.bam";
+    char *contigReferenceFile = "test_multipleContigs.fa";
+    char *contigs[] = { "contigB", "contigA" }; // In fasta order, the reverse of the bam order
+
+    st_logInfo("\n\nTesting haplotype inference on %s aligned to two contigs\n", bamFile);
+
+    // Read the mapped alignments
+    samFile *in = sam_open(bamFile, "r");
+    bam_hdr_t *bamHdr = sam_hdr_read(in);
+    stList *alignments = stList_construct3(0, (void (*)(void *))bam_destroy1);
+    bam1_t *aln = bam_init1();
+    int64_t start = INT64_MAX, end = 0;
+    char *referenceName = NULL;
+    while (sam_read1(in, bamHdr, aln) >= 0) {
+        if (aln->core.tid < 0 || (aln->core.flag & BAM_FUNMAP)) {
+            continue;
+        }
+        referenceName = bamHdr->target_name[aln->core.tid];
+        start = aln->core.pos < start ? aln->core.pos : start;
+        end = bam_endpos(aln) > end ? bam_endpos(aln) : end;
+        stList_append(alignments, bam_dup1(aln));
+    }
+    CuAssertTrue(testCase, stList_length(alignments) > 0);
+
+    // Write the part of the reference covered by the reads as each of the contigs
+    int64_t offset = start > 1000 ? start - 1000 : 0;
+    faidx_t *fai = fai_load(referenceFile);
+    CuAssertTrue(testCase, fai != NULL);
+    int length;
+    char *seq = faidx_fetch_seq(fai, referenceName, offset, end + 1000, &length);
+    CuAssertTrue(testCase, seq != NULL);
+    FILE *fp = fopen(contigReferenceFile, "w");
+    for (int64_t i = 0; i < 2; i++) {
+        fprintf(fp, ">%s\n%s\n", contigs[i], seq);
+    }
+    fclose(fp);
+    CuAssertIntEquals(testCase, 0, fai_build(contigReferenceFile));
+
+    // Write the alignments to each of the contigs, in the reverse of the fasta order
+    bam_hdr_t *contigHdr = bam_hdr_init();
+    contigHdr->n_targets = 2;
+    contigHdr->target_len = st_malloc(sizeof(uint32_t) * 2);
+    contigHdr->target_name = st_malloc(sizeof(char *) * 2);
+    for (int64_t i = 0; i < 2; i++) {
+        contigHdr->target_name[i] = stString_copy(contigs[1 - i]);
+        contigHdr->target_len[i] = (uint32_t) length;
+    }
+    contigHdr->text = stString_print("@HD\tVN:1.3\tSO:coordinate\n@SQ\tSN:%s\tLN:%d\n@SQ\tSN:%s\tLN:%d\n",
+                                     contigs[1], length, contigs[0], length);
+    contigHdr->l_text = strlen(contigHdr->text);
+    samFile *out = sam_open(contigBamFile, "wb");
+    CuAssertIntEquals(testCase, 0, sam_hdr_write(out, contigHdr));
+    for (int64_t i = 0; i < stList_length(alignments); i++) {
+        bam1_t *contigAln = stList_get(alignments, i);
+        contigAln->core.pos -= offset;
+        contigAln->core.mtid = -1;
+        contigAln->core.mpos = -1;
+    }
+    for (int32_t tid = 0; tid < 2; tid++) {
+        for (int64_t i = 0; i < stList_length(alignments); i++) {
+            bam1_t *contigAln = stList_get(alignments, i);
+            contigAln->core.tid = tid;
+            CuAssertTrue(testCase, sam_write1(out, contigHdr, contigAln) >= 0);
+        }
+    }
+    sam_close(out);
+
+    // Run margin phase
+    char *command = stString_print("./marginPhase %s %s %s --outputBase %s --logLevel INFO",
+                                   contigBamFile, contigReferenceFile, paramsFile, outputBase);
+    st_logInfo("> Running command: %s\n", command);
+    CuAssertIntEquals(testCase, 0, st_system(command));
+
+    // Both contigs are phased, and output in fasta order
+    char *vcfOutFile = stString_print("%s.vcf", outputBase);
+    int64_t recordNumbers[2];
+    checkVcfRecordOrder(testCase, vcfOutFile, contigs, 2, recordNumbers);
+    CuAssertTrue(testCase, recordNumbers[0] > 0);
+    CuAssertTrue(testCase, recordNumbers[1] > 0);
+
+    // cleanup
+    free(vcfOutFile);
+    free(command);
+    bam_hdr_destroy(contigHdr);
+    free(seq);
+    fai_destroy(fai);
+    bam_destroy1(aln);
+    bam_hdr_destroy(bamHdr);
+    sam_close(in);
+    stList_destruct(alignments);
+}
+
+/*
+ * Test for a 5kb region phased in chunks, which are smaller than many of the reads so that the hmm of each chunk
+ * includes reads that lie wholly outside its part of the phase blocks. The genotypes called should be close to
+ * those called phasing the region whole.
+ */
+void test_5kbGenotyping_chunked(CuTest *testCase) {
+
+    char *paramsFile = "../params/params.pacbio.json";
+    char *referenceFile = "../tests/hg19.chr3.9mb.fa";
+    char *outputBase = "test_5kb_chunked";
+    char *unchunkedOutputBase = "test_5kb_unchunked";
+    char *bamFile = "../tests/NA12878.pb.chr3.5kb.bam";
+    char *vcfReference = "../tests/NA12878.PG.chr3.100kb.0.vcf";
+
+    st_logInfo("\n\nTesting haplotype inference on %s in chunks\n", bamFile);
+
+    // Phase the region whole
+    int64_t i = genotypingTest(paramsFile, bamFile, unchunkedOutputBase, referenceFile, vcfReference, false);
+    CuAssertTrue(testCase, i == 0);
+
+    // Phase the region in chunks
+    char *command = stString_print("./marginPhase %s %s %s --logLevel INFO --outputBase %s --referenceVcf %s "
+                                   "--chunkSize 1000 --chunkOverlap 200", bamFile, referenceFile, paramsFile,
+                                   outputBase, vcfReference);
+    st_logInfo("> Running command: %s\n", command);
+    CuAssertIntEquals(testCase, 0, st_system(command));
+
+    // The phase blocks of the chunks are output in order
+    char *vcfOutFile = stString_print("%s.vcf", outputBase);
+    char *contigs[] = { "chr3" };
+    int64_t recordNumber;
+    checkVcfRecordOrder(testCase, vcfOutFile, contigs, 1, &recordNumber);
+    CuAssertTrue(testCase, recordNumber > 0);
+
+    // Most of the genotypes called in chunks are those called without chunking
+    char *unchunkedVcfOutFile = stString_print("%s.vcf", unchunkedOutputBase);
+    stHash *genotypes = getVcfGenotypes(testCase, vcfOutFile);
+    stHash *unchunkedGenotypes = getVcfGenotypes(testCase, unchunkedVcfOutFile);
+    CuAssertTrue(testCase, stHash_size(unchunkedGenotypes) > 0);
+    int64_t matchingGenotypes = 0;
+    stHashIterator *it = stHash_getIterator(unchunkedGenotypes);
+    char *position;
+    while ((position = stHash_getNext(it)) != NULL) {
+        char *genotype = stHash_search(genotypes, position);
+        if (genotype != NULL && strcmp(genotype, stHash_search(unchunkedGenotypes, position)) == 0) {
+            matchingGenotypes++;
+        }
+    }
+    stHash_destructIterator(it);
+    st_logInfo("\t%" PRIi64 " of %" PRIi64 " unchunked genotypes called in %" PRIi64 " chunked genotypes\n",
+               matchingGenotypes, stHash_size(unchunkedGenotypes), stHash_size(genotypes));
+    CuAssertTrue(testCase, matchingGenotypes * 10 >= stHash_size(unchunkedGenotypes) * 9);
+    CuAssertTrue(testCase, matchingGenotypes * 10 >= stHash_size(genotypes) * 9);
+
+    // cleanup
+    stHash_destruct(genotypes);
+    stHash_destruct(unchunkedGenotypes);
+    free(unchunkedVcfOutFile);
+    free(vcfOutFile);
+    free(command);
+}
+
 /*
  * Test to run on five 100kb regions for PacBio
  */
@@ -315,6 +552,8 @@ CuSuite *marginPhaseTestSuite(void) {
     SUITE_ADD_TEST(suite, test_5kbGenotyping_singleNuclProb);
     SUITE_ADD_TEST(suite, test_100kbGenotyping_pacbio);
     SUITE_ADD_TEST(suite, test_100kbGenotyping_nanopore);
+    SUITE_ADD_TEST(suite, test_5kbGenotyping_chunked);
+    SUITE_ADD_TEST(suite, test_multipleContigGenotyping);
 
 //    SUITE_ADD_TEST(suite, test_multiple100kbGenotyping_pacbio);
 //    SUITE_ADD_TEST(suite, test_multiple100kbGenotyping_nanopore);
@@ -200,6 +200,20 @@ void test_jsmnParsing(CuTest *testCase) {
     CuAssertIntEquals(testCase, stBaseMapper_getValueForChar(baseMapper, 't'), 3);
     CuAssertIntEquals(testCase, stBaseMapper_getValueForChar(baseMapper, '-'), 4);
 
+    // Check that seeded wildcards resolve to the same non-gap base for the same seed, and that other bases
+    // ignore the seed
+    bool resolvedBases[4] = { false, false, false, false };
+    for (uint64_t seed = 0; seed < 100; seed++) {
+        uint8_t b = stBaseMapper_getValueForCharWithSeed(baseMapper, 'N', seed);
+        CuAssertTrue(testCase, b < 4);
+        CuAssertIntEquals(testCase, b, stBaseMapper_getValueForCharWithSeed(baseMapper, 'n', seed));
+        resolvedBases[b] = true;
+        CuAssertIntEquals(testCase, stBaseMapper_getValueForCharWithSeed(baseMapper, 'g', seed), 2);
+    }
+    for (int64_t i = 0; i < 4; i++) {
+        CuAssertTrue(testCase, resolvedBases[i]);
+    }
+
     // Check stRPHmmParameters
 
     // Check haplotype substitution model and error model parsed correctly
@@ -244,12 +258,311 @@ void test_jsmnParsing(CuTest *testCase) {
     stRPHmmParameters_destruct(params);
 }
 
+/*
+ * Test that reads are loaded for regions of a bam file using its index.
+ * Checks:
+ * - Overlapping regions are merged, and each profile sequence lies within one region.
+ * - There is one profile sequence for each pair of read and region that overlap.
+ * - Each profile sequence is the part of the corresponding whole read within the region.
+ */
+void test_bamRegionParsing(CuTest *testCase) {
+
+    char *bamFile = "../tests/NA12878.pb.chr3.5kb.bam";
+    char *paramsFile = "../tests/parsingTest.json";
+
+    stBaseMapper *baseMapper = stBaseMapper_construct();
+    stRPHmmParameters *params = parseParameters(paramsFile, baseMapper);
+
+    // The bam file's index is checked in alongside it
+    samFile *in = hts_open(bamFile, "r");
+    hts_idx_t *idx = sam_index_load(in, bamFile);
+    CuAssertTrue(testCase, idx != NULL);
+    hts_idx_destroy(idx);
+    sam_close(in);
+
+    // Parse all the reads, and the reads in two overlapping regions and a third separate region
+    stList *profileSequences = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+    parseReads(profileSequences, bamFile, baseMapper, params);
+    stList *regions = stList_construct3(0, free);
+    stList_append(regions, stString_copy("chr3:150001-151000"));
+    stList_append(regions, stString_copy("chr3:150501-152000"));
+    stList_append(regions, stString_copy("chr3:160001-161000"));
+    stList *regionProfileSequences = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+    parseReadsInRegions(regionProfileSequences, bamFile, baseMapper, params, NULL, false, regions);
+
+    // The merged regions, with one-based and closed coordinates as for profile sequences
+    int64_t regionStarts[] = { 150001, 160001 };
+    int64_t regionEnds[] = { 152000, 161000 };
+
+    // Count the expected profile sequences
+    int64_t expectedProfileSequences = 0;
+    for (int64_t i = 0; i < stList_length(profileSequences); i++) {
+        stProfileSeq *pSeq = stList_get(profileSequences, i);
+        for (int64_t j = 0; j < 2; j++) {
+            expectedProfileSequences += pSeq->refStart <= regionEnds[j] &&
+                                        pSeq->refStart + pSeq->length > regionStarts[j];
+        }
+    }
+    CuAssertTrue(testCase, expectedProfileSequences > 0);
+    CuAssertIntEquals(testCase, expectedProfileSequences, stList_length(regionProfileSequences));
+
+    // Check each profile sequence is within a region and is part of the whole read
+    for (int64_t i = 0; i < stList_length(regionProfileSequences); i++) {
+        stProfileSeq *pSeq = stList_get(regionProfileSequences, i);
+        bool inRegion = false;
+        for (int64_t j = 0; j < 2; j++) {
+            inRegion = inRegion || (pSeq->refStart >= regionStarts[j] &&
+                                    pSeq->refStart + pSeq->length - 1 <= regionEnds[j]);
+        }
+        CuAssertTrue(testCase, inRegion);
+
+        bool foundRead = false;
+        for (int64_t j = 0; j < stList_length(profileSequences) && !foundRead; j++) {
+            stProfileSeq *wholeSeq = stList_get(profileSequences, j);
+            if (strcmp(pSeq->readId, wholeSeq->readId) == 0 && pSeq->refStart >= wholeSeq->refStart &&
+                pSeq->refStart + pSeq->length <= wholeSeq->refStart + wholeSeq->length) {
+                foundRead = memcmp(pSeq->profileProbs,
+                                   &wholeSeq->profileProbs[(pSeq->refStart - wholeSeq->refStart) * ALPHABET_SIZE],
+                                   sizeof(uint8_t) * pSeq->length * ALPHABET_SIZE) == 0;
+            }
+        }
+        CuAssertTrue(testCase, foundRead);
+    }
+
+    // cleanup
+    stList_destruct(regionProfileSequences);
+    stList_destruct(profileSequences);
+    stList_destruct(regions);
+    stBaseMapper_destruct(baseMapper);
+    stRPHmmParameters_destruct(params);
+}
+
+/*
+ * Test that a single nucleotide probability file is parsed into the expected profile sequence.
+ * Checks:
+ * - Comment lines, blank lines and \r\n line endings are skipped.
+ * - Probabilities given with exponents are parsed.
+ * - Missing positions are deletions, and repeated or earlier positions are ignored.
+ * - Gap probabilities are only kept if gapCharactersForDeletions is set.
+ */
+void test_singleNuclProbFileParsing(CuTest *testCase) {
+
+    char *paramsFile = "../tests/parsingTest.json";
+    char *singleNuclProbFile = "singleNuclProbFileParsingTest.tsv";
+
+    stBaseMapper *baseMapper = stBaseMapper_construct();
+    stRPHmmParameters *params = parseParameters(paramsFile, baseMapper);
+
+    FILE *fp = fopen(singleNuclProbFile, "w");
+    fprintf(fp, "## comment\r\n"
+                "#CHROM\tPOS\tpA\tpC\tpG\tpT\tp_\r\n"
+                "chr3\t10\t1.0\t0\t0\t0\t0\r\n"
+                "chr3\t11\t0.2\t0.8\t0\t0\t0\r\n"
+                "chr3\t11\t0\t0\t0\t1\t0\r\n"
+                "\r\n"
+                "chr3\t14\t0\t0\t1e0\t0\t0\r\n"
+                "chr3\t15\t2.0E-01\t0\t0\t8e-1\t0.0\r\n"
+                "chr3\t13\t1\t0\t0\t0\t0\r\n"
+                "chr3\t16\t0\t0\t0\t0\t1.0E+00");
+    fclose(fp);
+
+    // The expected probabilities of A, C, G, T and gap at positions 10 to 16, where 12 and 13 are deletions
+    uint8_t expectedProbs[7][ALPHABET_SIZE] = { { 255, 0, 0, 0, 0 },
+                                                { 51, 204, 0, 0, 0 },
+                                                { 0, 0, 0, 0, 255 },
+                                                { 0, 0, 0, 0, 255 },
+                                                { 0, 0, 255, 0, 0 },
+                                                { 51, 0, 0, 204, 0 },
+                                                { 0, 0, 0, 0, 255 } };
+
+    for (int64_t gapCharactersForDeletions = 0; gapCharactersForDeletions < 2; gapCharactersForDeletions++) {
+        params->gapCharactersForDeletions = gapCharactersForDeletions;
+        stProfileSeq *pSeq = getProfileSequenceFromSingleNuclProbFile(singleNuclProbFile, "read", baseMapper,
+                                                                      params);
+        CuAssertStrEquals(testCase, "chr3", pSeq->referenceName);
+        CuAssertStrEquals(testCase, "read", pSeq->readId);
+        CuAssertIntEquals(testCase, 11, pSeq->refStart);
+        CuAssertIntEquals(testCase, 7, pSeq->length);
+        for (int64_t i = 0; i < pSeq->length; i++) {
+            for (int64_t j = 0; j < ALPHABET_SIZE; j++) {
+                int64_t k = j == ALPHABET_SIZE - 1 ? j : stBaseMapper_getValueForChar(baseMapper, "ACGT"[j]);
+                int64_t expected = j == ALPHABET_SIZE - 1 && !gapCharactersForDeletions ? 0 : expectedProbs[i][j];
+                CuAssertIntEquals(testCase, expected, pSeq->profileProbs[i * ALPHABET_SIZE + k]);
+            }
+        }
+        stProfileSeq_destruct(pSeq);
+    }
+
+    // cleanup
+    remove(singleNuclProbFile);
+    stBaseMapper_destruct(baseMapper);
+    stRPHmmParameters_destruct(params);
+}
+
+/*
+ * Test that single nucleotide probability files packed into a container give the same profile sequences as the files.
+ */
+void test_singleNuclProbContainer(CuTest *testCase) {
+
+    char *paramsFile = "../tests/parsingTest.json";
+    char *singleNuclProbDir = "singleNuclProbContainerTest";
+    char *containerFile = "singleNuclProbContainerTest.snp";
+
+    stBaseMapper *baseMapper = stBaseMapper_construct();
+    stRPHmmParameters *params = parseParameters(paramsFile, baseMapper);
+
+    // Write some single nucleotide probability files, with missing and repeated positions
+    char *command = stString_print("mkdir -p %s", singleNuclProbDir);
+    CuAssertIntEquals(testCase, 0, st_system(command));
+    free(command);
+    int64_t readNumber = 20;
+    for (int64_t i = 0; i < readNumber; i++) {
+        char *singleNuclProbFile = stString_print("%s/read_%" PRIi64 ".tsv", singleNuclProbDir, i);
+        FILE *fp = fopen(singleNuclProbFile, "w");
+        fprintf(fp, "## comment\n#CHROM\tPOS\tpA\tpC\tpG\tpT\tp_\n");
+        int64_t refPos = st_randomInt(1, 100000);
+        for (int64_t j = st_randomInt(1, 1000); j > 0; j--) {
+            double probs[ALPHABET_SIZE], total = 0.0;
+            for (int64_t k = 0; k < ALPHABET_SIZE; k++) {
+                probs[k] = st_random() < 0.3 ? 0.0 : st_random();
+                total += probs[k];
+            }
+            probs[0] += total == 0.0 ? 1.0 : 0.0;
+            total += total == 0.0 ? 1.0 : 0.0;
+            fprintf(fp, "chr%" PRIi64 "\t%" PRIi64 "\t%f\t%f\t%f\t%f\t%e\n", i % 3, refPos, probs[0] / total,
+                    probs[1] / total, probs[2] / total, probs[3] / total, probs[4] / total);
+            refPos += st_random() < 0.05 ? 0 : (st_random() < 0.05 ? 3 : 1);
+        }
+        fclose(fp);
+        free(singleNuclProbFile);
+    }
+
+    // And one with probabilities worked out by hand, with a missing position
+    char *singleNuclProbFile = stString_print("%s/handRead.tsv", singleNuclProbDir);
+    FILE *fp = fopen(singleNuclProbFile, "w");
+    fprintf(fp, "#CHROM\tPOS\tpA\tpC\tpG\tpT\tp_\nchrX\t5\t0.2\t0.8\t0\t0\t0\nchrX\t7\t0\t0\t0\t1e0\t0\n");
+    fclose(fp);
+    free(singleNuclProbFile);
+
+    // Pack them
+    CuAssertIntEquals(testCase, readNumber + 1, writeSingleNuclProbContainer(singleNuclProbDir, containerFile));
+    CuAssertTrue(testCase, isSingleNuclProbContainer(containerFile));
+    CuAssertTrue(testCase, !isSingleNuclProbContainer(singleNuclProbDir));
+
+    // Check the profile sequences from the container against those from the files
+    stSingleNuclProbContainer *container = stSingleNuclProbContainer_open(containerFile);
+    CuAssertIntEquals(testCase, readNumber + 1, stSingleNuclProbContainer_getReadNumber(container));
+    for (int64_t i = 0; i < readNumber; i++) {
+        char *readId = stString_print("read_%" PRIi64, i);
+        char *singleNuclProbFile = stString_print("%s/%s.tsv", singleNuclProbDir, readId);
+        stProfileSeq *pSeq = getProfileSequenceFromSingleNuclProbFile(singleNuclProbFile, readId, baseMapper, params);
+        stProfileSeq *containerSeq = stSingleNuclProbContainer_getProfileSeq(container, readId, baseMapper, params);
+        CuAssertTrue(testCase, containerSeq != NULL);
+        CuAssertStrEquals(testCase, pSeq->referenceName, containerSeq->referenceName);
+        CuAssertStrEquals(testCase, pSeq->readId, containerSeq->readId);
+        CuAssertIntEquals(testCase, pSeq->refStart, containerSeq->refStart);
+        CuAssertIntEquals(testCase, pSeq->length, containerSeq->length);
+        CuAssertTrue(testCase, memcmp(pSeq->profileProbs, containerSeq->profileProbs,
+                                      sizeof(uint8_t) * pSeq->length * ALPHABET_SIZE) == 0);
+
+        // Each position's probabilities are normalised, missing positions having all their probability on the gap
+        for (int64_t j = 0; j < pSeq->length; j++) {
+            int64_t total = 0;
+            for (int64_t k = 0; k < ALPHABET_SIZE; k++) {
+                total += pSeq->profileProbs[j * ALPHABET_SIZE + k];
+            }
+            CuAssertIntEquals(testCase, ALPHABET_MAX_PROB, total);
+        }
+
+        stProfileSeq_destruct(pSeq);
+        stProfileSeq_destruct(containerSeq);
+        free(singleNuclProbFile);
+        free(readId);
+    }
+    CuAssertPtrEquals(testCase, NULL, stSingleNuclProbContainer_getProfileSeq(container, "missingRead", baseMapper,
+                                                                              params));
+
+    // Check the read worked out by hand
+    stProfileSeq *pSeq = stSingleNuclProbContainer_getProfileSeq(container, "handRead", baseMapper, params);
+    CuAssertTrue(testCase, pSeq != NULL);
+    CuAssertStrEquals(testCase, "chrX", pSeq->referenceName);
+    CuAssertIntEquals(testCase, 6, pSeq->refStart);
+    CuAssertIntEquals(testCase, 3, pSeq->length);
+    uint8_t expectedProbs[3 * ALPHABET_SIZE] = { 51, 204, 0, 0, 0,
+                                                 0, 0, 0, 0, 255,
+                                                 0, 0, 0, 255, 0 };
+    for (int64_t j = 0; j < 3 * ALPHABET_SIZE; j++) {
+        CuAssertIntEquals(testCase, expectedProbs[j], pSeq->profileProbs[j]);
+    }
+    stProfileSeq_destruct(pSeq);
+
+    // cleanup
+    stSingleNuclProbContainer_close(container);
+    command = stString_print("rm -rf %s %s", singleNuclProbDir, containerFile);
+    st_system(command);
+    free(command);
+    stBaseMapper_destruct(baseMapper);
+    stRPHmmParameters_destruct(params);
+}
+
+/*
+ * Test that contig names are ordered as the sequences of a fasta index.
+ * Checks:
+ * - Names in the index are ordered as in the index, and each is given once.
+ * - Names not in the index follow, in the order they are first given.
+ * - Without a fasta file the names are in the order they are first given.
+ */
+void test_orderReferenceNamesByFastaIndex(CuTest *testCase) {
+
+    char *fastaFile = "orderReferenceNamesTest.fa";
+
+    // Write and index a fasta file whose sequences are not in name order
+    FILE *fp = fopen(fastaFile, "w");
+    fprintf(fp, ">contigB\nACGTACGT\n>contigA\nACGT\n>contigC\nACGTAC\n>contigD\nAC\n");
+    fclose(fp);
+    CuAssertIntEquals(testCase, 0, fai_build(fastaFile));
+
+    stList *referenceNames = stList_construct();
+    char *names[] = { "contigC", "contigX", "contigA", "contigC", "contigY", "contigB" };
+    for (int64_t i = 0; i < 6; i++) {
+        stList_append(referenceNames, names[i]);
+    }
+
+    // Order by the fasta index
+    char *expectedNames[] = { "contigB", "contigA", "contigC", "contigX", "contigY" };
+    stList *orderedNames = orderReferenceNamesByFastaIndex(referenceNames, fastaFile);
+    CuAssertIntEquals(testCase, 5, stList_length(orderedNames));
+    for (int64_t i = 0; i < 5; i++) {
+        CuAssertStrEquals(testCase, expectedNames[i], stList_get(orderedNames, i));
+    }
+    stList_destruct(orderedNames);
+
+    // Order without a fasta file
+    char *expectedUnindexedNames[] = { "contigC", "contigX", "contigA", "contigY", "contigB" };
+    orderedNames = orderReferenceNamesByFastaIndex(referenceNames, NULL);
+    CuAssertIntEquals(testCase, 5, stList_length(orderedNames));
+    for (int64_t i = 0; i < 5; i++) {
+        CuAssertStrEquals(testCase, expectedUnindexedNames[i], stList_get(orderedNames, i));
+    }
+    stList_destruct(orderedNames);
+
+    // cleanup
+    stList_destruct(referenceNames);
+    char *command = stString_print("rm -f %s %s.fai", fastaFile, fastaFile);
+    st_system(command);
+    free(command);
+}
+
 CuSuite *marginPhaseParserTestSuite(void) {
     st_setLogLevelFromString("debug");
     CuSuite* suite = CuSuiteNew();
 
     SUITE_ADD_TEST(suite, test_jsmnParsing);
     SUITE_ADD_TEST(suite, test_bamReadParsing);
+    SUITE_ADD_TEST(suite, test_bamRegionParsing);
+    SUITE_ADD_TEST(suite, test_singleNuclProbFileParsing);
+    SUITE_ADD_TEST(suite, test_singleNuclProbContainer);
+    SUITE_ADD_TEST(suite, test_orderReferenceNamesByFastaIndex);
 
     return suite;
 }
@@ -201,6 +201,54 @@ static void simulateReads(stList *referenceSeqs, stList *hapSeqs1, stList *hapSe
     }
 }
 
+typedef struct _simulatedReads {
+    /*
+     * Simulated reference sequences, their haplotypes and the reads derived from each haplotype, as created by
+     * simulateReads.
+     */
+    stList *referenceSeqs;
+    stList *hapSeqs1;
+    stList *hapSeqs2;
+    stList *profileSeqs1;
+    stList *profileSeqs2;
+    stHash *referenceNamesToReferencePriors;
+} simulatedReads;
+
+static simulatedReads *simulatedReads_construct(int64_t minReferenceSeqNumber, int64_t maxReferenceSeqNumber,
+        int64_t minReferenceLength, int64_t maxReferenceLength,
+        int64_t minCoverage, int64_t maxCoverage,
+        int64_t minReadLength, int64_t maxReadLength,
+        double hetRate, double readErrorRate, stRPHmmParameters *params) {
+    /*
+     * Creates reference sequences, generates two haplotypes for each reference sequence and
+     * generates profile sequences from each haplotype (see simulateReads).
+     */
+    simulatedReads *sim = st_malloc(sizeof(simulatedReads));
+    sim->referenceSeqs = stList_construct3(0, free);
+    sim->hapSeqs1 = stList_construct3(0, free);
+    sim->hapSeqs2 = stList_construct3(0, free);
+    sim->profileSeqs1 = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+    sim->profileSeqs2 = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+    // Make map from reference sequence names to reference priors
+    sim->referenceNamesToReferencePriors = stHash_construct3(stHash_stringKey,
+            stHash_stringEqualKey, free, (void (*)(void *))stReferencePriorProbs_destruct);
+    simulateReads(sim->referenceSeqs, sim->hapSeqs1, sim->hapSeqs2, sim->profileSeqs1, sim->profileSeqs2,
+            minReferenceSeqNumber, maxReferenceSeqNumber, minReferenceLength, maxReferenceLength,
+            minCoverage, maxCoverage, minReadLength, maxReadLength,
+            hetRate, readErrorRate, sim->referenceNamesToReferencePriors, params);
+    return sim;
+}
+
+static void simulatedReads_destruct(simulatedReads *sim) {
+    stList_destruct(sim->referenceSeqs);
+    stList_destruct(sim->hapSeqs1);
+    stList_destruct(sim->hapSeqs2);
+    stList_destruct(sim->profileSeqs1);
+    stList_destruct(sim->profileSeqs2);
+    stHash_destruct(sim->referenceNamesToReferencePriors);
+    free(sim);
+}
+
 static void test_systemTest(CuTest *testCase, int64_t minReferenceSeqNumber, int64_t maxReferenceSeqNumber,
         int64_t minReferenceLength, int64_t maxReferenceLength, int64_t minCoverage, int64_t maxCoverage,
         int64_t minReadLength, int64_t maxReadLength,
@@ -904,6 +952,99 @@ void test_systemMultipleReferences(CuTest *testCase) {
             minReadCoverageToSupportPhasingBetweenHeterozygousSites, printHmm);
 }
 
+static void checkHmmsHaveSameCells(CuTest *testCase, stRPHmm *hmm1, stRPHmm *hmm2) {
+    /*
+     * Checks that the two hmms have the same columns, containing the same cells and merge cells with the
+     * same forward and backward probabilities.
+     */
+    CuAssertIntEquals(testCase, hmm1->columnNumber, hmm2->columnNumber);
+    CuAssertIntEquals(testCase, hmm1->maxDepth, hmm2->maxDepth);
+    stRPColumn *column1 = hmm1->firstColumn, *column2 = hmm2->firstColumn;
+    while(1) {
+        CuAssertIntEquals(testCase, column1->refStart, column2->refStart);
+        CuAssertIntEquals(testCase, column1->length, column2->length);
+        int64_t cellNumber1 = 0, cellNumber2 = 0;
+        for(stRPCell *cell1 = column1->head; cell1 != NULL; cell1 = cell1->nCell) {
+            stRPCell *cell2 = column2->head;
+            while(cell2 != NULL && cell2->partition != cell1->partition) {
+                cell2 = cell2->nCell;
+            }
+            cellNumber1++;
+            CuAssertTrue(testCase, cell2 != NULL);
+            CuAssertDblEquals(testCase, cell1->forwardLogProb, cell2->forwardLogProb, 0.0001);
+            CuAssertDblEquals(testCase, cell1->backwardLogProb, cell2->backwardLogProb, 0.0001);
+        }
+        for(stRPCell *cell2 = column2->head; cell2 != NULL; cell2 = cell2->nCell) {
+            cellNumber2++;
+        }
+        CuAssertIntEquals(testCase, cellNumber1, cellNumber2);
+        if(column1->nColumn == NULL) {
+            CuAssertTrue(testCase, column2->nColumn == NULL);
+            break;
+        }
+        stRPMergeColumn *mColumn1 = column1->nColumn, *mColumn2 = column2->nColumn;
+        CuAssertIntEquals(testCase, stRPMergeColumn_numberOfPartitions(mColumn1),
+                stRPMergeColumn_numberOfPartitions(mColumn2));
+        stHashIterator *it = stHash_getIterator(mColumn1->mergeCellsFrom);
+        stRPMergeCell *mCell1;
+        while((mCell1 = stHash_getNext(it)) != NULL) {
+            stRPMergeCell *mCell2 = stHash_search(mColumn2->mergeCellsFrom, &mCell1->fromPartition);
+            CuAssertTrue(testCase, mCell2 != NULL);
+            CuAssertTrue(testCase, mCell1->toPartition == mCell2->toPartition);
+            CuAssertDblEquals(testCase, mCell1->forwardLogProb, mCell2->forwardLogProb, 0.0001);
+            CuAssertDblEquals(testCase, mCell1->backwardLogProb, mCell2->backwardLogProb, 0.0001);
+        }
+        stHash_destructIterator(it);
+        column1 = mColumn1->nColumn;
+        column2 = mColumn2->nColumn;
+    }
+}
+
+void test_checkpointedCrossProduct(CuTest *testCase) {
+    /*
+     * Checks that creating the pruned cross product of two hmms with checkpointing gives the same
+     * hmm as creating the whole cross product, running forward-backward and pruning.
+     */
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        stRPHmmParameters *params = getHmmParams(50, 0.01, 0.01, 0, 0);
+
+        simulatedReads *sim = simulatedReads_construct(1, 1, 1000, 1000, 5, 5, 100, 500, 0.01, 0.01, params);
+
+        // Add a read spanning the whole reference to each set of reads, so that each set is represented by one hmm
+        stList_append(sim->profileSeqs1, getRandomProfileSeq("Reference_0", stList_get(sim->hapSeqs1, 0), 1000, 1000, 0.01));
+        stList_append(sim->profileSeqs2, getRandomProfileSeq("Reference_0", stList_get(sim->hapSeqs2, 0), 1000, 1000, 0.01));
+        stList *hmms1 = getRPHmms(sim->profileSeqs1, sim->referenceNamesToReferencePriors, params);
+        stList *hmms2 = getRPHmms(sim->profileSeqs2, sim->referenceNamesToReferencePriors, params);
+        CuAssertIntEquals(testCase, 1, stList_length(hmms1));
+        CuAssertIntEquals(testCase, 1, stList_length(hmms2));
+        stRPHmm *hmm1 = stList_get(hmms1, 0), *hmm2 = stList_get(hmms2, 0);
+        stRPHmm_alignColumns(hmm1, hmm2);
+
+        // Prune the cross product only by posterior probability, so the cells kept do not depend upon how ties are broken
+        params->maxPartitionsInAColumn = 1000000;
+        params->minPosteriorProbabilityForPartition = 0.001;
+
+        stRPHmm *hmm = stRPHmm_createCrossProductOfTwoAlignedHmm(hmm1, hmm2);
+        stRPHmm_forwardBackward(hmm);
+        stRPHmm_prune(hmm);
+
+        int64_t columnsBetweenCheckpoints[] = { 0, 1, 3 };
+        for(int64_t i=0; i<3; i++) {
+            params->columnsBetweenCheckpoints = columnsBetweenCheckpoints[i];
+            stRPHmm *checkpointedHmm = stRPHmm_createPrunedCrossProductOfTwoAlignedHmm(hmm1, hmm2);
+            checkHmmsHaveSameCells(testCase, hmm, checkpointedHmm);
+            stRPHmm_destruct(checkpointedHmm, 1);
+        }
+
+        // Cleanup
+        stRPHmm_destruct(hmm, 1);
+        stList_destruct(hmms1);
+        stList_destruct(hmms2);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+}
+
 void test_popCount64(CuTest *testCase) {
     CuAssertIntEquals(testCase, popcount64(0), 0);
     CuAssertIntEquals(testCase, popcount64(1), 1);
@@ -915,25 +1056,30 @@ void test_popCount64(CuTest *testCase) {
     CuAssertIntEquals(testCase, popcount64(0x1111111111111111), 16);
 }
 
-static double getExpectedInstanceNumberSimple(uint8_t **seqs, uint64_t partition,
+static double getExpectedInstanceNumberSimple(uint8_t **seqs, stRPPartition partition,
         int64_t depth, int64_t length,
         int64_t position, int64_t characterIndex) {
     uint64_t expectation = 0;
     for(int64_t i=0; i<depth; i++) {
-        if((partition & ((uint64_t)1 << i)) != 0) {
+        if((partition & ((stRPPartition)1 << i)) != 0) {
             expectation += seqs[i][position*ALPHABET_SIZE + characterIndex];
         }
     }
     return (double)expectation/255;
 }
 
-static uint64_t getRandomPartition(int64_t depth) {
-    //return 0xFFFFFFFFFFFFFFFF;
-    return st_randomInt(0, 0xFFFFFFFFFFFFFFFF/2);
+static stRPPartition getRandomPartition(int64_t depth) {
+    stRPPartition partition = 0;
+    for(int64_t i=0; i<depth; i++) {
+        if(st_random() < 0.5) {
+            partition |= (stRPPartition)1 << i;
+        }
+    }
+    return partition;
 }
 
 void test_bitCountVectors(CuTest *testCase) {
-    for(int64_t depth=0; depth<64; depth++) {
+    for(int64_t depth=0; depth<MAX_READ_PARTITIONING_DEPTH; depth++) {
         for(int64_t test=0; test<100; test++) {
             // Make column as set of uint8_t sequences
             int64_t length = st_randomInt(0, 10);
@@ -954,10 +1100,10 @@ void test_bitCountVectors(CuTest *testCase) {
             for(int64_t i=0; i<length; i++) {
                 activePositions[i] = i;
             }
-            uint64_t *countBitVectors = calculateCountBitVectors(seqs, depth, activePositions, length);
+            stRPPartition *countBitVectors = calculateCountBitVectors(seqs, depth, activePositions, length, 0);
 
             // Partition
-            uint64_t partition = getRandomPartition(depth);
+            stRPPartition partition = getRandomPartition(depth);
 
             // Test we get the expected output
             for(int64_t i=0; i<length; i++) {
@@ -1098,6 +1244,29 @@ void test_getOverlappingComponents(CuTest *testCase) {
         CuAssertIntEquals(testCase, stSet_size(seen), stList_length(readHmmsList));
         stSet_destruct(seen);
 
+        // Check the tiling paths of the profile sequences match those of their hmms
+        stList *profileSeqs = stList_copy(profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, profileSeqs2);
+        stList *profileSeqTilingPaths = getTilingPathsOfProfileSeqs(profileSeqs);
+        CuAssertIntEquals(testCase, stList_length(tilingPaths), stList_length(profileSeqTilingPaths));
+        for(int64_t i=0; i<stList_length(tilingPaths); i++) {
+            stList *tilingPath = stList_get(tilingPaths, i);
+            stList *profileSeqTilingPath = stList_get(profileSeqTilingPaths, i);
+            CuAssertIntEquals(testCase, stList_length(tilingPath), stList_length(profileSeqTilingPath));
+            for(int64_t j=0; j<stList_length(tilingPath); j++) {
+                stRPHmm *hmm = stList_get(tilingPath, j);
+                stProfileSeq *pSeq = stList_get(profileSeqTilingPath, j);
+                CuAssertStrEquals(testCase, hmm->referenceName, pSeq->referenceName);
+                CuAssertIntEquals(testCase, hmm->refStart, pSeq->refStart);
+                CuAssertIntEquals(testCase, hmm->refLength, pSeq->length);
+            }
+        }
+        while(stList_length(profileSeqTilingPaths) > 0) {
+            stList_destruct(stList_pop(profileSeqTilingPaths));
+        }
+        stList_destruct(profileSeqTilingPaths);
+        stList_destruct(profileSeqs);
+
         // Get components
         while(stList_length(tilingPaths) > 1) {
             stList *tilingPath2 = stList_pop(tilingPaths);
@@ -1233,8 +1402,9 @@ void test_emissionLogProbability(CuTest *testCase) {
             stRPColumn *column = hmm->firstColumn;
             while(1) {
                 // Get bit count vectors
-                uint64_t *bitCountVectors = calculateCountBitVectors(
-                        column->seqs, column->depth, column->activePositions, column->totalActivePositions);
+                stRPPartition *bitCountVectors = calculateCountBitVectors(
+                        column->seqs, column->depth, column->activePositions, column->totalActivePositions,
+                        column->activePositionsOffset);
 
                 // For each cell
                 stRPCell *cell = column->head;
@@ -1278,14 +1448,1106 @@ void test_emissionLogProbability(CuTest *testCase) {
     }
 }
 
+/*
+ * Test that paths retained when splitting hmms match those computed from scratch
+ */
+
+void test_splitHmmRetainsPath(CuTest *testCase) {
+    int64_t minReferenceSeqNumber = 1;
+    int64_t maxReferenceSeqNumber = 5;
+    int64_t minReferenceLength = 1000;
+    int64_t maxReferenceLength = 2000;
+    int64_t minCoverage = 2;
+    int64_t maxCoverage = 6;
+    int64_t minReadLength = 10;
+    int64_t maxReadLength = 300;
+    int64_t maxPartitionsInAColumn = 100;
+    double hetRate = 0.02;
+    double readErrorRate = 0.01;
+    bool maxNotSumTransitions = 1;
+    int64_t minReadCoverageToSupportPhasingBetweenHeterozygousSites = 2;
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        fprintf(stderr, "Starting test iteration: #%" PRIi64 "\n", test);
+
+        stRPHmmParameters *params = getHmmParams(maxPartitionsInAColumn,
+                        hetRate, readErrorRate, maxNotSumTransitions,
+                        minReadCoverageToSupportPhasingBetweenHeterozygousSites);
+
+        simulatedReads *sim = simulatedReads_construct(minReferenceSeqNumber, maxReferenceSeqNumber,
+                minReferenceLength, maxReferenceLength, minCoverage, maxCoverage,
+                minReadLength, maxReadLength, hetRate, readErrorRate, params);
+
+        // Creates read HMMs
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+
+        stList *filteredProfileSeqs = stList_construct();
+        stList *discardedProfileSeqs = stList_construct();
+        filterReadsByCoverageDepth(profileSeqs, params, filteredProfileSeqs, discardedProfileSeqs, sim->referenceNamesToReferencePriors);
+        stList *hmms = getRPHmms(filteredProfileSeqs, sim->referenceNamesToReferencePriors, params);
+
+        // For each hmm
+        int64_t retainedPaths = 0;
+        while(stList_length(hmms) > 0) {
+            stList *splitHmms = stRPHMM_splitWherePhasingIsUncertain(stList_pop(hmms));
+
+            for(int64_t i=0; i<stList_length(splitHmms); i++) {
+                stRPHmm *hmm = stList_get(splitHmms, i);
+
+                if(hmm->path == NULL) {
+                    continue;
+                }
+                retainedPaths++;
+
+                // Get the retained path
+                stList *path = stRPHmm_forwardBackwardTraceBack(hmm);
+                CuAssertPtrEquals(testCase, NULL, hmm->path);
+                CuAssertIntEquals(testCase, hmm->columnNumber, stList_length(path));
+
+                // Compute the path from scratch and check the two are the same
+                stRPHmm_forwardBackward(hmm);
+                stList *path2 = stRPHmm_forwardTraceBack(hmm);
+                CuAssertIntEquals(testCase, stList_length(path2), stList_length(path));
+                stRPColumn *column = hmm->firstColumn;
+                for(int64_t j=0; j<stList_length(path); j++) {
+                    stRPCell *cell = stList_get(path, j);
+                    stRPCell *cell2 = stList_get(path2, j);
+                    CuAssertTrue(testCase, cell == cell2 || cell->forwardLogProb == cell2->forwardLogProb);
+
+                    // Check the cell is in the corresponding column
+                    stRPCell *cell3 = column->head;
+                    while(cell3 != cell) {
+                        cell3 = cell3->nCell;
+                        CuAssertTrue(testCase, cell3 != NULL);
+                    }
+                    column = column->nColumn == NULL ? NULL : column->nColumn->nColumn;
+                }
+
+                stList_destruct(path);
+                stList_destruct(path2);
+            }
+
+            stList_destruct(splitHmms);
+        }
+        fprintf(stderr, "Checked %" PRIi64 " retained paths\n", retainedPaths);
+
+        // Clean up
+        stList_destruct(filteredProfileSeqs);
+        stList_destruct(discardedProfileSeqs);
+        stList_destruct(profileSeqs);
+        stList_destruct(hmms);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+}
+
+/*
+ * Test that heterozygous sites found without constructing a genome fragment match those of the genome fragment
+ */
+
+void test_getHeterozygousSites(CuTest *testCase) {
+    int64_t minReferenceSeqNumber = 1;
+    int64_t maxReferenceSeqNumber = 5;
+    int64_t minReferenceLength = 1000;
+    int64_t maxReferenceLength = 2000;
+    int64_t minCoverage = 4;
+    int64_t maxCoverage = 10;
+    int64_t minReadLength = 10;
+    int64_t maxReadLength = 300;
+    int64_t maxPartitionsInAColumn = 100;
+    double hetRate = 0.02;
+    double readErrorRate = 0.01;
+    bool maxNotSumTransitions = 1;
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        fprintf(stderr, "Starting test iteration: #%" PRIi64 "\n", test);
+
+        stRPHmmParameters *params = getHmmParams(maxPartitionsInAColumn,
+                        hetRate, readErrorRate, maxNotSumTransitions, 0);
+
+        simulatedReads *sim = simulatedReads_construct(minReferenceSeqNumber, maxReferenceSeqNumber,
+                minReferenceLength, maxReferenceLength, minCoverage, maxCoverage,
+                minReadLength, maxReadLength, hetRate, readErrorRate, params);
+
+        // Creates read HMMs
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+
+        stList *filteredProfileSeqs = stList_construct();
+        stList *discardedProfileSeqs = stList_construct();
+        filterReadsByCoverageDepth(profileSeqs, params, filteredProfileSeqs, discardedProfileSeqs, sim->referenceNamesToReferencePriors);
+        stList *hmms = getRPHmms(filteredProfileSeqs, sim->referenceNamesToReferencePriors, params);
+
+        // For each hmm
+        while(stList_length(hmms) > 0) {
+            stRPHmm *hmm = stList_pop(hmms);
+
+            stRPHmm_forwardBackward(hmm);
+            stList *path = stRPHmm_forwardTraceBack(hmm);
+
+            // Get the het sites from the genome fragment
+            stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+            stList *gFHetSites = stList_construct3(0, (void (*)(void *))stIntTuple_destruct);
+            for(int64_t i=0; i<gF->length; i++) {
+                stReferencePriorProbs *rProbs = hmm->referencePriorProbs;
+                if(gF->haplotypeString1[i] != gF->haplotypeString2[i] &&
+                   rProbs->referencePositionsIncluded[gF->refStart + i - rProbs->refStart]) {
+                    stList_append(gFHetSites, stIntTuple_construct1(gF->refStart + i));
+                }
+            }
+
+            // Check they are the same as those computed directly
+            stList *hetSites = stRPHmm_getHeterozygousSites(hmm, path);
+            CuAssertIntEquals(testCase, stList_length(gFHetSites), stList_length(hetSites));
+            for(int64_t i=0; i<stList_length(hetSites); i++) {
+                CuAssertIntEquals(testCase, stIntTuple_get(stList_get(gFHetSites, i), 0),
+                                  stIntTuple_get(stList_get(hetSites, i), 0));
+            }
+
+            // Cleanup
+            stList_destruct(hetSites);
+            stList_destruct(gFHetSites);
+            stGenomeFragment_destruct(gF);
+            stList_destruct(path);
+            stRPHmm_destruct(hmm, 1);
+        }
+
+        // Clean up
+        stList_destruct(filteredProfileSeqs);
+        stList_destruct(discardedProfileSeqs);
+        stList_destruct(profileSeqs);
+        stList_destruct(hmms);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+}
+
+void test_genotypeFilteredPositionsFromPileup(CuTest *testCase) {
+    /*
+     * Checks that genotyping the positions excluded by the reference position filter from the pileup leaves
+     * the predictions at the unfiltered positions unchanged, and at the filtered, homozygous positions mostly
+     * agrees with the full model. Where no read of a haplotype covers a filtered position the reference
+     * prior decides its character. The simulation is seeded so
+     * that the agreement threshold is checked on a fixed input.
+     */
+    int64_t filteredPositionNumber = 0, agreeingFilteredPositionNumber = 0;
+    st_randomSeed(1);
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        fprintf(stderr, "Starting test iteration: #%" PRIi64 "\n", test);
+
+        stRPHmmParameters *params = getHmmParams(100, 0.02, 0.01, 1, 0);
+
+        simulatedReads *sim = simulatedReads_construct(1, 3, 1000, 2000, 4, 10, 10, 300, 0.02, 0.01, params);
+
+        // Filter a random subset of the homozygous reference positions
+        for(int64_t i=0; i<stList_length(sim->referenceSeqs); i++) {
+            char *referenceName = stString_print("Reference_%" PRIi64 "", i);
+            stReferencePriorProbs *rProbs = stHash_search(sim->referenceNamesToReferencePriors, referenceName);
+            char *hapSeq1 = stList_get(sim->hapSeqs1, i), *hapSeq2 = stList_get(sim->hapSeqs2, i);
+            for(int64_t j=0; j<rProbs->length; j++) {
+                rProbs->referencePositionsIncluded[j] = hapSeq1[j] != hapSeq2[j] || st_random() < 0.5;
+            }
+            stReferencePriorProbs_updateActivePositions(rProbs);
+            free(referenceName);
+        }
+
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+        stList *filteredProfileSeqs = stList_construct();
+        stList *discardedProfileSeqs = stList_construct();
+        filterReadsByCoverageDepth(profileSeqs, params, filteredProfileSeqs, discardedProfileSeqs, sim->referenceNamesToReferencePriors);
+        stList *hmms = getRPHmms(filteredProfileSeqs, sim->referenceNamesToReferencePriors, params);
+
+        while(stList_length(hmms) > 0) {
+            stRPHmm *hmm = stList_pop(hmms);
+            stRPHmm_forwardBackward(hmm);
+            stList *path = stRPHmm_forwardTraceBack(hmm);
+
+            params->genotypeFilteredPositionsFromPileup = false;
+            stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+            params->genotypeFilteredPositionsFromPileup = true;
+            stGenomeFragment *pileupGF = stGenomeFragment_construct(hmm, path);
+
+            stReferencePriorProbs *rProbs = hmm->referencePriorProbs;
+            for(int64_t i=0; i<gF->length; i++) {
+                CuAssertIntEquals(testCase, gF->referenceSequence[i], pileupGF->referenceSequence[i]);
+                CuAssertIntEquals(testCase, gF->hap1Depth[i], pileupGF->hap1Depth[i]);
+                CuAssertIntEquals(testCase, gF->hap2Depth[i], pileupGF->hap2Depth[i]);
+                if(rProbs->referencePositionsIncluded[gF->refStart + i - rProbs->refStart]) {
+                    CuAssertIntEquals(testCase, gF->haplotypeString1[i], pileupGF->haplotypeString1[i]);
+                    CuAssertIntEquals(testCase, gF->haplotypeString2[i], pileupGF->haplotypeString2[i]);
+                    CuAssertIntEquals(testCase, gF->genotypeString[i], pileupGF->genotypeString[i]);
+                    CuAssertDblEquals(testCase, gF->genotypeProbs[i], pileupGF->genotypeProbs[i], 0.0);
+                }
+                else {
+                    uint64_t hapChar1 = pileupGF->haplotypeString1[i], hapChar2 = pileupGF->haplotypeString2[i];
+                    CuAssertIntEquals(testCase, hapChar1 < hapChar2 ? hapChar1 * ALPHABET_SIZE + hapChar2 :
+                                      hapChar2 * ALPHABET_SIZE + hapChar1, pileupGF->genotypeString[i]);
+                    CuAssertTrue(testCase, pileupGF->genotypeProbs[i] >= 0.0 && pileupGF->genotypeProbs[i] <= 1.0);
+                    CuAssertDblEquals(testCase, 0.0,
+                                      pileupGF->genotypeLikelihoods[i][hapChar1*ALPHABET_SIZE+hapChar2], 0.0);
+                    // Haplotypes without reads at the position take the character most probable under the prior
+                    uint16_t *priorProbs = &rProbs->profileProbs[(gF->refStart + i - rProbs->refStart) * ALPHABET_SIZE];
+                    uint64_t priorChar = 0;
+                    for(uint64_t j=1; j<ALPHABET_SIZE; j++) {
+                        if(priorProbs[j] < priorProbs[priorChar]) {
+                            priorChar = j;
+                        }
+                    }
+                    if(pileupGF->hap1Depth[i] == 0) {
+                        CuAssertIntEquals(testCase, priorChar, hapChar1);
+                    }
+                    if(pileupGF->hap2Depth[i] == 0) {
+                        CuAssertIntEquals(testCase, priorChar, hapChar2);
+                    }
+                    filteredPositionNumber++;
+                    if(gF->genotypeString[i] == pileupGF->genotypeString[i]) {
+                        agreeingFilteredPositionNumber++;
+                    }
+                }
+            }
+
+            stGenomeFragment_destruct(gF);
+            stGenomeFragment_destruct(pileupGF);
+            stList_destruct(path);
+            stRPHmm_destruct(hmm, 1);
+        }
+
+        // Clean up
+        stList_destruct(filteredProfileSeqs);
+        stList_destruct(discardedProfileSeqs);
+        stList_destruct(profileSeqs);
+        stList_destruct(hmms);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+
+    // The pileup genotypes should mostly agree with those of the full model
+    st_logInfo("Pileup genotypes agreeing with the full model: %" PRIi64 " of %" PRIi64 "\n",
+               agreeingFilteredPositionNumber, filteredPositionNumber);
+    CuAssertTrue(testCase, agreeingFilteredPositionNumber >= 0.95 * filteredPositionNumber);
+}
+
+void test_ensembleGenomeFragments(CuTest *testCase) {
+    /*
+     * Checks that dividing high coverage reads into depth-bounded sub-samples partitions the reads, and that
+     * reconciling the genome fragments of the first sub-sample with those of the others leaves them consistent, with
+     * allele counts matching the reconciled haplotypes, and does not substantially increase the number of incorrect
+     * genotypes.
+     */
+    int64_t genotypeErrors = 0, reconciledGenotypeErrors = 0, totalPositions = 0;
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        fprintf(stderr, "Starting test iteration: #%" PRIi64 "\n", test);
+
+        stRPHmmParameters *params = getHmmParams(100, 0.02, 0.01, 1, 0);
+        params->maxCoverageDepth = 12;
+
+        simulatedReads *sim = simulatedReads_construct(1, 2, 1000, 2000, 15, 20, 50, 300, 0.02, 0.01, params);
+
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+
+        // Check the sub-samples and remaining reads partition the reads
+        int64_t maxSubsampleNumber = 3;
+        stList *remainingProfileSeqs = stList_construct();
+        stList *subsamples = getCoverageDepthBoundedSubsamples(profileSeqs, sim->referenceNamesToReferencePriors, params,
+                                                               maxSubsampleNumber, remainingProfileSeqs);
+        CuAssertTrue(testCase, stList_length(subsamples) > 0);
+        CuAssertTrue(testCase, stList_length(subsamples) <= maxSubsampleNumber);
+        stSet *subsampledSeqs = stSet_construct();
+        for(int64_t i=0; i<stList_length(subsamples); i++) {
+            stList *subsample = stList_get(subsamples, i);
+            for(int64_t j=0; j<stList_length(subsample); j++) {
+                stSet_insert(subsampledSeqs, stList_get(subsample, j));
+            }
+        }
+        for(int64_t i=0; i<stList_length(remainingProfileSeqs); i++) {
+            stSet_insert(subsampledSeqs, stList_get(remainingProfileSeqs, i));
+        }
+        CuAssertIntEquals(testCase, stList_length(profileSeqs), stSet_size(subsampledSeqs));
+
+        // Phase the first sub-sample, reconciling it with the others
+        stList *otherSubsamples = stList_construct();
+        for(int64_t i=1; i<stList_length(subsamples); i++) {
+            stList_append(otherSubsamples, stList_get(subsamples, i));
+        }
+        stList *ensembleGenomeFragments = getEnsembleGenomeFragments(otherSubsamples,
+                                                                     sim->referenceNamesToReferencePriors, params);
+        stList *hmms = getRPHmms(stList_get(subsamples, 0), sim->referenceNamesToReferencePriors, params);
+
+        while(stList_length(hmms) > 0) {
+            stRPHmm *hmm = stList_pop(hmms);
+            stList *path = stRPHmm_forwardBackwardTraceBack(hmm);
+            stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+
+            int64_t referenceIndex;
+            CuAssertIntEquals(testCase, 1, sscanf(gF->referenceName, "Reference_%" PRIi64 "", &referenceIndex));
+            char *hapSeq1 = stList_get(sim->hapSeqs1, referenceIndex), *hapSeq2 = stList_get(sim->hapSeqs2, referenceIndex);
+
+            for(int64_t k=0; k<2; k++) {
+                for(int64_t i=0; i<gF->length; i++) {
+                    uint64_t hapChar1 = gF->haplotypeString1[i], hapChar2 = gF->haplotypeString2[i];
+                    CuAssertIntEquals(testCase, hapChar1 < hapChar2 ? hapChar1 * ALPHABET_SIZE + hapChar2 :
+                                      hapChar2 * ALPHABET_SIZE + hapChar1, gF->genotypeString[i]);
+                    CuAssertTrue(testCase, gF->genotypeProbs[i] >= 0.0 && gF->genotypeProbs[i] <= 1.0);
+
+                    uint64_t trueHapChar1 = hapSeq1[gF->refStart + i] - FIRST_ALPHABET_CHAR;
+                    uint64_t trueHapChar2 = hapSeq2[gF->refStart + i] - FIRST_ALPHABET_CHAR;
+                    uint64_t trueGenotype = trueHapChar1 < trueHapChar2 ?
+                                            trueHapChar1 * ALPHABET_SIZE + trueHapChar2 :
+                                            trueHapChar2 * ALPHABET_SIZE + trueHapChar1;
+                    if(k == 0) {
+                        genotypeErrors += gF->genotypeString[i] != trueGenotype;
+                        totalPositions++;
+                    }
+                    else {
+                        reconciledGenotypeErrors += gF->genotypeString[i] != trueGenotype;
+                    }
+                }
+                if(k == 0) {
+                    stGenomeFragment_reconcileWithEnsemble(gF, hmm, path, ensembleGenomeFragments);
+                }
+            }
+
+            // The allele counts should agree with the reconciled haplotypes, each read having a single base
+            stRPColumn *column = hmm->firstColumn;
+            for(int64_t i=0; i<stList_length(path); i++) {
+                stRPCell *cell = stList_get(path, i);
+                for(int64_t p=0; p<column->length; p++) {
+                    int64_t j = column->refStart + p - gF->refStart;
+                    int64_t alleleCountHap1 = 0, alleleCountHap2 = 0, allele2CountHap1 = 0, allele2CountHap2 = 0;
+                    for(int64_t l=0; l<column->depth; l++) {
+                        bool inHap1 = seqInHap1(cell->partition, l);
+                        int64_t hapChar1Count =
+                                column->seqs[l][p*ALPHABET_SIZE + gF->haplotypeString1[j]] / ALPHABET_MAX_PROB;
+                        int64_t hapChar2Count =
+                                column->seqs[l][p*ALPHABET_SIZE + gF->haplotypeString2[j]] / ALPHABET_MAX_PROB;
+                        alleleCountHap1 += inHap1 ? hapChar1Count : 0;
+                        alleleCountHap2 += inHap1 ? 0 : hapChar1Count;
+                        allele2CountHap1 += inHap1 ? hapChar2Count : 0;
+                        allele2CountHap2 += inHap1 ? 0 : hapChar2Count;
+                    }
+                    CuAssertIntEquals(testCase, alleleCountHap1, gF->alleleCountsHap1[j]);
+                    CuAssertIntEquals(testCase, alleleCountHap2, gF->alleleCountsHap2[j]);
+                    CuAssertIntEquals(testCase, allele2CountHap1, gF->allele2CountsHap1[j]);
+                    CuAssertIntEquals(testCase, allele2CountHap2, gF->allele2CountsHap2[j]);
+                }
+                if(column->nColumn != NULL) {
+                    column = column->nColumn->nColumn;
+                }
+            }
+
+            stGenomeFragment_destruct(gF);
+            stList_destruct(path);
+            stRPHmm_destruct(hmm, 1);
+        }
+
+        // Clean up
+        stList_destruct(hmms);
+        stList_destruct(ensembleGenomeFragments);
+        stList_destruct(otherSubsamples);
+        stSet_destruct(subsampledSeqs);
+        stList_destruct(subsamples);
+        stList_destruct(remainingProfileSeqs);
+        stList_destruct(profileSeqs);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+
+    // Reconciling with the ensemble should not make the genotypes substantially worse
+    st_logInfo("Genotype errors before reconciling: %" PRIi64 ", after: %" PRIi64 ", of %" PRIi64 " positions\n",
+               genotypeErrors, reconciledGenotypeErrors, totalPositions);
+    CuAssertTrue(testCase, reconciledGenotypeErrors <= genotypeErrors + 0.001 * totalPositions);
+}
+
+void test_adaptivePruning(CuTest *testCase) {
+    /*
+     * Checks that pruning to a target posterior mass keeps the number of cells in each column within the floor
+     * and ceiling, retains the target mass unless at the ceiling, uses fewer cells than pruning to a fixed number
+     * of cells and predicts genotypes about as accurately.
+     */
+    int64_t fixedCells = 0, adaptiveCells = 0, fixedGenotypeErrors = 0, adaptiveGenotypeErrors = 0;
+    int64_t totalPositions = 0;
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        fprintf(stderr, "Starting test iteration: #%" PRIi64 "\n", test);
+
+        stRPHmmParameters *params = getHmmParams(64, 0.02, 0.01, 0, 0);
+
+        simulatedReads *sim = simulatedReads_construct(1, 2, 1000, 2000, 4, 8, 50, 300, 0.02, 0.01, params);
+
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+
+        for(int64_t adaptive=0; adaptive<2; adaptive++) {
+            params->minPartitionsInAColumn = adaptive ? 2 : 64;
+            params->minPosteriorProbabilityForPartition = 0.0;
+            params->targetPosteriorMassForPartitions = adaptive ? 0.999 : 0.0;
+
+            stList *hmms = getRPHmms(profileSeqs, sim->referenceNamesToReferencePriors, params);
+            while(stList_length(hmms) > 0) {
+                stRPHmm *hmm = stList_pop(hmms);
+                stRPHmm_forwardBackward(hmm);
+                double retainedPosteriorMass = stRPHmm_prune(hmm);
+                CuAssertTrue(testCase, retainedPosteriorMass >= 0.0 && retainedPosteriorMass <= 1.0 + 0.0001);
+
+                // Check the number of cells in each column
+                bool columnAtCeiling = false;
+                for(stRPColumn *column = hmm->firstColumn; column != NULL;
+                    column = column->nColumn == NULL ? NULL : column->nColumn->nColumn) {
+                    int64_t cellNumber = 0;
+                    for(stRPCell *cell = column->head; cell != NULL; cell = cell->nCell) {
+                        cellNumber++;
+                    }
+                    CuAssertTrue(testCase, cellNumber >= 1 && cellNumber <= params->maxPartitionsInAColumn);
+                    columnAtCeiling = columnAtCeiling || cellNumber == params->maxPartitionsInAColumn;
+                    if(adaptive) {
+                        adaptiveCells += cellNumber;
+                    }
+                    else {
+                        fixedCells += cellNumber;
+                    }
+                }
+                if(adaptive && !columnAtCeiling) {
+                    CuAssertTrue(testCase, retainedPosteriorMass >= params->targetPosteriorMassForPartitions);
+                }
+
+                // Count the incorrect genotypes
+                stRPHmm_forwardBackward(hmm);
+                stList *path = stRPHmm_forwardTraceBack(hmm);
+                stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+                int64_t referenceIndex;
+                CuAssertIntEquals(testCase, 1, sscanf(gF->referenceName, "Reference_%" PRIi64 "", &referenceIndex));
+                char *hapSeq1 = stList_get(sim->hapSeqs1, referenceIndex), *hapSeq2 = stList_get(sim->hapSeqs2, referenceIndex);
+                for(int64_t i=0; i<gF->length; i++) {
+                    uint64_t hapChar1 = hapSeq1[gF->refStart + i] - FIRST_ALPHABET_CHAR;
+                    uint64_t hapChar2 = hapSeq2[gF->refStart + i] - FIRST_ALPHABET_CHAR;
+                    uint64_t trueGenotype = hapChar1 < hapChar2 ? hapChar1 * ALPHABET_SIZE + hapChar2 :
+                                            hapChar2 * ALPHABET_SIZE + hapChar1;
+                    if(adaptive) {
+                        adaptiveGenotypeErrors += gF->genotypeString[i] != trueGenotype;
+                    }
+                    else {
+                        fixedGenotypeErrors += gF->genotypeString[i] != trueGenotype;
+                        totalPositions++;
+                    }
+                }
+
+                stGenomeFragment_destruct(gF);
+                stList_destruct(path);
+                stRPHmm_destruct(hmm, 1);
+            }
+            stList_destruct(hmms);
+        }
+
+        // Clean up
+        stList_destruct(profileSeqs);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+
+    st_logInfo("Cells with fixed pruning: %" PRIi64 ", with adaptive pruning: %" PRIi64 "\n", fixedCells, adaptiveCells);
+    st_logInfo("Genotype errors with fixed pruning: %" PRIi64 ", with adaptive pruning: %" PRIi64 ", of %" PRIi64
+               " positions\n", fixedGenotypeErrors, adaptiveGenotypeErrors, totalPositions);
+    CuAssertTrue(testCase, adaptiveCells <= fixedCells);
+    CuAssertTrue(testCase, adaptiveGenotypeErrors <= fixedGenotypeErrors + 0.001 * totalPositions);
+}
+
+void test_filterReadsByCoverageDepth(CuTest *testCase) {
+    /*
+     * Checks that downsampling the reads divides them into kept and discarded reads, that the coverage depth of the
+     * kept reads is at most the maximum, and that each discarded read covers a position at which the kept reads
+     * already have the maximum coverage, with MAPQs no lower than its own if high MAPQ reads are preferred.
+     */
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        for(int64_t preferHighMapq=0; preferHighMapq<2; preferHighMapq++) {
+            stRPHmmParameters *params = getHmmParams(50, 0.01, 0.01, 1, 0);
+            params->maxCoverageDepth = 8;
+            params->preferHighMapqWhenDownsampling = preferHighMapq;
+
+            simulatedReads *sim = simulatedReads_construct(1, 3, 500, 2000, 2, 10, 50, 300, 0.01, 0.01, params);
+
+            stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+            stList_appendAll(profileSeqs, sim->profileSeqs2);
+            for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+                ((stProfileSeq *)stList_get(profileSeqs, i))->mappingQuality = st_randomInt(0, 61);
+            }
+
+            stList *filteredProfileSeqs = stList_construct();
+            stList *discardedProfileSeqs = stList_construct();
+            filterReadsByCoverageDepth(profileSeqs, params, filteredProfileSeqs, discardedProfileSeqs,
+                                       sim->referenceNamesToReferencePriors);
+            CuAssertIntEquals(testCase, stList_length(profileSeqs),
+                              stList_length(filteredProfileSeqs) + stList_length(discardedProfileSeqs));
+
+            for(int64_t i=0; i<stList_length(sim->referenceSeqs); i++) {
+                char *referenceName = stString_print("Reference_%" PRIi64 "", i);
+                int64_t referenceLength = strlen(stList_get(sim->referenceSeqs, i));
+
+                // Calculate the coverage of the kept reads and the least MAPQ of those covering each position
+                int64_t *coverage = st_calloc(referenceLength, sizeof(int64_t));
+                int64_t *minMapq = st_malloc(sizeof(int64_t) * referenceLength);
+                for(int64_t j=0; j<referenceLength; j++) {
+                    minMapq[j] = INT64_MAX;
+                }
+                for(int64_t j=0; j<stList_length(filteredProfileSeqs); j++) {
+                    stProfileSeq *pSeq = stList_get(filteredProfileSeqs, j);
+                    if(strcmp(pSeq->referenceName, referenceName) == 0) {
+                        for(int64_t k=pSeq->refStart; k<pSeq->refStart + pSeq->length; k++) {
+                            coverage[k]++;
+                            minMapq[k] = pSeq->mappingQuality < minMapq[k] ? pSeq->mappingQuality : minMapq[k];
+                        }
+                    }
+                }
+                for(int64_t j=0; j<referenceLength; j++) {
+                    CuAssertTrue(testCase, coverage[j] <= params->maxCoverageDepth);
+                }
+
+                // Check each discarded read was needed to be discarded
+                for(int64_t j=0; j<stList_length(discardedProfileSeqs); j++) {
+                    stProfileSeq *pSeq = stList_get(discardedProfileSeqs, j);
+                    if(strcmp(pSeq->referenceName, referenceName) == 0) {
+                        bool blocked = 0;
+                        for(int64_t k=pSeq->refStart; k<pSeq->refStart + pSeq->length; k++) {
+                            if(coverage[k] == params->maxCoverageDepth &&
+                               (!preferHighMapq || minMapq[k] >= pSeq->mappingQuality)) {
+                                blocked = 1;
+                            }
+                        }
+                        CuAssertTrue(testCase, blocked);
+                    }
+                }
+
+                free(coverage);
+                free(minMapq);
+                free(referenceName);
+            }
+
+            // Cleanup
+            stList_destruct(filteredProfileSeqs);
+            stList_destruct(discardedProfileSeqs);
+            stList_destruct(profileSeqs);
+            simulatedReads_destruct(sim);
+            stRPHmmParameters_destruct(params);
+        }
+    }
+}
+
+void test_mergeTilingPathsByEstimatedCost(CuTest *testCase) {
+    /*
+     * Checks that merging the tiling paths in the order of their estimated cost gives hmms over the same
+     * intervals, containing the same reads, as merging them in halves, and genotypes about as accurate.
+     */
+    int64_t genotypeErrors[2] = { 0, 0 }, totalPositions = 0;
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        stRPHmmParameters *params = getHmmParams(50, 0.02, 0.01, 1, 0);
+
+        simulatedReads *sim = simulatedReads_construct(1, 3, 1000, 2000, 3, 8, 50, 500, 0.02, 0.01, params);
+
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+
+        stList *hmms[2];
+        for(int64_t k=0; k<2; k++) {
+            params->orderMergesByEstimatedCost = k;
+            hmms[k] = getRPHmms(profileSeqs, sim->referenceNamesToReferencePriors, params);
+
+            // Check the hmms are ordered and do not overlap
+            for(int64_t i=0; i+1<stList_length(hmms[k]); i++) {
+                stRPHmm *hmm1 = stList_get(hmms[k], i), *hmm2 = stList_get(hmms[k], i+1);
+                CuAssertTrue(testCase, stRPHmm_cmpFn(hmm1, hmm2) < 0);
+                CuAssertTrue(testCase, !stRPHmm_overlapOnReference(hmm1, hmm2));
+            }
+
+            // Count the incorrect genotypes
+            for(int64_t i=0; i<stList_length(hmms[k]); i++) {
+                stRPHmm *hmm = stList_get(hmms[k], i);
+                stRPHmm_forwardBackward(hmm);
+                stList *path = stRPHmm_forwardTraceBack(hmm);
+                stGenomeFragment *gF = stGenomeFragment_construct(hmm, path);
+                int64_t referenceIndex;
+                CuAssertIntEquals(testCase, 1, sscanf(gF->referenceName, "Reference_%" PRIi64 "", &referenceIndex));
+                char *hapSeq1 = stList_get(sim->hapSeqs1, referenceIndex), *hapSeq2 = stList_get(sim->hapSeqs2, referenceIndex);
+                for(int64_t j=0; j<gF->length; j++) {
+                    uint64_t hapChar1 = hapSeq1[gF->refStart + j] - FIRST_ALPHABET_CHAR;
+                    uint64_t hapChar2 = hapSeq2[gF->refStart + j] - FIRST_ALPHABET_CHAR;
+                    uint64_t trueGenotype = hapChar1 < hapChar2 ? hapChar1 * ALPHABET_SIZE + hapChar2 :
+                                            hapChar2 * ALPHABET_SIZE + hapChar1;
+                    genotypeErrors[k] += gF->genotypeString[j] != trueGenotype;
+                    totalPositions += k == 0 ? 1 : 0;
+                }
+                stGenomeFragment_destruct(gF);
+                stList_destruct(path);
+            }
+        }
+
+        // Check the hmms cover the same intervals and reads
+        CuAssertIntEquals(testCase, stList_length(hmms[0]), stList_length(hmms[1]));
+        for(int64_t i=0; i<stList_length(hmms[0]); i++) {
+            stRPHmm *hmm1 = stList_get(hmms[0], i), *hmm2 = stList_get(hmms[1], i);
+            CuAssertStrEquals(testCase, hmm1->referenceName, hmm2->referenceName);
+            CuAssertIntEquals(testCase, hmm1->refStart, hmm2->refStart);
+            CuAssertIntEquals(testCase, hmm1->refLength, hmm2->refLength);
+            CuAssertIntEquals(testCase, stList_length(hmm1->profileSeqs), stList_length(hmm2->profileSeqs));
+            stSet *seqs = stList_getSet(hmm1->profileSeqs);
+            for(int64_t j=0; j<stList_length(hmm2->profileSeqs); j++) {
+                CuAssertTrue(testCase, stSet_search(seqs, stList_get(hmm2->profileSeqs, j)) != NULL);
+            }
+            stSet_destruct(seqs);
+        }
+
+        // Cleanup
+        stList_destruct(hmms[0]);
+        stList_destruct(hmms[1]);
+        stList_destruct(profileSeqs);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+
+    st_logInfo("Genotype errors merging in halves: %" PRIi64 ", by estimated cost: %" PRIi64 ", of %" PRIi64
+               " positions\n", genotypeErrors[0], genotypeErrors[1], totalPositions);
+    CuAssertTrue(testCase, genotypeErrors[1] <= genotypeErrors[0] + 0.001 * totalPositions);
+}
+
+static bool haplotypesAreInverted(stGenomeFragment *gF, char *hapSeq1, char *hapSeq2, int64_t start, int64_t end,
+                                  int64_t *phasedSites) {
+    /*
+     * Returns true if the haplotypes of the genome fragment over [start, end) better match the swapped true
+     * haplotypes, counting the heterozygous sites phased either way in phasedSites.
+     */
+    int64_t cis = 0, trans = 0;
+    for(int64_t p=start; p<end; p++) {
+        uint64_t h1 = gF->haplotypeString1[p - gF->refStart], h2 = gF->haplotypeString2[p - gF->refStart];
+        uint64_t t1 = hapSeq1[p] - FIRST_ALPHABET_CHAR, t2 = hapSeq2[p] - FIRST_ALPHABET_CHAR;
+        if(t1 != t2) {
+            cis += h1 == t1 && h2 == t2;
+            trans += h1 == t2 && h2 == t1;
+        }
+    }
+    *phasedSites = cis + trans;
+    return trans > cis;
+}
+
+void test_stitchChunkGenomeFragments(CuTest *testCase) {
+    /*
+     * Checks that chunking reads puts each read in every chunk it overlaps, and that stitching the genome
+     * fragments of adjacent chunks by the concordance of their shared reads (see stitchChunkPhaseBlocks) clips
+     * them to their chunks and gives a consistent phasing across the chunk boundaries.
+     */
+    int64_t totalStitches = 0, stitchErrors = 0, invertedAsymmetricLikelihoods = 0;
+
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        fprintf(stderr, "Starting test iteration: #%" PRIi64 "\n", test);
+
+        stRPHmmParameters *params = getHmmParams(100, 0.02, 0.01, 1, 0);
+
+        simulatedReads *sim = simulatedReads_construct(1, 1, 1500, 2500, 10, 15, 100, 300, 0.02, 0.01, params);
+        char *hapSeq1 = stList_get(sim->hapSeqs1, 0), *hapSeq2 = stList_get(sim->hapSeqs2, 0);
+
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+
+        // Give the reads distinct names, by which the chunks are stitched
+        for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+            stProfileSeq *pSeq = stList_get(profileSeqs, i);
+            free(pSeq->readId);
+            pSeq->readId = stString_print("read_%" PRIi64 "", i);
+        }
+
+        // Check each read is in exactly the chunks whose extended intervals it overlaps
+        int64_t chunkSize = st_randomInt(300, 800), chunkOverlap = st_randomInt(50, 200);
+        stList *chunks = getProfileSeqChunks(profileSeqs, chunkSize, chunkOverlap);
+        for(int64_t i=0; i<stList_length(chunks); i++) {
+            stSet *chunkSeqs = stList_getSet(stList_get(chunks, i));
+            CuAssertIntEquals(testCase, stList_length(stList_get(chunks, i)), stSet_size(chunkSeqs));
+            for(int64_t j=0; j<stList_length(profileSeqs); j++) {
+                stProfileSeq *pSeq = stList_get(profileSeqs, j);
+                bool overlaps = pSeq->refStart < (i+1) * chunkSize + chunkOverlap &&
+                                pSeq->refStart + pSeq->length > i * chunkSize - chunkOverlap;
+                CuAssertTrue(testCase, overlaps == (stSet_search(chunkSeqs, pSeq) != NULL));
+            }
+            stSet_destruct(chunkSeqs);
+        }
+
+        // Phase the hmms of each non-empty chunk, as marginPhase does
+        stList *phasingChunks = stList_construct3(0, (void (*)(void *))stPhasingChunk_destruct);
+        stList *hmms = stList_construct3(0, (void (*)(void *))stRPHmm_destruct2);
+        for(int64_t i=0; i<stList_length(chunks); i++) {
+            if(stList_length(stList_get(chunks, i)) == 0) {
+                continue;
+            }
+            stProfileSeq *pSeq = stList_get(stList_get(chunks, i), 0);
+            stPhasingChunk *chunk = stPhasingChunk_construct(pSeq->referenceName, i * chunkSize, (i+1) * chunkSize,
+                                                             stList_copy(stList_get(chunks, i), NULL));
+            stList *chunkHmms = getRPHmms(chunk->profileSeqs, sim->referenceNamesToReferencePriors, params);
+            chunk->firstHmm = stList_length(hmms);
+            chunk->hmmNumber = stList_length(chunkHmms);
+            stList_appendAll(hmms, chunkHmms);
+            stList_setDestructor(chunkHmms, NULL);
+            stList_destruct(chunkHmms);
+            stList_append(phasingChunks, chunk);
+        }
+        ((stPhasingChunk *)stList_get(phasingChunks, 0))->chunkStart = INT64_MIN;
+        ((stPhasingChunk *)stList_peek(phasingChunks))->chunkEnd = INT64_MAX;
+
+        int64_t hmmNumber = stList_length(hmms);
+        stList **paths = st_malloc(sizeof(stList *) * hmmNumber);
+        stGenomeFragment **gFs = st_malloc(sizeof(stGenomeFragment *) * hmmNumber);
+        stSet **reads1s = st_malloc(sizeof(stSet *) * hmmNumber);
+        stSet **reads2s = st_malloc(sizeof(stSet *) * hmmNumber);
+        for(int64_t i=0; i<hmmNumber; i++) {
+            stRPHmm *hmm = stList_get(hmms, i);
+            paths[i] = stRPHmm_forwardBackwardTraceBack(hmm);
+            gFs[i] = stGenomeFragment_construct(hmm, paths[i]);
+            reads1s[i] = stRPHmm_partitionSequencesByStatePath(hmm, paths[i], true);
+            reads2s[i] = stRPHmm_partitionSequencesByStatePath(hmm, paths[i], false);
+        }
+
+        // Stitch the genome fragments into phase blocks
+        int64_t *blockStarts = st_malloc(sizeof(int64_t) * hmmNumber);
+        int64_t *blockEnds = st_malloc(sizeof(int64_t) * hmmNumber);
+        bool *stitched = st_malloc(sizeof(bool) * hmmNumber);
+        bool *inverted = st_malloc(sizeof(bool) * hmmNumber);
+        int64_t stitchedBoundaries = stitchChunkPhaseBlocks(phasingChunks, gFs, reads1s, reads2s,
+                                                            blockStarts, blockEnds, stitched, inverted);
+
+        // Each genome fragment is clipped to its chunk, and only those starting at a chunk boundary are stitched
+        int64_t stitchedNumber = 0;
+        for(int64_t i=0; i<stList_length(phasingChunks); i++) {
+            stPhasingChunk *chunk = stList_get(phasingChunks, i);
+            for(int64_t j=chunk->firstHmm; j<chunk->firstHmm+chunk->hmmNumber; j++) {
+                int64_t start = gFs[j]->refStart > chunk->chunkStart ? gFs[j]->refStart : chunk->chunkStart;
+                int64_t end = gFs[j]->refStart + gFs[j]->length < chunk->chunkEnd ?
+                              gFs[j]->refStart + gFs[j]->length : chunk->chunkEnd;
+                CuAssertIntEquals(testCase, start, blockStarts[j]);
+                CuAssertIntEquals(testCase, end, blockEnds[j]);
+                if(stitched[j]) {
+                    CuAssertTrue(testCase, blockStarts[j] < blockEnds[j]);
+                    CuAssertIntEquals(testCase, chunk->chunkStart, blockStarts[j]);
+                    stitchedNumber++;
+                }
+            }
+        }
+        CuAssertIntEquals(testCase, stitchedNumber, stitchedBoundaries);
+
+        // Assemble each phase block, as marginPhase does, and check the phasing either side of each stitched
+        // boundary against the true haplotypes
+        for(int64_t i=0; i<hmmNumber;) {
+            if(blockStarts[i] >= blockEnds[i]) {
+                i++;
+                continue;
+            }
+            int64_t j = i+1, blockEnd = blockEnds[i];
+            while(j < hmmNumber && (blockStarts[j] >= blockEnds[j] || stitched[j])) {
+                blockEnd = blockStarts[j] < blockEnds[j] ? blockEnds[j] : blockEnd;
+                j++;
+            }
+            stGenomeFragment *gF = stGenomeFragment_constructEmpty(gFs[i]->referenceName, blockStarts[i],
+                                                                   blockEnd - blockStarts[i]);
+            int64_t previous = -1;
+            for(int64_t k=i; k<j; k++) {
+                if(blockStarts[k] >= blockEnds[k]) {
+                    continue;
+                }
+                CuAssertTrue(testCase, k == i || stitched[k]);
+                stGenomeFragment_copyInterval(gF, gFs[k], blockStarts[k], blockEnds[k], inverted[k]);
+                for(int64_t p=blockStarts[k]; p<blockEnds[k]; p++) {
+                    int64_t l = p - gFs[k]->refStart, m = p - gF->refStart;
+                    CuAssertIntEquals(testCase, gFs[k]->genotypeString[l], gF->genotypeString[m]);
+                    CuAssertIntEquals(testCase, inverted[k] ? gFs[k]->haplotypeString2[l] :
+                                      gFs[k]->haplotypeString1[l], gF->haplotypeString1[m]);
+                    CuAssertIntEquals(testCase, inverted[k] ? gFs[k]->hap1Depth[l] : gFs[k]->hap2Depth[l],
+                                      gF->hap2Depth[m]);
+
+                    // Genotype likelihoods are indexed by the hap1 and then hap2 characters, so are transposed
+                    // by inversion
+                    for(int64_t c1=0; c1<ALPHABET_SIZE; c1++) {
+                        for(int64_t c2=0; c2<ALPHABET_SIZE; c2++) {
+                            float gl = gFs[k]->genotypeLikelihoods[l][inverted[k] ? c2*ALPHABET_SIZE+c1 :
+                                                                                    c1*ALPHABET_SIZE+c2];
+                            CuAssertTrue(testCase, gl == gF->genotypeLikelihoods[m][c1*ALPHABET_SIZE+c2]);
+                            invertedAsymmetricLikelihoods += inverted[k] && c1 != c2 &&
+                                    gl != gFs[k]->genotypeLikelihoods[l][c1*ALPHABET_SIZE+c2];
+                        }
+                    }
+                }
+                if(previous != -1) {
+                    // The stitch follows the concordance of the shared reads, which is antisymmetric in the haplotypes
+                    int64_t concordance = getPhasingConcordance(reads1s[previous], reads2s[previous],
+                                                                reads1s[k], reads2s[k]);
+                    CuAssertIntEquals(testCase, -concordance, getPhasingConcordance(reads1s[previous],
+                                      reads2s[previous], reads2s[k], reads1s[k]));
+                    CuAssertTrue(testCase, concordance != 0);
+                    CuAssertTrue(testCase, (inverted[k] != inverted[previous]) == (concordance < 0));
+
+                    int64_t sites1, sites2;
+                    bool inverted1 = haplotypesAreInverted(gF, hapSeq1, hapSeq2, blockStarts[previous],
+                                                           blockEnds[previous], &sites1);
+                    bool inverted2 = haplotypesAreInverted(gF, hapSeq1, hapSeq2, blockStarts[k], blockEnds[k],
+                                                           &sites2);
+                    if(sites1 > 0 && sites2 > 0) {
+                        totalStitches++;
+                        stitchErrors += inverted1 != inverted2;
+                    }
+                }
+                previous = k;
+            }
+            stGenomeFragment_destruct(gF);
+            i = j;
+        }
+
+        // Cleanup
+        for(int64_t i=0; i<hmmNumber; i++) {
+            stGenomeFragment_destruct(gFs[i]);
+            stSet_destruct(reads1s[i]);
+            stSet_destruct(reads2s[i]);
+            stList_destruct(paths[i]);
+        }
+        free(paths);
+        free(gFs);
+        free(reads1s);
+        free(reads2s);
+        free(blockStarts);
+        free(blockEnds);
+        free(stitched);
+        free(inverted);
+        stList_destruct(hmms);
+        stList_destruct(phasingChunks);
+
+        // Cleanup
+        stList_destruct(chunks);
+        stList_destruct(profileSeqs);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+
+    fprintf(stderr, "Got %" PRIi64 " phase errors in %" PRIi64 " stitched chunk boundaries\n",
+            stitchErrors, totalStitches);
+    CuAssertTrue(testCase, totalStitches > 0);
+    CuAssertTrue(testCase, stitchErrors * 10 <= totalStitches);
+
+    // Some inverted genome fragments were copied with genotype likelihoods that differ when transposed
+    CuAssertTrue(testCase, invertedAsymmetricLikelihoods > 0);
+}
+
+static int64_t getHmmProbs(stRPHmm *hmm, double *probs) {
+    /*
+     * Writes the forward and backward log probabilities of the hmm, of its columns, cells and merge cells
+     * to probs, if not NULL, in a fixed order, returning the number of probabilities.
+     */
+    int64_t i = 0;
+    if(probs != NULL) {
+        probs[i] = hmm->forwardLogProb;
+        probs[i+1] = hmm->backwardLogProb;
+    }
+    i += 2;
+    stRPColumn *column = hmm->firstColumn;
+    while(1) {
+        if(probs != NULL) {
+            probs[i] = column->totalLogProb;
+        }
+        i++;
+        for(stRPCell *cell = column->head; cell != NULL; cell = cell->nCell) {
+            if(probs != NULL) {
+                probs[i] = cell->forwardLogProb;
+                probs[i+1] = cell->backwardLogProb;
+            }
+            i += 2;
+        }
+        if(column->nColumn == NULL) {
+            break;
+        }
+        stHashIterator *it = stHash_getIterator(column->nColumn->mergeCellsFrom);
+        stRPMergeCell *mCell;
+        while((mCell = stHash_getNext(it)) != NULL) {
+            if(probs != NULL) {
+                probs[i] = mCell->forwardLogProb;
+                probs[i+1] = mCell->backwardLogProb;
+            }
+            i += 2;
+        }
+        stHash_destructIterator(it);
+        column = column->nColumn->nColumn;
+    }
+    return i;
+}
+
+void test_forwardBackwardBySegments(CuTest *testCase) {
+    /*
+     * Checks that running the forward-backward algorithm by segments, or with the forward and backward passes
+     * run concurrently, gives the same probabilities as running it from first to last column.
+     */
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        for(int64_t maxNotSumTransitions=0; maxNotSumTransitions<2; maxNotSumTransitions++) {
+            stRPHmmParameters *params = getHmmParams(50, 0.01, 0.01, maxNotSumTransitions, 0);
+
+            simulatedReads *sim = simulatedReads_construct(1, 3, 1000, 2000, 2, 8, 50, 500, 0.01, 0.01, params);
+
+            stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+            stList_appendAll(profileSeqs, sim->profileSeqs2);
+            stList *hmms = getRPHmms(profileSeqs, sim->referenceNamesToReferencePriors, params);
+
+            for(int64_t i=0; i<stList_length(hmms); i++) {
+                stRPHmm *hmm = stList_get(hmms, i);
+
+                stRPHmm_forwardBackward(hmm);
+                int64_t probNumber = getHmmProbs(hmm, NULL);
+                double *probs = st_malloc(sizeof(double) * probNumber);
+                double *segmentProbs = st_malloc(sizeof(double) * probNumber);
+                getHmmProbs(hmm, probs);
+
+                int64_t segmentNumbers[] = { 1, 2, 7, 1000 };
+                int64_t maxMergeCellsAtSegmentBoundary[] = { 1, 4, 1000 };
+                for(int64_t j=0; j<4; j++) {
+                    for(int64_t k=0; k<3; k++) {
+                        stRPHmm_forwardBackwardBySegments(hmm, segmentNumbers[j], maxMergeCellsAtSegmentBoundary[k]);
+                        CuAssertIntEquals(testCase, probNumber, getHmmProbs(hmm, segmentProbs));
+                        for(int64_t l=0; l<probNumber; l++) {
+                            CuAssertDblEquals(testCase, probs[l], segmentProbs[l], 0.0001 * (1.0 + fabs(probs[l])));
+                        }
+                    }
+                }
+
+                // Check running the forward and backward passes concurrently also gives the same probabilities
+                stRPHmm_forwardBackwardConcurrently(hmm);
+                CuAssertIntEquals(testCase, probNumber, getHmmProbs(hmm, segmentProbs));
+                for(int64_t l=0; l<probNumber; l++) {
+                    CuAssertDblEquals(testCase, probs[l], segmentProbs[l], 0.0001 * (1.0 + fabs(probs[l])));
+                }
+
+                free(probs);
+                free(segmentProbs);
+            }
+
+            // Cleanup
+            stList_destruct(hmms);
+            stList_destruct(profileSeqs);
+            simulatedReads_destruct(sim);
+            stRPHmmParameters_destruct(params);
+        }
+    }
+}
+
+void test_splitProfileSeqsAtWeaklyLinkedSites(CuTest *testCase) {
+    /*
+     * Checks that dividing reads into independent groups before creating hmms gives groups that do not overlap,
+     * in which every pair of consecutive unfiltered positions is either well linked or at the boundary of a group,
+     * and that the divided reads cover the same positions as the originals.
+     */
+    for(int64_t test=0; test<RANDOM_TEST_NO; test++) {
+        int64_t minReadCoverage = 2;
+        stRPHmmParameters *params = getHmmParams(50, 0.01, 0.01, 1, minReadCoverage);
+
+        simulatedReads *sim = simulatedReads_construct(1, 3, 1000, 3000, 1, 4, 50, 500, 0.01, 0.01, params);
+
+        // Filter most of the reference positions
+        stHashIterator *it = stHash_getIterator(sim->referenceNamesToReferencePriors);
+        char *referenceName;
+        while((referenceName = stHash_getNext(it)) != NULL) {
+            stReferencePriorProbs *rProbs = stHash_search(sim->referenceNamesToReferencePriors, referenceName);
+            for(int64_t i=0; i<rProbs->length; i++) {
+                rProbs->referencePositionsIncluded[i] = st_random() < 0.02;
+            }
+            stReferencePriorProbs_updateActivePositions(rProbs);
+        }
+        stHash_destructIterator(it);
+
+        stList *profileSeqs = stList_copy(sim->profileSeqs1, NULL);
+        stList_appendAll(profileSeqs, sim->profileSeqs2);
+        stList *clippedProfileSeqs = stList_construct3(0, (void (*)(void *))stProfileSeq_destruct);
+        stList *groups = splitProfileSeqsAtWeaklyLinkedSites(profileSeqs, sim->referenceNamesToReferencePriors,
+                                                             params, clippedProfileSeqs);
+
+        // Check the total length of the reads is unchanged
+        int64_t totalLength = 0, groupsTotalLength = 0;
+        for(int64_t i=0; i<stList_length(profileSeqs); i++) {
+            totalLength += ((stProfileSeq *)stList_get(profileSeqs, i))->length;
+        }
+
+        // Get the interval of each group
+        int64_t groupNumber = stList_length(groups);
+        int64_t starts[groupNumber], ends[groupNumber];
+        for(int64_t i=0; i<groupNumber; i++) {
+            stList *group = stList_get(groups, i);
+            CuAssertTrue(testCase, stList_length(group) > 0);
+            stProfileSeq *pSeq = stList_get(group, 0);
+            starts[i] = pSeq->refStart;
+            ends[i] = pSeq->refStart + pSeq->length;
+            for(int64_t j=0; j<stList_length(group); j++) {
+                pSeq = stList_get(group, j);
+                CuAssertStrEquals(testCase, ((stProfileSeq *)stList_get(group, 0))->referenceName, pSeq->referenceName);
+                starts[i] = pSeq->refStart < starts[i] ? pSeq->refStart : starts[i];
+                ends[i] = pSeq->refStart + pSeq->length > ends[i] ? pSeq->refStart + pSeq->length : ends[i];
+                groupsTotalLength += pSeq->length;
+            }
+        }
+        CuAssertIntEquals(testCase, totalLength, groupsTotalLength);
+
+        // Check the groups on the same reference do not overlap and that consecutive unfiltered positions within a
+        // group are well linked, unless spanned by no reads of the group
+        for(int64_t i=0; i<groupNumber; i++) {
+            stList *group = stList_get(groups, i);
+            char *groupReferenceName = ((stProfileSeq *)stList_get(group, 0))->referenceName;
+            for(int64_t j=i+1; j<groupNumber; j++) {
+                stList *group2 = stList_get(groups, j);
+                if(strcmp(groupReferenceName, ((stProfileSeq *)stList_get(group2, 0))->referenceName) == 0) {
+                    CuAssertTrue(testCase, ends[i] <= starts[j] || ends[j] <= starts[i]);
+                }
+            }
+            stReferencePriorProbs *rProbs = stHash_search(sim->referenceNamesToReferencePriors, groupReferenceName);
+            int64_t previousSite = -1;
+            for(int64_t k=starts[i]; k<ends[i]; k++) {
+                if(!rProbs->referencePositionsIncluded[k - rProbs->refStart]) {
+                    continue;
+                }
+                if(previousSite != -1) {
+                    int64_t linkingReads = 0;
+                    for(int64_t j=0; j<stList_length(group); j++) {
+                        stProfileSeq *pSeq = stList_get(group, j);
+                        if(pSeq->refStart <= previousSite && pSeq->refStart + pSeq->length > k) {
+                            linkingReads++;
+                        }
+                    }
+                    CuAssertTrue(testCase, linkingReads >= minReadCoverage);
+                }
+                previousSite = k;
+            }
+        }
+
+        // Check the hmms created from the groups are ordered and do not overlap
+        stList *hmms = getRPHmmsSplitAtWeaklyLinkedSites(profileSeqs, sim->referenceNamesToReferencePriors,
+                                                         params, clippedProfileSeqs);
+        CuAssertTrue(testCase, stList_length(hmms) >= groupNumber);
+        for(int64_t i=0; i+1<stList_length(hmms); i++) {
+            stRPHmm *hmm1 = stList_get(hmms, i), *hmm2 = stList_get(hmms, i+1);
+            CuAssertTrue(testCase, stRPHmm_cmpFn(hmm1, hmm2) < 0);
+            CuAssertTrue(testCase, !stRPHmm_overlapOnReference(hmm1, hmm2));
+        }
+
+        // Cleanup
+        stList_destruct(hmms);
+        stList_destruct(groups);
+        stList_destruct(clippedProfileSeqs);
+        stList_destruct(profileSeqs);
+        simulatedReads_destruct(sim);
+        stRPHmmParameters_destruct(params);
+    }
+}
+
 void test_flipAReadsPartition(CuTest *testCase) {
-    for(uint64_t i=0; i<64; i++) {
-        CuAssertTrue(testCase, flipAReadsPartition(0, i) == ((uint64_t)1 << i));
-        CuAssertTrue(testCase, popcount64(flipAReadsPartition(0, i)) == 1);
+    stRPPartition allReads = makeAcceptMask(MAX_READ_PARTITIONING_DEPTH);
+    CuAssertTrue(testCase, allReads == ~((stRPPartition)0));
+    for(uint64_t i=0; i<MAX_READ_PARTITIONING_DEPTH; i++) {
+        CuAssertTrue(testCase, flipAReadsPartition(0, i) == ((stRPPartition)1 << i));
+        CuAssertTrue(testCase, popcountPartition(flipAReadsPartition(0, i)) == 1);
     }
-    for(uint64_t i=0; i<64; i++) {
-        CuAssertTrue(testCase, flipAReadsPartition(0xFFFFFFFFFFFFFFFF, i) == (0xFFFFFFFFFFFFFFFF ^ ((uint64_t)1 << i)));
-        CuAssertTrue(testCase, popcount64(flipAReadsPartition(0xFFFFFFFFFFFFFFFF, i)) == 63);
+    for(uint64_t i=0; i<MAX_READ_PARTITIONING_DEPTH; i++) {
+        CuAssertTrue(testCase, flipAReadsPartition(allReads, i) == (allReads ^ ((stRPPartition)1 << i)));
+        CuAssertTrue(testCase, popcountPartition(flipAReadsPartition(allReads, i)) == MAX_READ_PARTITIONING_DEPTH - 1);
     }
     CuAssertTrue(testCase, flipAReadsPartition(0x1111111111111111, 16) == 0x1111111111101111);
     CuAssertTrue(testCase, flipAReadsPartition(0x1111111111101111, 16) == 0x1111111111111111);
@@ -1307,6 +2569,17 @@ CuSuite *stRPHmmTestSuite(void) {
     SUITE_ADD_TEST(suite, test_bitCountVectors);
     SUITE_ADD_TEST(suite, test_getOverlappingComponents);
     SUITE_ADD_TEST(suite, test_emissionLogProbability);
+    SUITE_ADD_TEST(suite, test_checkpointedCrossProduct);
+    SUITE_ADD_TEST(suite, test_splitHmmRetainsPath);
+    SUITE_ADD_TEST(suite, test_getHeterozygousSites);
+    SUITE_ADD_TEST(suite, test_forwardBackwardBySegments);
+    SUITE_ADD_TEST(suite, test_splitProfileSeqsAtWeaklyLinkedSites);
+    SUITE_ADD_TEST(suite, test_genotypeFilteredPositionsFromPileup);
+    SUITE_ADD_TEST(suite, test_ensembleGenomeFragments);
+    SUITE_ADD_TEST(suite, test_adaptivePruning);
+    SUITE_ADD_TEST(suite, test_filterReadsByCoverageDepth);
+    SUITE_ADD_TEST(suite, test_mergeTilingPathsByEstimatedCost);
+    SUITE_ADD_TEST(suite, test_stitchChunkGenomeFragments);
 
     return suite;
 }